@@ -0,0 +1,215 @@
+#pragma once
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+struct AppConfig {
+    bool headless = false;
+    uint32_t frameCount = 0; // 0 = run until the window is closed
+    uint32_t width = 1280;
+    uint32_t height = 720;
+    uint32_t framesInFlight = 2;
+    uint32_t imageCount = 0; // 0 = minImageCount + 1 for a swapchain, 3 offscreen images
+    std::string presentMode; // empty = mailbox when available, otherwise fifo
+    uint32_t fpsCap = 0; // 0 = uncapped
+    bool timeline = false; // frame sync on one timeline semaphore instead of per-frame fences
+    bool asyncQueues = true; // uploads and culling on dedicated transfer / compute queue families when the device has them
+    bool bindless = true; // descriptor indexing when the device supports it, otherwise per-frame descriptor pools
+    bool parallelInit = true; // compile pipelines on worker threads while the rest of init runs
+    bool renderThread = true; // windowed: render on a dedicated thread, the main thread only pumps window messages
+    std::string pipelineCachePath = "pipeline_cache.bin"; // empty = no on-disk cache
+    std::string assetPackPath = "assets.pak"; // empty = always load loose files
+    std::string meshName; // empty = the built-in triangle
+    std::string meshFile; // OBJ imported at startup instead of the built-in triangle
+    std::string benchmark; // empty = regular main loop
+    uint32_t objectCount = 1;
+    uint32_t instanceCount = 0; // 0 = one draw per object, otherwise draw this many instances through the instanced pipeline
+    bool cull = false; // frustum cull the instances in a compute pass and draw them indirectly
+    uint32_t recordThreads = 0; // 0 = record on the main thread into the primary command buffer
+    std::string tracePath; // empty = no GPU timestamps, no trace file
+    std::string instrumentPath; // empty = no CPU instrumentation trace
+    std::string debugSeverity = "warning"; // least severe validation message written, debug builds only
+    std::string debugTypes = "general,validation,performance";
+    bool readback = false; // copy every frame into host memory, implied by a capture path or golden image
+    std::string capturePath; // empty = no dumps, %u is replaced by the frame number to write every frame
+    std::string goldenPath; // empty = no comparison
+    uint32_t goldenTolerance = 2;
+
+    /// <summary>
+    /// Parses command line options:
+    ///   --headless           render into offscreen images instead of a window
+    ///   --frames N           run N frames and print a frame time report
+    ///   --size WxH           offscreen render target size (headless only)
+    ///   --present-mode M     immediate, mailbox, fifo or fifo-relaxed, falls back to fifo when unsupported
+    ///   --frames-in-flight N frames the CPU may record ahead of the GPU (1-8)
+    ///   --images N           swapchain / offscreen image count, clamped to what the surface allows
+    ///   --fps-cap N          sleep so no more than N frames per second are started
+    ///   --timeline           synchronize frames and uploads with a timeline semaphore instead of fences
+    ///   --single-queue       keep uploads and culling on the graphics queue even with dedicated queue families
+    ///   --no-bindless        rewrite a small per-frame descriptor set instead of using descriptor indexing
+    ///   --serial-init        compile pipelines one batch at a time on the main thread, for comparing startup times
+    ///   --no-render-thread   render and pump window messages alternately on the main thread, for comparing latency
+    ///   --pipeline-cache F   load/store the pipeline cache in file F
+    ///   --no-pipeline-cache  start every run with a cold pipeline cache
+    ///   --assets F           map shaders and meshes from asset pack F, loose files are used for anything it lacks
+    ///   --no-assets          load every asset from loose files
+    ///   --mesh NAME          draw the mesh the asset packer baked from NAME.obj into the asset pack, e.g. gem
+    ///   --mesh-file F        import OBJ file F, optimize it for the vertex cache and draw it
+    ///   --objects N          draw N objects, each with its own per-frame transform
+    ///   --instances N        draw N instances with one draw call per batch instead of per-object draws
+    ///   --cull               with --instances, cull on the GPU and draw each visible instance through an indirect command
+    ///   --threads N          record the frame's draws on N threads into secondary command buffers
+    ///   --trace F            profile GPU scopes and CPU frame phases, write a Chrome trace JSON to F
+    ///   --instrument F       record CPU zones of every thread into binary trace F, TraceConverter turns it into
+    ///                        Chrome trace JSON; needs a build with -DVULKANUS_INSTRUMENTATION=ON
+    ///   --debug-severity S   least severe validation message to write: verbose, info, warning (default) or error
+    ///   --debug-types L      comma separated validation message types to write: general, validation, performance
+    ///   --readback           copy every frame back to host memory without writing it anywhere
+    ///   --capture F          write the last frame to F (.ppm, .png or raw RGBA), every frame when F contains %u
+    ///   --golden F           compare the last frame with PPM F and fail beyond the tolerance, F is written when missing
+    ///   --tolerance N        largest per-channel difference from the golden image that still passes (default 2)
+    ///   --bench NAME         run a benchmark instead of the main loop: alloc, upload, record, instances, cull, pipelines, graph
+    /// </summary>
+    static AppConfig fromArgs(int argc, char** argv) {
+        AppConfig config;
+
+        for (int i = 1; i < argc; i++) {
+            auto nextArg = [&]() -> const char* {
+                if (i + 1 >= argc) {
+                    throw std::runtime_error(std::string("missing value for ") + argv[i]);
+                }
+                return argv[++i];
+            };
+
+            if (strcmp(argv[i], "--headless") == 0) {
+                config.headless = true;
+            }
+            else if (strcmp(argv[i], "--frames") == 0) {
+                config.frameCount = static_cast<uint32_t>(std::strtoul(nextArg(), nullptr, 10));
+            }
+            else if (strcmp(argv[i], "--size") == 0) {
+                const char* size = nextArg();
+                char* end = nullptr;
+                config.width = static_cast<uint32_t>(std::strtoul(size, &end, 10));
+                if (*end != 'x') throw std::runtime_error("--size expects WxH");
+                config.height = static_cast<uint32_t>(std::strtoul(end + 1, nullptr, 10));
+            }
+            else if (strcmp(argv[i], "--present-mode") == 0) {
+                config.presentMode = nextArg();
+                if (config.presentMode != "immediate" && config.presentMode != "mailbox" && config.presentMode != "fifo" && config.presentMode != "fifo-relaxed") {
+                    throw std::runtime_error("unknown present mode " + config.presentMode);
+                }
+            }
+            else if (strcmp(argv[i], "--frames-in-flight") == 0) {
+                config.framesInFlight = static_cast<uint32_t>(std::strtoul(nextArg(), nullptr, 10));
+                if (config.framesInFlight < 1 || config.framesInFlight > 8) throw std::runtime_error("--frames-in-flight must be between 1 and 8");
+            }
+            else if (strcmp(argv[i], "--images") == 0) {
+                config.imageCount = static_cast<uint32_t>(std::strtoul(nextArg(), nullptr, 10));
+            }
+            else if (strcmp(argv[i], "--fps-cap") == 0) {
+                config.fpsCap = static_cast<uint32_t>(std::strtoul(nextArg(), nullptr, 10));
+            }
+            else if (strcmp(argv[i], "--timeline") == 0) {
+                config.timeline = true;
+            }
+            else if (strcmp(argv[i], "--single-queue") == 0) {
+                config.asyncQueues = false;
+            }
+            else if (strcmp(argv[i], "--no-bindless") == 0) {
+                config.bindless = false;
+            }
+            else if (strcmp(argv[i], "--serial-init") == 0) {
+                config.parallelInit = false;
+            }
+            else if (strcmp(argv[i], "--no-render-thread") == 0) {
+                config.renderThread = false;
+            }
+            else if (strcmp(argv[i], "--pipeline-cache") == 0) {
+                config.pipelineCachePath = nextArg();
+            }
+            else if (strcmp(argv[i], "--no-pipeline-cache") == 0) {
+                config.pipelineCachePath.clear();
+            }
+            else if (strcmp(argv[i], "--assets") == 0) {
+                config.assetPackPath = nextArg();
+            }
+            else if (strcmp(argv[i], "--no-assets") == 0) {
+                config.assetPackPath.clear();
+            }
+            else if (strcmp(argv[i], "--mesh") == 0) {
+                config.meshName = nextArg();
+            }
+            else if (strcmp(argv[i], "--mesh-file") == 0) {
+                config.meshFile = nextArg();
+            }
+            else if (strcmp(argv[i], "--objects") == 0) {
+                config.objectCount = static_cast<uint32_t>(std::strtoul(nextArg(), nullptr, 10));
+                if (config.objectCount == 0) throw std::runtime_error("--objects must be at least 1");
+            }
+            else if (strcmp(argv[i], "--instances") == 0) {
+                config.instanceCount = static_cast<uint32_t>(std::strtoul(nextArg(), nullptr, 10));
+            }
+            else if (strcmp(argv[i], "--cull") == 0) {
+                config.cull = true;
+            }
+            else if (strcmp(argv[i], "--threads") == 0) {
+                config.recordThreads = static_cast<uint32_t>(std::strtoul(nextArg(), nullptr, 10));
+            }
+            else if (strcmp(argv[i], "--trace") == 0) {
+                config.tracePath = nextArg();
+            }
+            else if (strcmp(argv[i], "--instrument") == 0) {
+                config.instrumentPath = nextArg();
+            }
+            else if (strcmp(argv[i], "--debug-severity") == 0) {
+                config.debugSeverity = nextArg();
+            }
+            else if (strcmp(argv[i], "--debug-types") == 0) {
+                config.debugTypes = nextArg();
+            }
+            else if (strcmp(argv[i], "--readback") == 0) {
+                config.readback = true;
+            }
+            else if (strcmp(argv[i], "--capture") == 0) {
+                config.capturePath = nextArg();
+            }
+            else if (strcmp(argv[i], "--golden") == 0) {
+                config.goldenPath = nextArg();
+            }
+            else if (strcmp(argv[i], "--tolerance") == 0) {
+                config.goldenTolerance = static_cast<uint32_t>(std::strtoul(nextArg(), nullptr, 10));
+            }
+            else if (strcmp(argv[i], "--bench") == 0) {
+                config.benchmark = nextArg();
+                if (config.benchmark != "alloc" && config.benchmark != "upload" && config.benchmark != "record" && config.benchmark != "instances" && config.benchmark != "cull" &&
+                    config.benchmark != "pipelines" && config.benchmark != "graph") {
+                    throw std::runtime_error("unknown benchmark " + config.benchmark);
+                }
+            }
+            else {
+                throw std::runtime_error(std::string("unknown option ") + argv[i]);
+            }
+        }
+
+        if (config.width == 0 || config.height == 0) {
+            throw std::runtime_error("render target size must be non-zero");
+        }
+        if (config.cull && config.instanceCount == 0) {
+            throw std::runtime_error("--cull needs --instances");
+        }
+        if (config.headless && config.frameCount == 0) {
+            config.frameCount = 1000;
+        }
+        if (!config.capturePath.empty() || !config.goldenPath.empty()) {
+            config.readback = true;
+        }
+        if (!config.goldenPath.empty() && config.frameCount == 0) {
+            throw std::runtime_error("--golden needs --frames");
+        }
+
+        return config;
+    }
+};
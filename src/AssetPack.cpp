@@ -0,0 +1,160 @@
+#include "AssetPack.h"
+
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+bool AssetPack::open(const std::string& path, bool verifyHashes)
+{
+    close();
+    if (!map(path)) return false;
+
+    this->verifyHashes = verifyHashes;
+    header = static_cast<const PackHeader*>(mapping);
+
+    bool valid = mappingSize >= sizeof(PackHeader) && header->magic == MAGIC && header->version == VERSION &&
+        header->fileSize == mappingSize &&
+        header->entryCount <= (mappingSize - sizeof(PackHeader)) / sizeof(PackEntry);
+    if (valid) {
+        entries = reinterpret_cast<const PackEntry*>(static_cast<const char*>(mapping) + sizeof(PackHeader));
+        for (uint32_t i = 0; i < header->entryCount && valid; i++) {
+            const PackEntry& entry = entries[i];
+            valid = memchr(entry.name, 0, NAME_SIZE) != nullptr &&
+                entry.offset % ENTRY_ALIGNMENT == 0 && entry.offset <= mappingSize && entry.size <= mappingSize - entry.offset &&
+                (i == 0 || strcmp(entries[i - 1].name, entry.name) < 0);
+        }
+    }
+    if (!valid) {
+        std::cout << "asset pack: " << path << " is malformed, ignoring" << std::endl;
+        close();
+        return false;
+    }
+
+    verified = std::make_unique<std::atomic<uint8_t>[]>(header->entryCount);
+    return true;
+}
+
+void AssetPack::close()
+{
+    unmap();
+    header = nullptr;
+    entries = nullptr;
+    verified.reset();
+}
+
+AssetView AssetPack::find(const std::string& name) const
+{
+    if (!header) return {};
+
+    uint32_t first = 0;
+    uint32_t last = header->entryCount;
+    while (first < last) {
+        uint32_t middle = first + (last - first) / 2;
+        int order = strcmp(entries[middle].name, name.c_str());
+        if (order == 0) {
+            const PackEntry& entry = entries[middle];
+            AssetView view;
+            view.data = static_cast<const char*>(mapping) + entry.offset;
+            view.size = static_cast<size_t>(entry.size);
+
+            // relaxed, the mapping is read only and the flag only spares hashing it again
+            if (verifyHashes && !verified[middle].load(std::memory_order_relaxed)) {
+                if (hash(view.data, view.size) != entry.hash) {
+                    throw std::runtime_error("asset pack entry " + name + " is corrupt!");
+                }
+                verified[middle].store(1, std::memory_order_relaxed);
+            }
+            return view;
+        }
+        if (order < 0) first = middle + 1;
+        else last = middle;
+    }
+    return {};
+}
+
+uint64_t AssetPack::hash(const void* data, size_t size)
+{
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+#ifdef _WIN32
+bool AssetPack::map(const std::string& path)
+{
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE) return false;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+        CloseHandle(file);
+        return false;
+    }
+
+    HANDLE view = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    void* data = view ? MapViewOfFile(view, FILE_MAP_READ, 0, 0, 0) : nullptr;
+    if (!data) {
+        if (view) CloseHandle(view);
+        CloseHandle(file);
+        return false;
+    }
+
+    fileHandle = file;
+    mappingHandle = view;
+    mapping = data;
+    mappingSize = static_cast<size_t>(size.QuadPart);
+    return true;
+}
+
+void AssetPack::unmap()
+{
+    if (mapping) UnmapViewOfFile(mapping);
+    if (mappingHandle) CloseHandle(mappingHandle);
+    if (fileHandle) CloseHandle(fileHandle);
+    mapping = nullptr;
+    mappingHandle = nullptr;
+    fileHandle = nullptr;
+    mappingSize = 0;
+}
+#else
+bool AssetPack::map(const std::string& path)
+{
+    int file = ::open(path.c_str(), O_RDONLY);
+    if (file < 0) return false;
+
+    struct stat status;
+    if (fstat(file, &status) != 0 || status.st_size == 0) {
+        ::close(file);
+        return false;
+    }
+
+    void* data = mmap(nullptr, static_cast<size_t>(status.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+    // the mapping keeps the file alive on its own
+    ::close(file);
+    if (data == MAP_FAILED) return false;
+
+    mapping = data;
+    mappingSize = static_cast<size_t>(status.st_size);
+    return true;
+}
+
+void AssetPack::unmap()
+{
+    if (mapping) munmap(mapping, mappingSize);
+    mapping = nullptr;
+    mappingSize = 0;
+}
+#endif
@@ -0,0 +1,87 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+/// <summary>
+/// Read-only view of one asset inside a mapped pack, valid while the pack stays open
+/// </summary>
+struct AssetView {
+	const void* data = nullptr;
+	size_t size = 0;
+
+	explicit operator bool() const { return data != nullptr; }
+};
+
+/// <summary>
+/// Single file archive that is memory mapped and read in place.
+/// Layout: PackHeader, then entryCount PackEntry records sorted by name, then the entry data,
+/// every entry starting on an ENTRY_ALIGNMENT boundary so SPIR-V and vertex data can be handed to Vulkan directly.
+/// Written by the AssetPacker tool.
+/// </summary>
+class AssetPack
+{
+public:
+	static constexpr uint32_t MAGIC = 0x50414B56; // "VKAP"
+	static constexpr uint32_t VERSION = 1;
+	static constexpr uint64_t ENTRY_ALIGNMENT = 64;
+	static constexpr size_t NAME_SIZE = 56;
+
+	struct PackHeader {
+		uint32_t magic;
+		uint32_t version;
+		uint32_t entryCount;
+		uint32_t reserved;
+		uint64_t fileSize;
+	};
+
+	struct PackEntry {
+		char name[NAME_SIZE]; // zero terminated
+		uint64_t offset;
+		uint64_t size;
+		uint64_t hash;
+	};
+
+	AssetPack() = default;
+	~AssetPack() { close(); }
+	AssetPack(const AssetPack&) = delete;
+	AssetPack& operator=(const AssetPack&) = delete;
+
+	/// <summary>
+	/// Maps the pack and validates its header and table of contents, false when it is missing or malformed.
+	/// verifyHashes checks each entry's hash the first time it is looked up.
+	/// </summary>
+	bool open(const std::string& path, bool verifyHashes);
+	void close();
+	bool isOpen() const { return mapping != nullptr; }
+
+	/// <summary>
+	/// Binary search over the sorted table of contents, an empty view when the pack has no such entry.
+	/// Safe to call from several threads at once.
+	/// </summary>
+	AssetView find(const std::string& name) const;
+	uint32_t getEntryCount() const { return header ? header->entryCount : 0; }
+
+	/// <summary>
+	/// FNV-1a 64 over an entry's bytes
+	/// </summary>
+	static uint64_t hash(const void* data, size_t size);
+
+private:
+	void* mapping = nullptr;
+	size_t mappingSize = 0;
+#ifdef _WIN32
+	void* fileHandle = nullptr;
+	void* mappingHandle = nullptr;
+#endif
+	const PackHeader* header = nullptr;
+	const PackEntry* entries = nullptr;
+	bool verifyHashes = false;
+	// one flag per entry, set once its hash matched. Two threads may both hash an entry, they reach the same verdict.
+	std::unique_ptr<std::atomic<uint8_t>[]> verified;
+
+	bool map(const std::string& path);
+	void unmap();
+};
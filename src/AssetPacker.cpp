@@ -0,0 +1,140 @@
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "AssetPack.h"
+#include "JobSystem.h"
+#include "MeshLoader.h"
+
+namespace {
+    template<typename T>
+    std::vector<char> bytesOf(const std::vector<T>& values)
+    {
+        const char* bytes = reinterpret_cast<const char*>(values.data());
+        return std::vector<char>(bytes, bytes + sizeof(T) * values.size());
+    }
+}
+
+/// <summary>
+/// Offline packer: AssetPacker OUTPUT FILE... stores every FILE under its path as given,
+/// run it from the directory the app loads its assets relative to. An OBJ file is imported and baked into
+/// meshes/NAME.vertices and meshes/NAME.indices instead, NAME being its file name without the extension, for --mesh NAME.
+/// </summary>
+int main(int argc, char** argv)
+{
+    if (argc < 3) {
+        std::cerr << "usage: AssetPacker OUTPUT FILE..." << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    struct Source {
+        std::string name;
+        std::vector<char> data;
+    };
+    std::vector<Source> sources;
+
+    JobSystem jobs;
+    for (int i = 2; i < argc; i++) {
+        std::string path = argv[i];
+        std::replace(path.begin(), path.end(), '\\', '/');
+
+        if (path.size() > 4 && path.compare(path.size() - 4, 4, ".obj") == 0) {
+            size_t slash = path.find_last_of('/');
+            std::string name = path.substr(slash == std::string::npos ? 0 : slash + 1);
+            name = "meshes/" + name.substr(0, name.size() - 4);
+            if (name.size() + strlen(".vertices") >= AssetPack::NAME_SIZE) {
+                std::cerr << "asset name too long: " << name << std::endl;
+                return EXIT_FAILURE;
+            }
+
+            if (jobs.getThreadCount() == 0) jobs.create(std::max(std::thread::hardware_concurrency(), 1u) - 1);
+            Mesh mesh;
+            try {
+                MeshLoader loader(jobs);
+                mesh = loader.loadObj(argv[i]);
+                loader.printStats(std::cout);
+            }
+            catch (const std::exception& e) {
+                std::cerr << path << ": " << e.what() << std::endl;
+                return EXIT_FAILURE;
+            }
+            sources.push_back({ name + ".vertices", bytesOf(MeshLoader::flatten(mesh)) });
+            sources.push_back({ name + ".indices", bytesOf(mesh.indices) });
+            continue;
+        }
+
+        Source source;
+        source.name = path;
+        if (source.name.size() >= AssetPack::NAME_SIZE) {
+            std::cerr << "asset name too long: " << source.name << std::endl;
+            return EXIT_FAILURE;
+        }
+
+        std::ifstream file(argv[i], std::ios::ate | std::ios::binary);
+        if (!file.is_open()) {
+            std::cerr << "failed to open " << argv[i] << std::endl;
+            return EXIT_FAILURE;
+        }
+        source.data.resize((size_t)file.tellg());
+        file.seekg(0);
+        file.read(source.data.data(), source.data.size());
+        sources.push_back(std::move(source));
+    }
+    jobs.destroy();
+
+    // the reader binary searches the table of contents
+    std::sort(sources.begin(), sources.end(), [](const Source& a, const Source& b) { return a.name < b.name; });
+    for (size_t i = 1; i < sources.size(); i++) {
+        if (sources[i - 1].name == sources[i].name) {
+            std::cerr << "duplicate asset " << sources[i].name << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    auto align = [](uint64_t offset) { return (offset + AssetPack::ENTRY_ALIGNMENT - 1) / AssetPack::ENTRY_ALIGNMENT * AssetPack::ENTRY_ALIGNMENT; };
+
+    std::vector<AssetPack::PackEntry> entries(sources.size());
+    uint64_t offset = align(sizeof(AssetPack::PackHeader) + sizeof(AssetPack::PackEntry) * entries.size());
+    for (size_t i = 0; i < sources.size(); i++) {
+        memset(&entries[i], 0, sizeof(entries[i]));
+        memcpy(entries[i].name, sources[i].name.c_str(), sources[i].name.size());
+        entries[i].offset = offset;
+        entries[i].size = sources[i].data.size();
+        entries[i].hash = AssetPack::hash(sources[i].data.data(), sources[i].data.size());
+        offset = align(offset + entries[i].size);
+    }
+
+    AssetPack::PackHeader header = {};
+    header.magic = AssetPack::MAGIC;
+    header.version = AssetPack::VERSION;
+    header.entryCount = static_cast<uint32_t>(entries.size());
+    header.fileSize = offset;
+
+    std::ofstream out(argv[1], std::ios::binary | std::ios::trunc);
+    if (!out.is_open()) {
+        std::cerr << "failed to open " << argv[1] << " for writing" << std::endl;
+        return EXIT_FAILURE;
+    }
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(entries.data()), sizeof(AssetPack::PackEntry) * entries.size());
+
+    std::vector<char> padding(AssetPack::ENTRY_ALIGNMENT, 0);
+    for (size_t i = 0; i < sources.size(); i++) {
+        out.write(padding.data(), static_cast<std::streamsize>(entries[i].offset - (uint64_t)out.tellp()));
+        out.write(sources[i].data.data(), sources[i].data.size());
+    }
+    out.write(padding.data(), static_cast<std::streamsize>(header.fileSize - (uint64_t)out.tellp()));
+
+    if (!out) {
+        std::cerr << "failed to write " << argv[1] << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::cout << "packed " << entries.size() << " assets, " << header.fileSize << " bytes into " << argv[1] << std::endl;
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,133 @@
+#include "BindlessDescriptors.h"
+
+#include <stdexcept>
+
+void BindlessDescriptors::create(vk::Device device, uint32_t frameCount, vk::ShaderStageFlags stages, uint32_t bindlessCapacity)
+{
+    this->device = device;
+    bindless = bindlessCapacity > 0;
+    uint32_t capacity = bindless ? bindlessCapacity : FALLBACK_SLOTS;
+
+    slots.assign(capacity, vk::DescriptorBufferInfo());
+    freeSlots.resize(capacity);
+    for (uint32_t i = 0; i < capacity; i++) {
+        freeSlots[i] = capacity - 1 - i;
+    }
+
+    auto binding = vk::DescriptorSetLayoutBinding();
+    binding.binding = 0;
+    binding.descriptorType = vk::DescriptorType::eStorageBuffer;
+    binding.descriptorCount = capacity;
+    binding.stageFlags = stages;
+
+    auto layoutInfo = vk::DescriptorSetLayoutCreateInfo();
+    layoutInfo.bindingCount = 1;
+    layoutInfo.pBindings = &binding;
+
+    auto poolSize = vk::DescriptorPoolSize(vk::DescriptorType::eStorageBuffer, capacity);
+    auto poolInfo = vk::DescriptorPoolCreateInfo();
+    poolInfo.maxSets = 1;
+    poolInfo.poolSizeCount = 1;
+    poolInfo.pPoolSizes = &poolSize;
+
+    if (!bindless) {
+        layout = device.createDescriptorSetLayout(layoutInfo);
+        for (uint32_t i = 0; i < frameCount; i++) {
+            pools.push_back(device.createDescriptorPool(poolInfo));
+        }
+        return;
+    }
+
+    // slots may be written while the table is bound by frames in flight, unused ones are never read
+    vk::DescriptorBindingFlagsEXT bindingFlags = vk::DescriptorBindingFlagBitsEXT::eUpdateAfterBind |
+        vk::DescriptorBindingFlagBitsEXT::ePartiallyBound | vk::DescriptorBindingFlagBitsEXT::eVariableDescriptorCount;
+    auto bindingFlagsInfo = vk::DescriptorSetLayoutBindingFlagsCreateInfoEXT();
+    bindingFlagsInfo.bindingCount = 1;
+    bindingFlagsInfo.pBindingFlags = &bindingFlags;
+    layoutInfo.flags = vk::DescriptorSetLayoutCreateFlagBits::eUpdateAfterBindPoolEXT;
+    layoutInfo.pNext = &bindingFlagsInfo;
+    layout = device.createDescriptorSetLayout(layoutInfo);
+
+    poolInfo.flags = vk::DescriptorPoolCreateFlagBits::eUpdateAfterBindEXT;
+    pools.push_back(device.createDescriptorPool(poolInfo));
+
+    auto countInfo = vk::DescriptorSetVariableDescriptorCountAllocateInfoEXT();
+    countInfo.descriptorSetCount = 1;
+    countInfo.pDescriptorCounts = &capacity;
+
+    auto allocInfo = vk::DescriptorSetAllocateInfo();
+    allocInfo.descriptorPool = pools[0];
+    allocInfo.descriptorSetCount = 1;
+    allocInfo.pSetLayouts = &layout;
+    allocInfo.pNext = &countInfo;
+    table = device.allocateDescriptorSets(allocInfo)[0];
+}
+
+void BindlessDescriptors::destroy()
+{
+    for (vk::DescriptorPool pool : pools) {
+        device.destroyDescriptorPool(pool);
+    }
+    pools.clear();
+    if (layout) {
+        device.destroyDescriptorSetLayout(layout);
+        layout = nullptr;
+    }
+    table = nullptr;
+    slots.clear();
+    freeSlots.clear();
+}
+
+uint32_t BindlessDescriptors::addStorageBuffer(vk::Buffer buffer, vk::DeviceSize offset, vk::DeviceSize range)
+{
+    if (freeSlots.empty()) {
+        throw std::runtime_error("bindless descriptor table is full!");
+    }
+    uint32_t index = freeSlots.back();
+    freeSlots.pop_back();
+    slots[index] = vk::DescriptorBufferInfo(buffer, offset, range);
+
+    if (bindless) {
+        auto write = vk::WriteDescriptorSet();
+        write.dstSet = table;
+        write.dstBinding = 0;
+        write.dstArrayElement = index;
+        write.descriptorCount = 1;
+        write.descriptorType = vk::DescriptorType::eStorageBuffer;
+        write.pBufferInfo = &slots[index];
+        device.updateDescriptorSets(write, nullptr);
+    }
+    return index;
+}
+
+void BindlessDescriptors::remove(uint32_t index)
+{
+    if (index >= slots.size() || !slots[index].buffer) {
+        throw std::runtime_error("removing a bindless slot that is not in use!");
+    }
+    // partially bound: the stale descriptor stays in the table until the slot is reused, nothing reads it
+    slots[index] = vk::DescriptorBufferInfo();
+    freeSlots.push_back(index);
+}
+
+vk::DescriptorSet BindlessDescriptors::beginFrame(uint32_t frameIndex)
+{
+    if (bindless) return table;
+
+    device.resetDescriptorPool(pools[frameIndex]);
+    auto allocInfo = vk::DescriptorSetAllocateInfo();
+    allocInfo.descriptorPool = pools[frameIndex];
+    allocInfo.descriptorSetCount = 1;
+    allocInfo.pSetLayouts = &layout;
+    vk::DescriptorSet set = device.allocateDescriptorSets(allocInfo)[0];
+    if (!slots[0].buffer) return set;
+
+    auto write = vk::WriteDescriptorSet();
+    write.dstSet = set;
+    write.dstBinding = 0;
+    write.descriptorCount = FALLBACK_SLOTS;
+    write.descriptorType = vk::DescriptorType::eStorageBuffer;
+    write.pBufferInfo = slots.data();
+    device.updateDescriptorSets(write, nullptr);
+    return set;
+}
@@ -0,0 +1,56 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include <vulkan/vulkan.hpp>
+
+/// <summary>
+/// Storage buffers addressed by index from push constants instead of by binding.
+/// With descriptor indexing all of them live in one update-after-bind, partially bound set with a variable descriptor count:
+/// a buffer is written once when it is added and the set is bound once per command buffer.
+/// Without it every frame allocates a set with a single storage buffer from its own pool, which is reset as a whole, and rewrites it.
+/// That set is a plain binding rather than an array, so the fallback needs no dynamic indexing feature either.
+/// Slots come from a free list, so indices stay small and stable while buffers come and go.
+/// </summary>
+class BindlessDescriptors
+{
+public:
+	// the fallback shader variant declares one storage buffer, not an array
+	static constexpr uint32_t FALLBACK_SLOTS = 1;
+
+	/// <summary>
+	/// bindlessCapacity is the size of the descriptor indexing table, 0 selects the per-frame fallback
+	/// </summary>
+	void create(vk::Device device, uint32_t frameCount, vk::ShaderStageFlags stages, uint32_t bindlessCapacity);
+	void destroy();
+
+	/// <summary>
+	/// Takes a slot off the free list and points it at the buffer range, returns the index shaders address it with
+	/// </summary>
+	uint32_t addStorageBuffer(vk::Buffer buffer, vk::DeviceSize offset, vk::DeviceSize range);
+	/// <summary>
+	/// Returns the slot to the free list, the caller guarantees no frame in flight still reads it
+	/// </summary>
+	void remove(uint32_t index);
+
+	/// <summary>
+	/// The set to bind for frameIndex. The fallback resets the frame's pool and writes a fresh set,
+	/// so the caller guarantees the GPU is done with frameIndex.
+	/// </summary>
+	vk::DescriptorSet beginFrame(uint32_t frameIndex);
+
+	vk::DescriptorSetLayout getLayout() const { return layout; }
+	bool isBindless() const { return bindless; }
+	uint32_t getCapacity() const { return static_cast<uint32_t>(slots.size()); }
+	uint32_t getUsedCount() const { return static_cast<uint32_t>(slots.size() - freeSlots.size()); }
+
+private:
+	vk::Device device;
+	bool bindless = false;
+	vk::DescriptorSetLayout layout;
+	std::vector<vk::DescriptorPool> pools; // one for the bindless table, one per frame otherwise
+	vk::DescriptorSet table;
+
+	std::vector<vk::DescriptorBufferInfo> slots; // a null buffer marks a free slot
+	std::vector<uint32_t> freeSlots; // popped from the back, lowest index last
+};
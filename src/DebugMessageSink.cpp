@@ -0,0 +1,289 @@
+#include "DebugMessageSink.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <stdexcept>
+
+namespace {
+    const auto WRITE_INTERVAL = std::chrono::milliseconds(10);
+    const size_t REPORT_TEXT_LENGTH = 160;
+    const size_t REPORT_REPEATED_IDS = 10;
+
+    const vk::DebugUtilsMessageSeverityFlagBitsEXT SEVERITIES[] = {
+        vk::DebugUtilsMessageSeverityFlagBitsEXT::eVerbose,
+        vk::DebugUtilsMessageSeverityFlagBitsEXT::eInfo,
+        vk::DebugUtilsMessageSeverityFlagBitsEXT::eWarning,
+        vk::DebugUtilsMessageSeverityFlagBitsEXT::eError,
+    };
+
+    const char* severityName(uint32_t severity)
+    {
+        if (severity & VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT) return "error";
+        if (severity & VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT) return "warning";
+        if (severity & VK_DEBUG_UTILS_MESSAGE_SEVERITY_INFO_BIT_EXT) return "info";
+        return "verbose";
+    }
+
+    const char* typeName(uint32_t types)
+    {
+        if (types & VK_DEBUG_UTILS_MESSAGE_TYPE_PERFORMANCE_BIT_EXT) return "performance";
+        if (types & VK_DEBUG_UTILS_MESSAGE_TYPE_VALIDATION_BIT_EXT) return "validation";
+        return "general";
+    }
+
+    uint64_t hash(uint64_t value, const char* text)
+    {
+        // FNV-1a
+        value ^= 14695981039346656037ull;
+        value *= 1099511628211ull;
+        for (; text && *text; text++) {
+            value ^= static_cast<unsigned char>(*text);
+            value *= 1099511628211ull;
+        }
+        return value ? value : 1; // 0 marks a free id slot
+    }
+
+    void copyTruncated(char* destination, size_t size, const char* source)
+    {
+        size_t length = source ? std::min(strlen(source), size - 1) : 0;
+        memcpy(destination, source, length);
+        destination[length] = '\0';
+    }
+}
+
+void DebugMessageSink::create(std::ostream& out, vk::DebugUtilsMessageSeverityFlagBitsEXT minSeverity, vk::DebugUtilsMessageTypeFlagsEXT types)
+{
+    destroy();
+
+    this->out = &out;
+    severities = vk::DebugUtilsMessageSeverityFlagsEXT();
+    for (auto severity : SEVERITIES) {
+        if (static_cast<uint32_t>(severity) >= static_cast<uint32_t>(minSeverity)) severities |= severity;
+    }
+    this->types = types;
+
+    messages = std::make_unique<std::array<Message, QUEUE_CAPACITY>>();
+    for (uint32_t i = 0; i < QUEUE_CAPACITY; i++) {
+        (*messages)[i].sequence.store(i, std::memory_order_relaxed);
+    }
+    enqueuePosition.store(0, std::memory_order_relaxed);
+    dequeuePosition = 0;
+    ids = std::make_unique<std::array<IdEntry, ID_CAPACITY>>();
+    received = 0;
+    dropped = 0;
+    untracked = 0;
+
+    stopping = false;
+    writer = std::thread(&DebugMessageSink::writerLoop, this);
+}
+
+void DebugMessageSink::destroy()
+{
+    if (!writer.joinable()) return;
+
+    {
+        std::lock_guard<std::mutex> lock(wakeMutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    writer.join();
+
+    printReport();
+    messages.reset();
+    ids.reset();
+    out = nullptr;
+}
+
+void DebugMessageSink::apply(vk::DebugUtilsMessengerCreateInfoEXT& createInfo)
+{
+    createInfo
+        .setMessageSeverity(severities)
+        .setMessageType(types)
+        .setPfnUserCallback(callback)
+        .setPUserData(this);
+}
+
+vk::DebugUtilsMessageSeverityFlagBitsEXT DebugMessageSink::parseSeverity(const std::string& name)
+{
+    if (name == "verbose") return vk::DebugUtilsMessageSeverityFlagBitsEXT::eVerbose;
+    if (name == "info") return vk::DebugUtilsMessageSeverityFlagBitsEXT::eInfo;
+    if (name == "warning") return vk::DebugUtilsMessageSeverityFlagBitsEXT::eWarning;
+    if (name == "error") return vk::DebugUtilsMessageSeverityFlagBitsEXT::eError;
+    throw std::runtime_error("unknown debug message severity " + name);
+}
+
+vk::DebugUtilsMessageTypeFlagsEXT DebugMessageSink::parseTypes(const std::string& names)
+{
+    vk::DebugUtilsMessageTypeFlagsEXT parsed;
+    size_t begin = 0;
+    while (begin <= names.size()) {
+        size_t end = std::min(names.find(',', begin), names.size());
+        std::string name = names.substr(begin, end - begin);
+        if (name == "general") parsed |= vk::DebugUtilsMessageTypeFlagBitsEXT::eGeneral;
+        else if (name == "validation") parsed |= vk::DebugUtilsMessageTypeFlagBitsEXT::eValidation;
+        else if (name == "performance") parsed |= vk::DebugUtilsMessageTypeFlagBitsEXT::ePerformance;
+        else throw std::runtime_error("unknown debug message type " + name);
+        begin = end + 1;
+    }
+    return parsed;
+}
+
+VKAPI_ATTR VkBool32 VKAPI_CALL DebugMessageSink::callback(VkDebugUtilsMessageSeverityFlagBitsEXT messageSeverity, VkDebugUtilsMessageTypeFlagsEXT messageType,
+    const VkDebugUtilsMessengerCallbackDataEXT* pCallbackData, void* pUserData)
+{
+    static_cast<DebugMessageSink*>(pUserData)->receive(messageSeverity, messageType, *pCallbackData);
+    return VK_FALSE;
+}
+
+/// <summary>
+/// Runs on whatever thread the driver or layer calls back on, never locks or allocates
+/// </summary>
+void DebugMessageSink::receive(VkDebugUtilsMessageSeverityFlagBitsEXT severity, VkDebugUtilsMessageTypeFlagsEXT messageTypes, const VkDebugUtilsMessengerCallbackDataEXT& data)
+{
+    if (!(static_cast<uint32_t>(severities) & severity) || !(static_cast<uint32_t>(types) & messageTypes)) return;
+    received.fetch_add(1, std::memory_order_relaxed);
+
+    // the id number is 0 for messages without one, their name or else their text tells them apart
+    const char* identity = data.pMessageIdName ? data.pMessageIdName : data.pMessage;
+    bool first;
+    uint32_t idSlot = countId(hash(static_cast<uint32_t>(data.messageIdNumber), identity), severity, messageTypes, first);
+    if (!first) return;
+
+    uint64_t position = enqueuePosition.load(std::memory_order_relaxed);
+    Message* message;
+    for (;;) {
+        message = &(*messages)[position & (QUEUE_CAPACITY - 1)];
+        int64_t turn = static_cast<int64_t>(message->sequence.load(std::memory_order_acquire) - position);
+        if (turn == 0) {
+            if (enqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) break;
+        }
+        else if (turn < 0) {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        else {
+            position = enqueuePosition.load(std::memory_order_relaxed);
+        }
+    }
+
+    message->severity = severity;
+    message->types = messageTypes;
+    message->idSlot = idSlot;
+    copyTruncated(message->idName, sizeof(message->idName), data.pMessageIdName);
+    copyTruncated(message->text, sizeof(message->text), data.pMessage);
+    message->sequence.store(position + 1, std::memory_order_release);
+
+    if (severity & VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT) {
+        // an error may be the last thing before a crash, don't wait for the next pass
+        errorPending.store(true, std::memory_order_relaxed);
+        wake.notify_one();
+    }
+}
+
+/// <summary>
+/// Counts one occurrence of key and returns its slot, first is true for the first occurrence.
+/// Slots are claimed once and never freed, a full table returns ID_CAPACITY and every occurrence counts as first.
+/// </summary>
+uint32_t DebugMessageSink::countId(uint64_t key, uint32_t severity, uint32_t messageTypes, bool& first)
+{
+    for (uint32_t probe = 0; probe < ID_CAPACITY; probe++) {
+        uint32_t slot = static_cast<uint32_t>(key + probe) & (ID_CAPACITY - 1);
+        IdEntry& entry = (*ids)[slot];
+
+        uint64_t current = entry.key.load(std::memory_order_acquire);
+        if (current == 0 && entry.key.compare_exchange_strong(current, key, std::memory_order_acq_rel)) {
+            entry.severity = severity;
+            entry.types = messageTypes;
+            current = key;
+        }
+        if (current == key) {
+            first = entry.count.fetch_add(1, std::memory_order_relaxed) == 0;
+            return slot;
+        }
+    }
+
+    untracked.fetch_add(1, std::memory_order_relaxed);
+    first = true;
+    return ID_CAPACITY;
+}
+
+void DebugMessageSink::writerLoop()
+{
+    std::unique_lock<std::mutex> lock(wakeMutex);
+    for (;;) {
+        // a last pass after destroy() so nothing queued before it is lost
+        bool stop = wake.wait_for(lock, WRITE_INTERVAL, [this]() { return stopping || errorPending.load(std::memory_order_relaxed); });
+        stop = stop && stopping;
+        errorPending.store(false, std::memory_order_relaxed);
+        lock.unlock();
+        if (writeQueued()) out->flush();
+        if (stop) return;
+        lock.lock();
+    }
+}
+
+/// <summary>
+/// Writes every message the producers have finished, true when there was any. Only the writer thread calls this.
+/// </summary>
+bool DebugMessageSink::writeQueued()
+{
+    bool wrote = false;
+    for (;;) {
+        Message& message = (*messages)[dequeuePosition & (QUEUE_CAPACITY - 1)];
+        if (message.sequence.load(std::memory_order_acquire) != dequeuePosition + 1) return wrote;
+
+        *out << "validation layer (" << severityName(message.severity) << ", " << typeName(message.types) << "): " << message.text << '\n';
+        if (message.idSlot < ID_CAPACITY) {
+            IdEntry& entry = (*ids)[message.idSlot];
+            entry.name = message.idName;
+            entry.firstText = message.text;
+        }
+
+        message.sequence.store(dequeuePosition + QUEUE_CAPACITY, std::memory_order_release);
+        dequeuePosition++;
+        wrote = true;
+    }
+}
+
+/// <summary>
+/// Totals, the most repeated ids and every performance warning with how often it came up
+/// </summary>
+void DebugMessageSink::printReport()
+{
+    uint64_t total = received.load();
+    if (total == 0) return;
+
+    std::vector<const IdEntry*> repeated;
+    std::vector<const IdEntry*> performance;
+    uint64_t unique = 0;
+    for (const IdEntry& entry : *ids) {
+        uint32_t count = entry.count.load();
+        if (count == 0) continue;
+        unique++;
+        if (count > 1) repeated.push_back(&entry);
+        if (entry.types & VK_DEBUG_UTILS_MESSAGE_TYPE_PERFORMANCE_BIT_EXT) performance.push_back(&entry);
+    }
+    auto byCount = [](const IdEntry* a, const IdEntry* b) { return a->count.load() > b->count.load(); };
+    std::sort(repeated.begin(), repeated.end(), byCount);
+    std::sort(performance.begin(), performance.end(), byCount);
+
+    auto describe = [](const IdEntry& entry) {
+        std::string text = entry.name.empty() ? entry.firstText : entry.name + ": " + entry.firstText;
+        if (text.size() > REPORT_TEXT_LENGTH) text = text.substr(0, REPORT_TEXT_LENGTH) + "...";
+        return text.empty() ? std::string("(first message dropped)") : text;
+    };
+
+    *out << "debug messages: " << total << " received, " << unique << " distinct, " << total - unique - untracked.load() << " repeats not written, "
+        << dropped.load() << " dropped with a full queue" << std::endl;
+    for (size_t i = 0; i < repeated.size() && i < REPORT_REPEATED_IDS; i++) {
+        *out << std::setw(8) << repeated[i]->count.load() << "x " << severityName(repeated[i]->severity) << " " << describe(*repeated[i]) << std::endl;
+    }
+    if (!performance.empty()) {
+        *out << "performance warnings: " << performance.size() << " distinct" << std::endl;
+        for (const IdEntry* entry : performance) {
+            *out << std::setw(8) << entry->count.load() << "x " << describe(*entry) << std::endl;
+        }
+    }
+}
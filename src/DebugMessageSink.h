@@ -0,0 +1,101 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <vulkan/vulkan.hpp>
+
+/// <summary>
+/// Receives VK_EXT_debug_utils messages without slowing down the thread the driver calls back on. The callback filters by
+/// severity and type, counts repeats of a message id instead of printing them again and hands new messages to a writer
+/// thread through a lock-free queue. Performance warnings are tallied per id and reported at shutdown.
+/// </summary>
+class DebugMessageSink
+{
+public:
+	static constexpr uint32_t QUEUE_CAPACITY = 256; // messages waiting for the writer, a power of two
+	static constexpr uint32_t MESSAGE_SIZE = 2048; // longer messages are truncated
+	static constexpr uint32_t ID_CAPACITY = 1024; // distinct message ids counted, a power of two
+
+	/// <summary>
+	/// Starts the writer thread. Messages below minSeverity or of none of types never reach the callback, see apply().
+	/// </summary>
+	void create(std::ostream& out, vk::DebugUtilsMessageSeverityFlagBitsEXT minSeverity, vk::DebugUtilsMessageTypeFlagsEXT types);
+	/// <summary>
+	/// Writes what is queued, stops the writer and prints the summary and performance report, call it after the last messenger is gone
+	/// </summary>
+	void destroy();
+
+	/// <summary>
+	/// Fills in severity, type, callback and user data, for the instance create info as well as the messenger
+	/// </summary>
+	void apply(vk::DebugUtilsMessengerCreateInfoEXT& createInfo);
+
+	/// <summary>
+	/// verbose, info, warning or error
+	/// </summary>
+	static vk::DebugUtilsMessageSeverityFlagBitsEXT parseSeverity(const std::string& name);
+	/// <summary>
+	/// Comma separated list of general, validation and performance
+	/// </summary>
+	static vk::DebugUtilsMessageTypeFlagsEXT parseTypes(const std::string& names);
+
+private:
+	struct Message {
+		std::atomic<uint32_t> sequence{ 0 };
+		uint32_t severity;
+		uint32_t types;
+		uint32_t idSlot; // ID_CAPACITY when the id table was full
+		char idName[64];
+		char text[MESSAGE_SIZE];
+	};
+
+	/// <summary>
+	/// One per distinct message id, claimed with a compare exchange on key by the thread that also fills in severity and
+	/// types. name and text are filled in by the writer thread from the first message. Read back after the writer is joined.
+	/// </summary>
+	struct IdEntry {
+		std::atomic<uint64_t> key{ 0 };
+		std::atomic<uint32_t> count{ 0 };
+		uint32_t severity = 0;
+		uint32_t types = 0;
+		std::string name;
+		std::string firstText;
+	};
+
+	std::ostream* out = nullptr;
+	vk::DebugUtilsMessageSeverityFlagsEXT severities;
+	vk::DebugUtilsMessageTypeFlagsEXT types;
+
+	// bounded multi producer queue, every slot's sequence says whose turn it is
+	std::unique_ptr<std::array<Message, QUEUE_CAPACITY>> messages;
+	std::atomic<uint64_t> enqueuePosition{ 0 };
+	uint64_t dequeuePosition = 0;
+
+	std::unique_ptr<std::array<IdEntry, ID_CAPACITY>> ids;
+
+	std::atomic<uint64_t> received{ 0 };
+	std::atomic<uint64_t> dropped{ 0 }; // queue full
+	std::atomic<uint64_t> untracked{ 0 }; // id table full, written every time
+
+	std::mutex wakeMutex;
+	std::condition_variable wake;
+	bool stopping = false;
+	std::atomic<bool> errorPending{ false };
+	std::thread writer;
+
+	static VKAPI_ATTR VkBool32 VKAPI_CALL callback(VkDebugUtilsMessageSeverityFlagBitsEXT messageSeverity, VkDebugUtilsMessageTypeFlagsEXT messageType,
+		const VkDebugUtilsMessengerCallbackDataEXT* pCallbackData, void* pUserData);
+	void receive(VkDebugUtilsMessageSeverityFlagBitsEXT severity, VkDebugUtilsMessageTypeFlagsEXT messageTypes, const VkDebugUtilsMessengerCallbackDataEXT& data);
+	uint32_t countId(uint64_t key, uint32_t severity, uint32_t messageTypes, bool& first);
+	void writerLoop();
+	bool writeQueued();
+	void printReport();
+};
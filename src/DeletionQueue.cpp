@@ -0,0 +1,85 @@
+#include "DeletionQueue.h"
+
+void DeletionQueue::create(vk::Device device, MemoryAllocator& allocator)
+{
+    this->device = device;
+    this->allocator = &allocator;
+}
+
+void DeletionQueue::destroy()
+{
+    for (auto& entry : entries) {
+        destroyEntry(entry);
+    }
+    entries.clear();
+}
+
+void DeletionQueue::push(uint64_t lastUse, Buffer& buffer)
+{
+    enqueue(lastUse, buffer.buffer, vk::ObjectType::eBuffer, buffer.allocation);
+    buffer = Buffer();
+}
+
+void DeletionQueue::push(uint64_t lastUse, vk::Image image, Allocation& memory)
+{
+    enqueue(lastUse, image, vk::ObjectType::eImage, memory);
+    memory = Allocation();
+}
+
+void DeletionQueue::push(uint64_t lastUse, vk::ImageView imageView)
+{
+    enqueue(lastUse, imageView, vk::ObjectType::eImageView);
+}
+
+void DeletionQueue::push(uint64_t lastUse, vk::Framebuffer framebuffer)
+{
+    enqueue(lastUse, framebuffer, vk::ObjectType::eFramebuffer);
+}
+
+void DeletionQueue::push(uint64_t lastUse, vk::Pipeline pipeline)
+{
+    enqueue(lastUse, pipeline, vk::ObjectType::ePipeline);
+}
+
+void DeletionQueue::push(uint64_t lastUse, vk::SwapchainKHR swapChain)
+{
+    enqueue(lastUse, swapChain, vk::ObjectType::eSwapchainKHR);
+}
+
+size_t DeletionQueue::retire(uint64_t completed)
+{
+    size_t due = 0;
+    while (due < entries.size() && entries[due].lastUse <= completed) {
+        destroyEntry(entries[due]);
+        due++;
+    }
+    entries.erase(entries.begin(), entries.begin() + due);
+    return due;
+}
+
+void DeletionQueue::destroyEntry(Entry& entry)
+{
+    switch (entry.type) {
+    case vk::ObjectType::eBuffer:
+        device.destroyBuffer(vk::Buffer((VkBuffer)entry.handle));
+        break;
+    case vk::ObjectType::eImage:
+        device.destroyImage(vk::Image((VkImage)entry.handle));
+        break;
+    case vk::ObjectType::eImageView:
+        device.destroyImageView(vk::ImageView((VkImageView)entry.handle));
+        break;
+    case vk::ObjectType::eFramebuffer:
+        device.destroyFramebuffer(vk::Framebuffer((VkFramebuffer)entry.handle));
+        break;
+    case vk::ObjectType::ePipeline:
+        device.destroyPipeline(vk::Pipeline((VkPipeline)entry.handle));
+        break;
+    case vk::ObjectType::eSwapchainKHR:
+        device.destroySwapchainKHR(vk::SwapchainKHR((VkSwapchainKHR)entry.handle));
+        break;
+    default:
+        break;
+    }
+    allocator->free(entry.memory);
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include <cstdint>
+#include <deque>
+
+#include <vulkan/vulkan.hpp>
+
+#include "MemoryAllocator.h"
+
+/// <summary>
+/// Destroys objects once the GPU work that last used them has retired instead of waiting for the device to go idle.
+/// Each object is queued with the frame number (or timeline value) of its last use, retire() is told which value
+/// has completed. Values are expected to grow, so only a prefix of the queue is ever due.
+/// Pushing takes ownership, memory and views go with their objects.
+/// </summary>
+class DeletionQueue
+{
+public:
+	void create(vk::Device device, MemoryAllocator& allocator);
+	/// <summary>
+	/// Destroys everything still queued, the caller guarantees the device is idle
+	/// </summary>
+	void destroy();
+
+	void push(uint64_t lastUse, Buffer& buffer);
+	void push(uint64_t lastUse, vk::Image image, Allocation& memory);
+	void push(uint64_t lastUse, vk::ImageView imageView);
+	void push(uint64_t lastUse, vk::Framebuffer framebuffer);
+	void push(uint64_t lastUse, vk::Pipeline pipeline);
+	void push(uint64_t lastUse, vk::SwapchainKHR swapChain);
+
+	/// <summary>
+	/// Destroys everything last used at or before completed, returns how many objects went
+	/// </summary>
+	size_t retire(uint64_t completed);
+	size_t size() const { return entries.size(); }
+
+private:
+	struct Entry {
+		uint64_t lastUse;
+		vk::ObjectType type;
+		uint64_t handle;
+		Allocation memory;
+	};
+
+	vk::Device device;
+	MemoryAllocator* allocator = nullptr;
+	std::deque<Entry> entries;
+
+	template<typename T>
+	void enqueue(uint64_t lastUse, T object, vk::ObjectType type, Allocation memory = Allocation()) {
+		if (!object) return;
+		entries.push_back({ lastUse, type, (uint64_t)static_cast<typename T::CType>(object), memory });
+	}
+	void destroyEntry(Entry& entry);
+};
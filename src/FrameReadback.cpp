@@ -0,0 +1,377 @@
+#include "FrameReadback.h"
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+namespace {
+    bool isBgra(vk::Format format)
+    {
+        return format == vk::Format::eB8G8R8A8Unorm || format == vk::Format::eB8G8R8A8Srgb;
+    }
+
+    bool isRgba(vk::Format format)
+    {
+        return format == vk::Format::eR8G8B8A8Unorm || format == vk::Format::eR8G8B8A8Srgb;
+    }
+
+    bool endsWith(const std::string& text, const std::string& suffix)
+    {
+        return text.size() >= suffix.size() && text.compare(text.size() - suffix.size(), suffix.size(), suffix) == 0;
+    }
+
+    /// <summary>
+    /// Tightly packed RGB rows, optionally each preceded by a PNG filter type byte of 0
+    /// </summary>
+    std::vector<uint8_t> toRgb(const FrameReadback::Capture& capture, bool filterBytes)
+    {
+        size_t rowBytes = size_t(capture.width) * 3 + (filterBytes ? 1 : 0);
+        std::vector<uint8_t> rgb(rowBytes * capture.height);
+        for (uint32_t y = 0; y < capture.height; y++) {
+            const uint8_t* source = capture.pixels + size_t(y) * capture.width * 4;
+            uint8_t* target = rgb.data() + y * rowBytes;
+            if (filterBytes) *target++ = 0;
+            for (uint32_t x = 0; x < capture.width; x++, source += 4, target += 3) {
+                target[0] = source[capture.bgra ? 2 : 0];
+                target[1] = source[1];
+                target[2] = source[capture.bgra ? 0 : 2];
+            }
+        }
+        return rgb;
+    }
+
+    uint32_t crc32(const uint8_t* data, size_t size, uint32_t crc = 0)
+    {
+        static const std::array<uint32_t, 256> table = []() {
+            std::array<uint32_t, 256> entries;
+            for (uint32_t i = 0; i < 256; i++) {
+                uint32_t c = i;
+                for (int k = 0; k < 8; k++) {
+                    c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+                }
+                entries[i] = c;
+            }
+            return entries;
+        }();
+
+        crc = ~crc;
+        for (size_t i = 0; i < size; i++) {
+            crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+        }
+        return ~crc;
+    }
+
+    void appendBigEndian(std::vector<uint8_t>& out, uint32_t value)
+    {
+        out.push_back(uint8_t(value >> 24));
+        out.push_back(uint8_t(value >> 16));
+        out.push_back(uint8_t(value >> 8));
+        out.push_back(uint8_t(value));
+    }
+
+    void writeChunk(std::ofstream& file, const char type[4], const std::vector<uint8_t>& data)
+    {
+        std::vector<uint8_t> chunk;
+        appendBigEndian(chunk, static_cast<uint32_t>(data.size()));
+        chunk.insert(chunk.end(), type, type + 4);
+        chunk.insert(chunk.end(), data.begin(), data.end());
+        appendBigEndian(chunk, crc32(chunk.data() + 4, chunk.size() - 4));
+        file.write(reinterpret_cast<const char*>(chunk.data()), chunk.size());
+    }
+
+    /// <summary>
+    /// zlib stream of stored deflate blocks. Captures are written on the fly, compression is left to whoever keeps them.
+    /// </summary>
+    std::vector<uint8_t> zlibStore(const std::vector<uint8_t>& data)
+    {
+        const size_t MAX_BLOCK = 65535;
+        std::vector<uint8_t> out = { 0x78, 0x01 };
+        out.reserve(data.size() + data.size() / MAX_BLOCK * 5 + 16);
+
+        size_t offset = 0;
+        do {
+            size_t size = std::min(MAX_BLOCK, data.size() - offset);
+            bool last = offset + size == data.size();
+            out.push_back(last ? 1 : 0);
+            out.push_back(uint8_t(size));
+            out.push_back(uint8_t(size >> 8));
+            out.push_back(uint8_t(~size));
+            out.push_back(uint8_t(~size >> 8));
+            out.insert(out.end(), data.begin() + offset, data.begin() + offset + size);
+            offset += size;
+        } while (offset < data.size());
+
+        uint32_t a = 1, b = 0;
+        for (uint8_t byte : data) {
+            a = (a + byte) % 65521;
+            b = (b + a) % 65521;
+        }
+        appendBigEndian(out, (b << 16) | a);
+        return out;
+    }
+
+    /// <summary>
+    /// Next whitespace separated PPM header token, skipping comments
+    /// </summary>
+    bool readPpmToken(std::istream& in, std::string& token)
+    {
+        token.clear();
+        int c;
+        while ((c = in.get()) != EOF) {
+            if (c == '#') {
+                while ((c = in.get()) != EOF && c != '\n') {}
+            }
+            else if (!isspace(c)) {
+                break;
+            }
+        }
+        while (c != EOF && !isspace(c)) {
+            token.push_back(static_cast<char>(c));
+            c = in.get();
+        }
+        return !token.empty();
+    }
+}
+
+void FrameReadback::create(vk::Device device, MemoryAllocator& allocator, vk::Format format, vk::Extent2D extent, uint32_t slotCount)
+{
+    if (!isBgra(format) && !isRgba(format)) {
+        throw std::runtime_error("frame readback needs an 8 bit RGBA or BGRA image!");
+    }
+
+    this->device = device;
+    this->allocator = &allocator;
+    bgra = isBgra(format);
+    createSlots(extent, slotCount);
+
+    stopWriter = false;
+    writer = std::thread(&FrameReadback::writerLoop, this);
+}
+
+void FrameReadback::destroy()
+{
+    if (writer.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(writeMutex);
+            stopWriter = true;
+        }
+        writeReady.notify_all();
+        writer.join();
+    }
+
+    if (allocator) {
+        for (auto& slot : slots) {
+            allocator->destroyBuffer(slot.buffer);
+        }
+        allocator = nullptr;
+    }
+    slots.clear();
+}
+
+void FrameReadback::createSlots(vk::Extent2D extent, uint32_t slotCount)
+{
+    slots.resize(slotCount);
+    for (auto& slot : slots) {
+        // coherent so mapped reads need no invalidate, cached because the CPU reads every byte
+        slot.buffer = allocator->createBuffer(vk::DeviceSize(extent.width) * extent.height * 4, vk::BufferUsageFlagBits::eTransferDst,
+            vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent, vk::MemoryPropertyFlagBits::eHostCached);
+        slot.extent = extent;
+        slot.pending = false;
+    }
+}
+
+void FrameReadback::resize(vk::Extent2D extent, DeletionQueue& deletionQueue, uint64_t lastUse)
+{
+    for (auto& slot : slots) {
+        deletionQueue.push(lastUse, slot.buffer);
+    }
+    createSlots(extent, static_cast<uint32_t>(slots.size()));
+}
+
+void FrameReadback::recordCopy(vk::CommandBuffer commandBuffer, vk::Image image, uint64_t frameNumber)
+{
+    Slot& slot = slots[frameNumber % slots.size()];
+    if (slot.pending) {
+        throw std::runtime_error("frame readback slot reused before it was collected!");
+    }
+
+    auto region = vk::BufferImageCopy();
+    region.bufferOffset = 0;
+    region.bufferRowLength = 0;
+    region.bufferImageHeight = 0;
+    region.imageSubresource = vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, 0, 0, 1);
+    region.imageOffset = vk::Offset3D(0, 0, 0);
+    region.imageExtent = vk::Extent3D(slot.extent.width, slot.extent.height, 1);
+    commandBuffer.copyImageToBuffer(image, vk::ImageLayout::eTransferSrcOptimal, slot.buffer.buffer, region);
+
+    auto barrier = vk::BufferMemoryBarrier();
+    barrier.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+    barrier.dstAccessMask = vk::AccessFlagBits::eHostRead;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.buffer = slot.buffer.buffer;
+    barrier.offset = 0;
+    barrier.size = VK_WHOLE_SIZE;
+    commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eHost, {}, nullptr, barrier, nullptr);
+
+    slot.frameNumber = frameNumber;
+    slot.pending = true;
+}
+
+void FrameReadback::collect(uint64_t completedFrame, const std::function<void(const Capture&)>& consumer)
+{
+    // the slots hold consecutive frames, oldest first means smallest frame number first
+    std::vector<Slot*> ready;
+    for (auto& slot : slots) {
+        if (slot.pending && slot.frameNumber <= completedFrame) ready.push_back(&slot);
+    }
+    std::sort(ready.begin(), ready.end(), [](const Slot* a, const Slot* b) { return a->frameNumber < b->frameNumber; });
+
+    for (Slot* slot : ready) {
+        Capture capture;
+        capture.frameNumber = slot->frameNumber;
+        capture.width = slot->extent.width;
+        capture.height = slot->extent.height;
+        capture.bgra = bgra;
+        capture.pixels = static_cast<const uint8_t*>(slot->buffer.allocation.mapped);
+        slot->pending = false;
+        collectedCount++;
+        if (consumer) consumer(capture);
+    }
+}
+
+bool FrameReadback::queueWrite(const Capture& capture, const std::string& path)
+{
+    std::unique_lock<std::mutex> lock(writeMutex);
+    if (writes.size() >= MAX_QUEUED_WRITES) {
+        droppedCount++;
+        return false;
+    }
+    lock.unlock();
+
+    Write write;
+    write.path = path;
+    write.capture = capture;
+    write.pixels.assign(capture.pixels, capture.pixels + size_t(capture.width) * capture.height * 4);
+    write.capture.pixels = write.pixels.data();
+
+    lock.lock();
+    writes.push_back(std::move(write));
+    lock.unlock();
+    writeReady.notify_one();
+    return true;
+}
+
+void FrameReadback::flushWrites()
+{
+    std::unique_lock<std::mutex> lock(writeMutex);
+    writeDone.wait(lock, [this]() { return writes.empty() && !writing; });
+}
+
+void FrameReadback::writerLoop()
+{
+    std::unique_lock<std::mutex> lock(writeMutex);
+    while (true) {
+        writeReady.wait(lock, [this]() { return stopWriter || !writes.empty(); });
+        if (writes.empty()) break; // stopping, and everything queued is written
+
+        Write write = std::move(writes.front());
+        writes.pop_front();
+        writing = true;
+        lock.unlock();
+
+        try {
+            writeImage(write.path, write.capture);
+        }
+        catch (const std::exception& e) {
+            std::cerr << e.what() << std::endl;
+        }
+
+        lock.lock();
+        writing = false;
+        writeDone.notify_all();
+    }
+}
+
+void FrameReadback::writeImage(const std::string& path, const Capture& capture)
+{
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+        throw std::runtime_error("failed to open " + path + " for writing!");
+    }
+
+    if (endsWith(path, ".ppm")) {
+        std::vector<uint8_t> rgb = toRgb(capture, false);
+        file << "P6\n" << capture.width << " " << capture.height << "\n255\n";
+        file.write(reinterpret_cast<const char*>(rgb.data()), rgb.size());
+    }
+    else if (endsWith(path, ".png")) {
+        const uint8_t signature[] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+        file.write(reinterpret_cast<const char*>(signature), sizeof(signature));
+
+        std::vector<uint8_t> header;
+        appendBigEndian(header, capture.width);
+        appendBigEndian(header, capture.height);
+        header.insert(header.end(), { 8, 2, 0, 0, 0 }); // 8 bit RGB, deflate, adaptive filtering, no interlace
+        writeChunk(file, "IHDR", header);
+        writeChunk(file, "IDAT", zlibStore(toRgb(capture, true)));
+        writeChunk(file, "IEND", {});
+    }
+    else {
+        std::vector<uint8_t> rgba(capture.pixels, capture.pixels + size_t(capture.width) * capture.height * 4);
+        if (capture.bgra) {
+            for (size_t i = 0; i < rgba.size(); i += 4) {
+                std::swap(rgba[i], rgba[i + 2]);
+            }
+        }
+        file.write(reinterpret_cast<const char*>(rgba.data()), rgba.size());
+    }
+
+    if (!file) {
+        throw std::runtime_error("failed to write " + path + "!");
+    }
+}
+
+bool FrameReadback::readPpm(const std::string& path, uint32_t& width, uint32_t& height, std::vector<uint8_t>& rgb)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) return false;
+
+    std::string magic, widthToken, heightToken, maxToken;
+    if (!readPpmToken(file, magic) || magic != "P6" || !readPpmToken(file, widthToken) || !readPpmToken(file, heightToken) ||
+        !readPpmToken(file, maxToken) || maxToken != "255") {
+        return false;
+    }
+    // readPpmToken consumed the single whitespace byte that ends the header
+    width = static_cast<uint32_t>(std::strtoul(widthToken.c_str(), nullptr, 10));
+    height = static_cast<uint32_t>(std::strtoul(heightToken.c_str(), nullptr, 10));
+    rgb.resize(size_t(width) * height * 3);
+    file.read(reinterpret_cast<char*>(rgb.data()), rgb.size());
+    return static_cast<size_t>(file.gcount()) == rgb.size();
+}
+
+FrameReadback::ImageDiff FrameReadback::compare(const Capture& capture, const std::vector<uint8_t>& rgb, uint32_t tolerance)
+{
+    ImageDiff diff;
+    diff.pixelCount = uint64_t(capture.width) * capture.height;
+    if (rgb.size() != diff.pixelCount * 3) {
+        throw std::runtime_error("golden image size differs from the frame!");
+    }
+
+    for (uint64_t i = 0; i < diff.pixelCount; i++) {
+        const uint8_t* pixel = capture.pixels + i * 4;
+        uint8_t channels[3] = { pixel[capture.bgra ? 2 : 0], pixel[1], pixel[capture.bgra ? 0 : 2] };
+        uint32_t pixelDifference = 0;
+        for (int c = 0; c < 3; c++) {
+            pixelDifference = std::max(pixelDifference, static_cast<uint32_t>(std::abs(int(channels[c]) - int(rgb[i * 3 + c]))));
+        }
+        diff.maxDifference = std::max(diff.maxDifference, pixelDifference);
+        if (pixelDifference > tolerance) diff.pixelsOverTolerance++;
+    }
+    return diff;
+}
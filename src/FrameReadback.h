@@ -0,0 +1,126 @@
+#pragma once
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <vulkan/vulkan.hpp>
+
+#include "DeletionQueue.h"
+#include "MemoryAllocator.h"
+
+/// <summary>
+/// Copies rendered images into a ring of host visible buffers, one slot per frame in flight. A frame's pixels are
+/// handed out by collect() once the caller knows the frame has completed, so the copy never makes the CPU wait.
+/// Writing to disk happens on a writer thread, captures that arrive while it is behind are dropped instead of stalling the frame.
+/// </summary>
+class FrameReadback
+{
+public:
+	static constexpr uint32_t MAX_QUEUED_WRITES = 8;
+
+	/// <summary>
+	/// Pixels of one frame, rows tightly packed, 4 bytes per pixel in the order of the source format
+	/// </summary>
+	struct Capture {
+		uint64_t frameNumber = 0;
+		uint32_t width = 0;
+		uint32_t height = 0;
+		bool bgra = false;
+		const uint8_t* pixels = nullptr;
+	};
+
+	struct ImageDiff {
+		uint32_t maxDifference = 0; // largest difference of any channel
+		uint64_t pixelsOverTolerance = 0;
+		uint64_t pixelCount = 0;
+	};
+
+	FrameReadback() = default;
+	FrameReadback(const FrameReadback&) = delete;
+	FrameReadback& operator=(const FrameReadback&) = delete;
+	~FrameReadback() { destroy(); }
+
+	/// <summary>
+	/// format has to be an 8 bit per channel RGBA or BGRA format
+	/// </summary>
+	void create(vk::Device device, MemoryAllocator& allocator, vk::Format format, vk::Extent2D extent, uint32_t slotCount);
+	/// <summary>
+	/// Waits for the writer thread, the caller guarantees the device is idle
+	/// </summary>
+	void destroy();
+	/// <summary>
+	/// New buffers for a new image size, the old ones go to the deletion queue and frames not yet collected are lost
+	/// </summary>
+	void resize(vk::Extent2D extent, DeletionQueue& deletionQueue, uint64_t lastUse);
+
+	/// <summary>
+	/// Copies image, in eTransferSrcOptimal, into the slot of frameNumber and makes the copy visible to the host
+	/// </summary>
+	void recordCopy(vk::CommandBuffer commandBuffer, vk::Image image, uint64_t frameNumber);
+	/// <summary>
+	/// Hands every copied frame up to and including completedFrame to consumer, oldest first. The pixels are only valid during the call.
+	/// </summary>
+	void collect(uint64_t completedFrame, const std::function<void(const Capture&)>& consumer);
+
+	/// <summary>
+	/// Copies the capture and writes it on the writer thread, false when the queue is full and the capture was dropped
+	/// </summary>
+	bool queueWrite(const Capture& capture, const std::string& path);
+	/// <summary>
+	/// Blocks until every queued write is on disk
+	/// </summary>
+	void flushWrites();
+
+	uint64_t getCollectedCount() const { return collectedCount; }
+	uint64_t getDroppedCount() const { return droppedCount; }
+
+	/// <summary>
+	/// Picks the file format from the extension: .ppm (binary RGB), .png (RGB, uncompressed deflate) or anything else as raw RGBA
+	/// </summary>
+	static void writeImage(const std::string& path, const Capture& capture);
+	/// <summary>
+	/// Reads a binary PPM with a maximum value of 255, false when the file is missing or not in that format
+	/// </summary>
+	static bool readPpm(const std::string& path, uint32_t& width, uint32_t& height, std::vector<uint8_t>& rgb);
+	/// <summary>
+	/// Compares the RGB channels against an image of the same size, a pixel counts when any channel is more than tolerance off
+	/// </summary>
+	static ImageDiff compare(const Capture& capture, const std::vector<uint8_t>& rgb, uint32_t tolerance);
+
+private:
+	struct Slot {
+		Buffer buffer;
+		vk::Extent2D extent;
+		uint64_t frameNumber = 0;
+		bool pending = false;
+	};
+
+	struct Write {
+		std::string path;
+		Capture capture;
+		std::vector<uint8_t> pixels;
+	};
+
+	vk::Device device;
+	MemoryAllocator* allocator = nullptr;
+	bool bgra = false;
+	std::vector<Slot> slots;
+	uint64_t collectedCount = 0;
+	uint64_t droppedCount = 0;
+
+	std::thread writer;
+	std::mutex writeMutex;
+	std::condition_variable writeReady;
+	std::condition_variable writeDone;
+	std::deque<Write> writes;
+	bool writing = false;
+	bool stopWriter = false;
+
+	void createSlots(vk::Extent2D extent, uint32_t slotCount);
+	void writerLoop();
+};
@@ -0,0 +1,92 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <ostream>
+#include <vector>
+
+/// <summary>
+/// Collects per-frame timings and prints a throughput/percentile report.
+/// </summary>
+class FrameStats {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    void reserve(size_t count) {
+        samples.reserve(count);
+    }
+
+    void addSample(double milliseconds) {
+        samples.push_back(milliseconds);
+    }
+
+    void addSample(Clock::time_point begin, Clock::time_point end) {
+        addSample(toMilliseconds(end - begin));
+    }
+
+    size_t count() const {
+        return samples.size();
+    }
+
+    double total() const {
+        double sum = 0.0;
+        for (double sample : samples) sum += sample;
+        return sum;
+    }
+
+    double mean() const {
+        return samples.empty() ? 0.0 : total() / samples.size();
+    }
+
+    /// <summary>
+    /// Nearest-rank percentile, p in [0, 100]
+    /// </summary>
+    double percentile(double p) const {
+        if (samples.empty()) return 0.0;
+
+        std::vector<double> sorted = samples;
+        size_t rank = static_cast<size_t>(p / 100.0 * (sorted.size() - 1) + 0.5);
+        std::nth_element(sorted.begin(), sorted.begin() + rank, sorted.end());
+        return sorted[rank];
+    }
+
+    double min() const {
+        return samples.empty() ? 0.0 : *std::min_element(samples.begin(), samples.end());
+    }
+
+    double max() const {
+        return samples.empty() ? 0.0 : *std::max_element(samples.begin(), samples.end());
+    }
+
+    void print(std::ostream& out, const char* label, double wallMilliseconds) const {
+        auto flags = out.flags();
+        out << std::fixed << std::setprecision(3)
+            << label << ": " << count() << " frames in " << wallMilliseconds << " ms"
+            << " (" << (wallMilliseconds > 0.0 ? count() * 1000.0 / wallMilliseconds : 0.0) << " fps)"
+            << ", frame time mean " << mean()
+            << " p50 " << percentile(50.0)
+            << " p99 " << percentile(99.0)
+            << " max " << max() << " ms" << std::endl;
+        out.flags(flags);
+    }
+
+    /// <summary>
+    /// One line summary for samples that are not whole frames (waits, latencies)
+    /// </summary>
+    void printDistribution(std::ostream& out, const char* label) const {
+        auto flags = out.flags();
+        out << std::fixed << std::setprecision(3)
+            << label << ": mean " << mean()
+            << " p50 " << percentile(50.0)
+            << " p99 " << percentile(99.0)
+            << " max " << max() << " ms over " << count() << " samples" << std::endl;
+        out.flags(flags);
+    }
+
+    static double toMilliseconds(Clock::duration duration) {
+        return std::chrono::duration<double, std::milli>(duration).count();
+    }
+
+private:
+    std::vector<double> samples;
+};
@@ -0,0 +1,207 @@
+#include "GpuProfiler.h"
+
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <stdexcept>
+
+void GpuProfiler::create(vk::Device device, vk::PhysicalDevice physicalDevice, vk::Queue queue, uint32_t queueFamily, uint32_t frameCount,
+    bool timestamps, const vk::DispatchLoaderDynamic* labelDispatcher)
+{
+    this->device = device;
+    this->labelDispatcher = labelDispatcher;
+    frames.assign(frameCount, FrameQueries());
+    origin = Clock::now();
+
+    tracing = timestamps;
+    if (!timestamps) return;
+
+    uint32_t validBits = physicalDevice.getQueueFamilyProperties()[queueFamily].timestampValidBits;
+    if (validBits == 0) {
+        std::cout << "gpu profiler: queue family " << queueFamily << " does not support timestamps, GPU scopes disabled" << std::endl;
+        return;
+    }
+    timestampMask = validBits >= 64 ? ~0ull : (1ull << validBits) - 1;
+    nanosecondsPerTick = physicalDevice.getProperties().limits.timestampPeriod;
+
+    auto poolInfo = vk::QueryPoolCreateInfo();
+    poolInfo.queryType = vk::QueryType::eTimestamp;
+    poolInfo.queryCount = frameCount * MAX_SCOPES * 2;
+    queryPool = device.createQueryPool(poolInfo);
+
+    calibrate(queue, queueFamily);
+}
+
+void GpuProfiler::destroy()
+{
+    if (!device) return;
+
+    device.destroyQueryPool(queryPool);
+    queryPool = nullptr;
+    device = nullptr;
+}
+
+/// <summary>
+/// Writes one timestamp and pairs it with the midpoint of the CPU time around the submission.
+/// Clock drift over long captures is not corrected.
+/// </summary>
+void GpuProfiler::calibrate(vk::Queue queue, uint32_t queueFamily)
+{
+    auto poolInfo = vk::CommandPoolCreateInfo();
+    poolInfo.flags = vk::CommandPoolCreateFlagBits::eTransient;
+    poolInfo.queueFamilyIndex = queueFamily;
+    vk::CommandPool commandPool = device.createCommandPool(poolInfo);
+
+    auto allocInfo = vk::CommandBufferAllocateInfo();
+    allocInfo.commandPool = commandPool;
+    allocInfo.level = vk::CommandBufferLevel::ePrimary;
+    allocInfo.commandBufferCount = 1;
+    vk::CommandBuffer commandBuffer = device.allocateCommandBuffers(allocInfo)[0];
+
+    auto beginInfo = vk::CommandBufferBeginInfo();
+    beginInfo.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit;
+    commandBuffer.begin(beginInfo);
+    commandBuffer.resetQueryPool(queryPool, 0, 1);
+    commandBuffer.writeTimestamp(vk::PipelineStageFlagBits::eTopOfPipe, queryPool, 0);
+    commandBuffer.end();
+
+    vk::Fence fence = device.createFence(vk::FenceCreateInfo());
+    auto submitInfo = vk::SubmitInfo();
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &commandBuffer;
+
+    auto before = Clock::now();
+    queue.submit(submitInfo, fence);
+    auto ret = device.waitForFences(1, &fence, VK_TRUE, UINT64_MAX);
+    auto after = Clock::now();
+    if (ret != vk::Result::eSuccess) throw std::runtime_error("fence failed");
+
+    uint64_t ticks = 0;
+    ret = device.getQueryPoolResults(queryPool, 0, 1, sizeof(ticks), &ticks, sizeof(ticks), vk::QueryResultFlagBits::e64 | vk::QueryResultFlagBits::eWait);
+    if (ret != vk::Result::eSuccess) throw std::runtime_error("failed to read calibration timestamp!");
+
+    calibrationTicks = ticks & timestampMask;
+    calibrationTime = before + (after - before) / 2;
+
+    device.destroyFence(fence);
+    device.destroyCommandPool(commandPool);
+}
+
+void GpuProfiler::collect(uint32_t frameIndex)
+{
+    FrameQueries& frame = frames[frameIndex];
+    if (!queryPool || frame.names.empty()) return;
+
+    uint32_t queryCount = static_cast<uint32_t>(frame.names.size()) * 2;
+    uint64_t ticks[MAX_SCOPES * 2];
+    auto ret = device.getQueryPoolResults(queryPool, frameIndex * MAX_SCOPES * 2, queryCount, sizeof(ticks), ticks, sizeof(uint64_t),
+        vk::QueryResultFlagBits::e64);
+
+    // eNotReady only happens when the frame never reached the GPU, drop it rather than wait
+    if (ret == vk::Result::eSuccess && events.size() + frame.names.size() <= MAX_EVENTS) {
+        for (size_t scope = 0; scope < frame.names.size(); scope++) {
+            double begin = ticksToMicroseconds(ticks[scope * 2] & timestampMask);
+            double end = ticksToMicroseconds(ticks[scope * 2 + 1] & timestampMask);
+            events.push_back({ frame.names[scope], GpuTrack, begin, end - begin, frame.frameNumber });
+        }
+    }
+    frame.names.clear();
+}
+
+void GpuProfiler::beginFrame(vk::CommandBuffer commandBuffer, uint32_t frameIndex, uint64_t frameNumber)
+{
+    currentFrame = frameIndex;
+    frames[frameIndex].names.clear();
+    frames[frameIndex].frameNumber = frameNumber;
+
+    if (queryPool) {
+        commandBuffer.resetQueryPool(queryPool, frameIndex * MAX_SCOPES * 2, MAX_SCOPES * 2);
+    }
+}
+
+uint32_t GpuProfiler::beginScope(vk::CommandBuffer commandBuffer, const char* name)
+{
+    if (labelDispatcher) {
+        auto label = vk::DebugUtilsLabelEXT();
+        label.pLabelName = name;
+        commandBuffer.beginDebugUtilsLabelEXT(label, *labelDispatcher);
+    }
+
+    FrameQueries& frame = frames[currentFrame];
+    if (!queryPool || frame.names.size() == MAX_SCOPES) return UINT32_MAX;
+
+    uint32_t scope = static_cast<uint32_t>(frame.names.size());
+    frame.names.push_back(name);
+    commandBuffer.writeTimestamp(vk::PipelineStageFlagBits::eTopOfPipe, queryPool, (currentFrame * MAX_SCOPES + scope) * 2);
+    return scope;
+}
+
+void GpuProfiler::endScope(vk::CommandBuffer commandBuffer, uint32_t scope)
+{
+    if (scope != UINT32_MAX) {
+        commandBuffer.writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe, queryPool, (currentFrame * MAX_SCOPES + scope) * 2 + 1);
+    }
+
+    if (labelDispatcher) {
+        commandBuffer.endDebugUtilsLabelEXT(*labelDispatcher);
+    }
+}
+
+void GpuProfiler::addCpuSpan(const char* name, Clock::time_point begin, Clock::time_point end)
+{
+    if (!tracing || events.size() >= MAX_EVENTS) return;
+
+    double beginMicroseconds = toMicroseconds(begin);
+    events.push_back({ name, CpuTrack, beginMicroseconds, toMicroseconds(end) - beginMicroseconds, frames[currentFrame].frameNumber });
+}
+
+double GpuProfiler::toMicroseconds(Clock::time_point time) const
+{
+    return std::chrono::duration<double, std::micro>(time - origin).count();
+}
+
+double GpuProfiler::ticksToMicroseconds(uint64_t ticks) const
+{
+    double sinceCalibration = ((ticks - calibrationTicks) & timestampMask) * nanosecondsPerTick / 1000.0;
+    return toMicroseconds(calibrationTime) + sinceCalibration;
+}
+
+bool GpuProfiler::writeTrace(const std::string& path) const
+{
+    std::ofstream file(path, std::ios::trunc);
+    if (!file.is_open()) {
+        std::cout << "gpu profiler: could not write " << path << std::endl;
+        return false;
+    }
+
+    file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << CpuTrack << ",\"args\":{\"name\":\"CPU\"}},\n";
+    file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << GpuTrack << ",\"args\":{\"name\":\"GPU\"}}";
+    file << std::fixed;
+    for (const Event& event : events) {
+        file << ",\n{\"name\":\"" << event.name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << event.track
+            << ",\"ts\":" << event.beginMicroseconds << ",\"dur\":" << event.durationMicroseconds
+            << ",\"args\":{\"frame\":" << event.frameNumber << "}}";
+    }
+    file << "\n]}\n";
+
+    std::cout << "gpu profiler: wrote " << events.size() << " events to " << path << std::endl;
+    return file.good();
+}
+
+void GpuProfiler::printSummary(std::ostream& out) const
+{
+    struct Total { double microseconds = 0.0; uint64_t count = 0; };
+    std::map<std::string, Total> totals;
+    for (const Event& event : events) {
+        if (event.track != GpuTrack) continue;
+        Total& total = totals[event.name];
+        total.microseconds += event.durationMicroseconds;
+        total.count++;
+    }
+
+    for (const auto& total : totals) {
+        out << "gpu " << total.first << ": " << total.second.microseconds / total.second.count / 1000.0 << " ms mean over "
+            << total.second.count << " frames" << std::endl;
+    }
+}
@@ -0,0 +1,119 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include <vulkan/vulkan.hpp>
+
+/// <summary>
+/// Scoped GPU timestamps per frame in flight plus CPU spans, exported as a Chrome trace / Perfetto JSON file.
+/// A frame's queries are read back when its fence has already been waited on for reuse, so collecting never stalls.
+/// When a label dispatcher is given the same scopes are also emitted as VK_EXT_debug_utils labels.
+/// </summary>
+class GpuProfiler
+{
+public:
+	using Clock = std::chrono::steady_clock;
+
+	/// <summary>
+	/// timestamps = false keeps only the debug labels. GPU ticks are mapped onto Clock with one calibration submission on queue.
+	/// </summary>
+	void create(vk::Device device, vk::PhysicalDevice physicalDevice, vk::Queue queue, uint32_t queueFamily, uint32_t frameCount,
+		bool timestamps, const vk::DispatchLoaderDynamic* labelDispatcher);
+	void destroy();
+
+	/// <summary>
+	/// Reads back the scopes recorded the last time frameIndex was used, the caller has waited on that frame's fence
+	/// </summary>
+	void collect(uint32_t frameIndex);
+	/// <summary>
+	/// Resets the queries of frameIndex, recorded at the start of its command buffer and outside of any render pass
+	/// </summary>
+	void beginFrame(vk::CommandBuffer commandBuffer, uint32_t frameIndex, uint64_t frameNumber);
+
+	uint32_t beginScope(vk::CommandBuffer commandBuffer, const char* name);
+	void endScope(vk::CommandBuffer commandBuffer, uint32_t scope);
+
+	void addCpuSpan(const char* name, Clock::time_point begin, Clock::time_point end);
+
+	/// <summary>
+	/// GPU scope covering everything recorded into commandBuffer during its lifetime, name must outlive the profiler
+	/// </summary>
+	class Scope {
+	public:
+		Scope(GpuProfiler& profiler, vk::CommandBuffer commandBuffer, const char* name)
+			: profiler(profiler), commandBuffer(commandBuffer), scope(profiler.beginScope(commandBuffer, name)) {}
+		~Scope() { profiler.endScope(commandBuffer, scope); }
+		Scope(const Scope&) = delete;
+		Scope& operator=(const Scope&) = delete;
+
+	private:
+		GpuProfiler& profiler;
+		vk::CommandBuffer commandBuffer;
+		uint32_t scope;
+	};
+
+	/// <summary>
+	/// CPU span covering its own lifetime
+	/// </summary>
+	class CpuScope {
+	public:
+		CpuScope(GpuProfiler& profiler, const char* name) : profiler(profiler), name(name), begin(Clock::now()) {}
+		~CpuScope() { profiler.addCpuSpan(name, begin, Clock::now()); }
+		CpuScope(const CpuScope&) = delete;
+		CpuScope& operator=(const CpuScope&) = delete;
+
+	private:
+		GpuProfiler& profiler;
+		const char* name;
+		Clock::time_point begin;
+	};
+
+	bool isTracing() const { return tracing; }
+	bool writeTrace(const std::string& path) const;
+	/// <summary>
+	/// Mean GPU time per scope name
+	/// </summary>
+	void printSummary(std::ostream& out) const;
+
+private:
+	static constexpr uint32_t MAX_SCOPES = 32;
+	static constexpr size_t MAX_EVENTS = 1 << 20; // stop recording instead of growing without bound
+
+	enum Track : uint32_t { CpuTrack = 1, GpuTrack = 2 };
+
+	struct Event {
+		const char* name;
+		Track track;
+		double beginMicroseconds;
+		double durationMicroseconds;
+		uint64_t frameNumber;
+	};
+
+	struct FrameQueries {
+		std::vector<const char*> names;
+		uint64_t frameNumber = 0;
+	};
+
+	vk::Device device;
+	const vk::DispatchLoaderDynamic* labelDispatcher = nullptr;
+	bool tracing = false;
+	vk::QueryPool queryPool;
+	std::vector<FrameQueries> frames;
+	uint32_t currentFrame = 0;
+	double nanosecondsPerTick = 1.0;
+	uint64_t timestampMask = ~0ull;
+
+	// a GPU tick value and the CPU time it was taken at, everything else is derived from these
+	uint64_t calibrationTicks = 0;
+	Clock::time_point calibrationTime;
+	Clock::time_point origin;
+
+	std::vector<Event> events;
+
+	void calibrate(vk::Queue queue, uint32_t queueFamily);
+	double toMicroseconds(Clock::time_point time) const;
+	double ticksToMicroseconds(uint64_t ticks) const;
+};
@@ -0,0 +1,262 @@
+#include "Instrumentation.h"
+
+#include <condition_variable>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+    const auto DRAIN_INTERVAL = std::chrono::milliseconds(5);
+
+    template<typename T>
+    void put(std::vector<char>& buffer, const T& value)
+    {
+        const char* bytes = reinterpret_cast<const char*>(&value);
+        buffer.insert(buffer.end(), bytes, bytes + sizeof(T));
+    }
+
+    void putString(std::vector<char>& buffer, const char* text)
+    {
+        uint16_t length = static_cast<uint16_t>(std::min<size_t>(strlen(text), UINT16_MAX));
+        put(buffer, length);
+        buffer.insert(buffer.end(), text, text + length);
+    }
+}
+
+/// <summary>
+/// Everything besides the rings themselves belongs to the drain thread while a trace runs,
+/// the registry is the only part other threads touch and it has its own lock
+/// </summary>
+struct Instrumentation::State {
+    std::mutex registryMutex;
+    std::vector<std::unique_ptr<ThreadRing>> rings;
+    uint32_t nextThreadId = 1;
+    uint64_t reusedDropped = 0; // drops of threads whose ring went to another thread
+
+    std::mutex drainMutex;
+    std::condition_variable drainWake;
+    bool stopDrain = false;
+    std::thread drainThread;
+
+    std::string path;
+    std::ofstream file;
+    std::vector<char> buffer;
+    std::unordered_map<const char*, uint32_t> nameIds;
+    std::vector<uint32_t> announcedThreads; // per ring, the thread id and name version last written
+    std::vector<uint32_t> announcedNames;
+    uint64_t eventCount = 0;
+};
+
+std::atomic<bool> Instrumentation::running{ false };
+
+Instrumentation::State& Instrumentation::state()
+{
+    static State state;
+    return state;
+}
+
+bool Instrumentation::start(const std::string& path)
+{
+    State& s = state();
+    if (s.drainThread.joinable()) return false;
+
+    s.file.open(path, std::ios::binary | std::ios::trunc);
+    if (!s.file.is_open()) {
+        std::cout << "instrumentation: could not write " << path << std::endl;
+        return false;
+    }
+    s.path = path;
+    s.buffer.clear();
+    s.nameIds.clear();
+    s.announcedThreads.clear();
+    s.announcedNames.clear();
+    s.eventCount = 0;
+
+    FileHeader header = {};
+    header.magic = MAGIC;
+    header.version = VERSION;
+    header.clockNumerator = std::chrono::steady_clock::period::num;
+    header.clockDenominator = std::chrono::steady_clock::period::den;
+    s.file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    s.stopDrain = false;
+    running.store(true, std::memory_order_relaxed);
+    s.drainThread = std::thread(drainLoop);
+    return true;
+}
+
+void Instrumentation::stop()
+{
+    State& s = state();
+    if (!s.drainThread.joinable()) return;
+
+    running.store(false, std::memory_order_relaxed);
+    {
+        std::lock_guard<std::mutex> lock(s.drainMutex);
+        s.stopDrain = true;
+    }
+    s.drainWake.notify_all();
+    s.drainThread.join();
+
+    uint64_t dropped = s.reusedDropped;
+    {
+        std::lock_guard<std::mutex> lock(s.registryMutex);
+        if (s.reusedDropped) {
+            // their threads are gone, thread 0 stands for all of them
+            put(s.buffer, RecordKind::Dropped);
+            put(s.buffer, uint32_t(0));
+            put(s.buffer, s.reusedDropped);
+        }
+        for (const auto& ring : s.rings) {
+            uint64_t ringDropped = ring->dropped.exchange(0, std::memory_order_relaxed);
+            if (ringDropped == 0) continue;
+            put(s.buffer, RecordKind::Dropped);
+            put(s.buffer, ring->threadId.load(std::memory_order_relaxed));
+            put(s.buffer, ringDropped);
+            dropped += ringDropped;
+        }
+        s.reusedDropped = 0;
+    }
+    s.file.write(s.buffer.data(), s.buffer.size());
+    s.buffer.clear();
+    s.file.close();
+
+    std::cout << "instrumentation: wrote " << s.eventCount << " events to " << s.path << ", " << dropped << " dropped" << std::endl;
+}
+
+void Instrumentation::setThreadName(const std::string& name)
+{
+    ThreadRing& ring = threadRing();
+    // the drain thread copies the name under the same lock
+    std::lock_guard<std::mutex> lock(state().registryMutex);
+    size_t length = std::min(name.size(), sizeof(ring.name) - 1);
+    memcpy(ring.name, name.data(), length);
+    ring.name[length] = '\0';
+    ring.nameVersion.fetch_add(1, std::memory_order_release);
+}
+
+Instrumentation::ThreadRing& Instrumentation::threadRing()
+{
+    // hands the ring back when the thread exits
+    struct Owner {
+        ThreadRing* ring = nullptr;
+        ~Owner() {
+            if (ring) ring->retired.store(true, std::memory_order_release);
+        }
+    };
+    thread_local Owner owner;
+    if (!owner.ring) owner.ring = acquireRing();
+    return *owner.ring;
+}
+
+/// <summary>
+/// A drained ring of an exited thread if there is one, otherwise a new ring. Only the first event of a thread gets here.
+/// </summary>
+Instrumentation::ThreadRing* Instrumentation::acquireRing()
+{
+    State& s = state();
+    std::lock_guard<std::mutex> lock(s.registryMutex);
+
+    ThreadRing* ring = nullptr;
+    for (const auto& candidate : s.rings) {
+        bool drained = candidate->head.load(std::memory_order_acquire) == candidate->tail.load(std::memory_order_acquire);
+        if (candidate->retired.load(std::memory_order_acquire) && drained) {
+            ring = candidate.get();
+            s.reusedDropped += ring->dropped.exchange(0, std::memory_order_relaxed);
+            break;
+        }
+    }
+    if (!ring) {
+        s.rings.push_back(std::make_unique<ThreadRing>());
+        ring = s.rings.back().get();
+    }
+
+    ring->retired.store(false, std::memory_order_relaxed);
+    ring->name[0] = '\0';
+    ring->threadId.store(s.nextThreadId++, std::memory_order_relaxed);
+    ring->nameVersion.fetch_add(1, std::memory_order_release);
+    return ring;
+}
+
+void Instrumentation::drainLoop()
+{
+    State& s = state();
+    std::unique_lock<std::mutex> lock(s.drainMutex);
+    for (;;) {
+        // drains once more after stop() so nothing recorded before it is lost
+        bool stopping = s.drainWake.wait_for(lock, DRAIN_INTERVAL, [&s]() { return s.stopDrain; });
+        lock.unlock();
+        drain();
+        if (stopping) return;
+        lock.lock();
+    }
+}
+
+/// <summary>
+/// Copies every ring's new events into records and hands the slots back, names and threads are written the first time they show up
+/// </summary>
+void Instrumentation::drain()
+{
+    State& s = state();
+    std::vector<ThreadRing*> rings;
+    {
+        std::lock_guard<std::mutex> lock(s.registryMutex);
+        for (const auto& ring : s.rings) {
+            rings.push_back(ring.get());
+        }
+    }
+    s.announcedThreads.resize(rings.size(), 0);
+    s.announcedNames.resize(rings.size(), 0);
+
+    for (size_t i = 0; i < rings.size(); i++) {
+        ThreadRing& ring = *rings[i];
+        // head first, its acquire makes the owner's thread id visible
+        uint64_t head = ring.head.load(std::memory_order_acquire);
+        uint64_t tail = ring.tail.load(std::memory_order_relaxed);
+        uint32_t threadId = ring.threadId.load(std::memory_order_relaxed);
+        uint32_t nameVersion = ring.nameVersion.load(std::memory_order_acquire);
+
+        if (s.announcedThreads[i] != threadId || s.announcedNames[i] != nameVersion) {
+            char name[sizeof(ring.name)];
+            {
+                std::lock_guard<std::mutex> lock(s.registryMutex);
+                memcpy(name, ring.name, sizeof(name));
+                nameVersion = ring.nameVersion.load(std::memory_order_relaxed); // the version this copy belongs to
+            }
+            put(s.buffer, RecordKind::Thread);
+            put(s.buffer, threadId);
+            putString(s.buffer, name);
+            s.announcedThreads[i] = threadId;
+            s.announcedNames[i] = nameVersion;
+        }
+
+        for (; tail != head; tail++) {
+            const Event& event = ring.events[tail & (RING_CAPACITY - 1)];
+            auto name = s.nameIds.find(event.name);
+            if (name == s.nameIds.end()) {
+                name = s.nameIds.emplace(event.name, static_cast<uint32_t>(s.nameIds.size())).first;
+                put(s.buffer, RecordKind::Name);
+                put(s.buffer, name->second);
+                putString(s.buffer, event.name);
+            }
+
+            put(s.buffer, event.kind == EventKind::Zone ? RecordKind::Zone : RecordKind::Counter);
+            put(s.buffer, threadId);
+            put(s.buffer, name->second);
+            put(s.buffer, event.time);
+            put(s.buffer, event.endOrValue);
+            s.eventCount++;
+        }
+        ring.tail.store(tail, std::memory_order_release);
+    }
+
+    if (!s.buffer.empty()) {
+        s.file.write(s.buffer.data(), s.buffer.size());
+        s.buffer.clear();
+    }
+}
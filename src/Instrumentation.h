@@ -0,0 +1,141 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+/// <summary>
+/// CPU zones and counters for the hot path. Every thread records into its own single producer ring, a background thread
+/// drains the rings into a binary trace that TraceConverter turns into Chrome trace JSON. Recording never locks or
+/// allocates, a full ring drops the event and counts it. The INSTRUMENT_* macros compile to nothing unless
+/// ENABLE_INSTRUMENTATION is defined (cmake -DVULKANUS_INSTRUMENTATION=ON).
+/// Names have to be string literals or otherwise outlive the trace, only the pointer is recorded.
+/// </summary>
+class Instrumentation
+{
+public:
+	static constexpr uint32_t RING_CAPACITY = 4096; // events per thread, a power of two
+
+	// binary trace: FileHeader, then records each starting with a RecordKind byte, all little endian
+	static constexpr uint32_t MAGIC = 0x52544B56; // "VKTR"
+	static constexpr uint32_t VERSION = 1;
+
+	struct FileHeader {
+		uint32_t magic;
+		uint32_t version;
+		uint64_t clockNumerator; // seconds per timestamp tick as a fraction
+		uint64_t clockDenominator;
+	};
+
+	enum class RecordKind : uint8_t {
+		Name = 1, // uint32 id, uint16 length, characters
+		Thread = 2, // uint32 thread, uint16 length, characters
+		Zone = 3, // uint32 thread, uint32 name, uint64 begin, uint64 end
+		Counter = 4, // uint32 thread, uint32 name, uint64 time, int64 value
+		Dropped = 5, // uint32 thread, uint64 events dropped in total
+	};
+
+	static uint64_t now() {
+		return static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+	}
+
+	/// <summary>
+	/// Starts recording and draining into path, false when the file can't be opened or a trace is already running
+	/// </summary>
+	static bool start(const std::string& path);
+	/// <summary>
+	/// Drains what is left, closes the file and prints a summary, does nothing when not started
+	/// </summary>
+	static void stop();
+	static bool isRunning() { return running.load(std::memory_order_relaxed); }
+
+	/// <summary>
+	/// Name of the calling thread in the trace, set it once when the thread starts. Takes a lock, keep it off the hot path.
+	/// </summary>
+	static void setThreadName(const std::string& name);
+
+	static void zone(const char* name, uint64_t begin, uint64_t end) {
+		if (isRunning()) threadRing().push({ begin, end, name, EventKind::Zone });
+	}
+	static void counter(const char* name, int64_t value) {
+		if (isRunning()) threadRing().push({ now(), static_cast<uint64_t>(value), name, EventKind::Counter });
+	}
+
+	/// <summary>
+	/// Records its lifetime as one zone, reads no clock while no trace is running
+	/// </summary>
+	class Zone {
+	public:
+		explicit Zone(const char* name) : name(name), begin(isRunning() ? now() : 0) {}
+		~Zone() {
+			if (begin) zone(name, begin, now());
+		}
+		Zone(const Zone&) = delete;
+		Zone& operator=(const Zone&) = delete;
+
+	private:
+		const char* name;
+		uint64_t begin;
+	};
+
+private:
+	enum class EventKind : uint32_t {
+		Zone,
+		Counter,
+	};
+
+	struct Event {
+		uint64_t time;
+		uint64_t endOrValue;
+		const char* name;
+		EventKind kind;
+	};
+
+	/// <summary>
+	/// Single producer (the owning thread), single consumer (the drain thread). head and tail only grow,
+	/// each on its own cache line. A ring whose thread exited is handed to the next new thread once drained.
+	/// </summary>
+	struct ThreadRing {
+		std::array<Event, RING_CAPACITY> events;
+		alignas(64) std::atomic<uint64_t> head{ 0 };
+		alignas(64) std::atomic<uint64_t> tail{ 0 };
+		std::atomic<uint64_t> dropped{ 0 };
+		std::atomic<bool> retired{ false }; // the owning thread exited
+		std::atomic<uint32_t> threadId{ 0 }; // new id per owning thread
+		std::atomic<uint32_t> nameVersion{ 0 };
+		char name[64] = {}; // written and read under the registry lock only
+
+		void push(const Event& event) {
+			uint64_t position = head.load(std::memory_order_relaxed);
+			if (position - tail.load(std::memory_order_acquire) >= RING_CAPACITY) {
+				dropped.fetch_add(1, std::memory_order_relaxed);
+				return;
+			}
+			events[position & (RING_CAPACITY - 1)] = event;
+			head.store(position + 1, std::memory_order_release);
+		}
+	};
+
+	struct State;
+
+	static std::atomic<bool> running;
+
+	static State& state();
+	static ThreadRing& threadRing();
+	static ThreadRing* acquireRing();
+	static void drainLoop();
+	static void drain();
+};
+
+#ifdef ENABLE_INSTRUMENTATION
+#define INSTRUMENT_CONCAT_(a, b) a##b
+#define INSTRUMENT_CONCAT(a, b) INSTRUMENT_CONCAT_(a, b)
+#define INSTRUMENT_ZONE(name) Instrumentation::Zone INSTRUMENT_CONCAT(instrumentZone, __LINE__)(name)
+#define INSTRUMENT_COUNTER(name, value) Instrumentation::counter(name, static_cast<int64_t>(value))
+#define INSTRUMENT_THREAD(name) Instrumentation::setThreadName(name)
+#else
+#define INSTRUMENT_ZONE(name) ((void)0)
+#define INSTRUMENT_COUNTER(name, value) ((void)0)
+#define INSTRUMENT_THREAD(name) ((void)0)
+#endif
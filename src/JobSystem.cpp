@@ -0,0 +1,130 @@
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <string>
+
+#include "Instrumentation.h"
+
+void JobSystem::create(uint32_t workerCount)
+{
+    destroy();
+
+    for (uint32_t i = 0; i < workerCount + 1; i++) {
+        queues.push_back(std::make_unique<Queue>());
+    }
+
+    running = true;
+    for (uint32_t i = 0; i < workerCount; i++) {
+        workers.emplace_back(&JobSystem::workerLoop, this, i);
+    }
+}
+
+void JobSystem::destroy()
+{
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        running = false;
+    }
+    wake.notify_all();
+
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    workers.clear();
+    queues.clear();
+}
+
+void JobSystem::workerLoop(uint32_t threadIndex)
+{
+    INSTRUMENT_THREAD("job worker " + std::to_string(threadIndex));
+    while (running) {
+        if (runOne(threadIndex)) continue;
+
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        wake.wait(lock, [this]() { return queuedJobs > 0 || !running; });
+    }
+}
+
+/// <summary>
+/// Runs the newest job of this thread's own deque, otherwise steals the oldest job of another thread
+/// </summary>
+bool JobSystem::runOne(uint32_t threadIndex)
+{
+    Job job = {};
+    bool found = false;
+
+    {
+        Queue& own = *queues[threadIndex];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.jobs.empty()) {
+            job = own.jobs.back();
+            own.jobs.pop_back();
+            found = true;
+        }
+    }
+
+    for (uint32_t i = 1; !found && i < queues.size(); i++) {
+        Queue& victim = *queues[(threadIndex + i) % queues.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.jobs.empty()) {
+            job = victim.jobs.front();
+            victim.jobs.pop_front();
+            found = true;
+        }
+    }
+
+    if (!found) return false;
+
+    queuedJobs--;
+    INSTRUMENT_ZONE("job");
+    if (!job.group->failed.load(std::memory_order_relaxed)) {
+        try {
+            (*job.job)(job.begin, job.end, threadIndex);
+        }
+        catch (...) {
+            // the release below publishes the error to the thread waiting in parallelFor()
+            if (!job.group->failed.exchange(true, std::memory_order_relaxed)) {
+                job.group->error = std::current_exception();
+            }
+        }
+    }
+    job.group->remaining.fetch_sub(1, std::memory_order_release);
+    return true;
+}
+
+void JobSystem::parallelFor(uint32_t count, uint32_t grain, const RangeJob& job)
+{
+    if (count == 0) return;
+
+    uint32_t callerIndex = getThreadCount() - 1;
+    grain = std::max(grain, 1u);
+    if (workers.empty() || count <= grain) {
+        job(0, count, callerIndex);
+        return;
+    }
+
+    uint32_t chunkCount = (count + grain - 1) / grain;
+    Group group;
+    group.remaining.store(chunkCount, std::memory_order_relaxed);
+
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        queuedJobs += chunkCount;
+    }
+    // deal chunks out round-robin, stealing evens out whatever imbalance is left
+    for (uint32_t chunk = 0; chunk < chunkCount; chunk++) {
+        Queue& queue = *queues[chunk % queues.size()];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.jobs.push_back({ chunk * grain, std::min(count, (chunk + 1) * grain), &job, &group });
+    }
+    wake.notify_all();
+
+    while (group.remaining.load(std::memory_order_acquire) > 0) {
+        if (!runOne(callerIndex)) {
+            std::this_thread::yield();
+        }
+    }
+    if (group.error) {
+        std::rethrow_exception(group.error);
+    }
+}
@@ -0,0 +1,72 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/// <summary>
+/// Fixed pool of worker threads with one job deque per thread. Owners take jobs from the back of their
+/// own deque, idle threads steal from the front of the others. The thread calling parallelFor() takes
+/// part in the work as thread index getThreadCount() - 1.
+/// </summary>
+class JobSystem
+{
+public:
+	using RangeJob = std::function<void(uint32_t begin, uint32_t end, uint32_t threadIndex)>;
+
+	JobSystem() = default;
+	JobSystem(const JobSystem&) = delete;
+	JobSystem& operator=(const JobSystem&) = delete;
+	~JobSystem() { destroy(); }
+
+	void create(uint32_t workerCount);
+	void destroy();
+	/// <summary>
+	/// Worker threads plus the calling thread
+	/// </summary>
+	uint32_t getThreadCount() const { return static_cast<uint32_t>(queues.size()); }
+
+	/// <summary>
+	/// Splits [0, count) into chunks of at most grain elements, runs them on all threads and returns once every chunk is done.
+	/// The first exception a chunk throws is rethrown here after that, chunks that had not started by then are skipped.
+	/// </summary>
+	void parallelFor(uint32_t count, uint32_t grain, const RangeJob& job);
+
+private:
+	/// <summary>
+	/// The chunks of one parallelFor() call, error is written once by whoever sets failed first
+	/// </summary>
+	struct Group {
+		std::atomic<uint32_t> remaining{ 0 };
+		std::atomic<bool> failed{ false };
+		std::exception_ptr error;
+	};
+
+	struct Job {
+		uint32_t begin;
+		uint32_t end;
+		const RangeJob* job;
+		Group* group;
+	};
+
+	struct Queue {
+		std::mutex mutex;
+		std::deque<Job> jobs;
+	};
+
+	std::vector<std::thread> workers;
+	std::vector<std::unique_ptr<Queue>> queues;
+	std::atomic<bool> running{ false };
+	std::atomic<uint32_t> queuedJobs{ 0 };
+	std::mutex sleepMutex;
+	std::condition_variable wake;
+
+	void workerLoop(uint32_t threadIndex);
+	bool runOne(uint32_t threadIndex);
+};
@@ -0,0 +1,663 @@
+#include "MemoryAllocator.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <stdexcept>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+struct MemoryBlock {
+    vk::DeviceMemory memory;
+    vk::DeviceSize size = 0;
+    void* mapped = nullptr;
+    uint32_t memoryType = 0;
+    ResourceKind kind = ResourceKind::Linear;
+    bool dedicated = false;
+    uint32_t allocationCount = 0;
+    std::unique_ptr<TlsfAllocator> tlsf;
+    std::unique_ptr<LinearAllocator> linear;
+
+    vk::DeviceSize getFreeBytes() const {
+        if (tlsf) return tlsf->getFreeBytes();
+        if (linear) return linear->getFreeBytes();
+        return allocationCount ? 0 : size;
+    }
+};
+
+namespace {
+    uint32_t highestBit(uint64_t value)
+    {
+#if defined(_MSC_VER)
+        unsigned long index;
+        _BitScanReverse64(&index, value);
+        return index;
+#else
+        return 63 - __builtin_clzll(value);
+#endif
+    }
+
+    uint32_t lowestBit(uint64_t value)
+    {
+#if defined(_MSC_VER)
+        unsigned long index;
+        _BitScanForward64(&index, value);
+        return index;
+#else
+        return __builtin_ctzll(value);
+#endif
+    }
+
+    vk::DeviceSize alignUp(vk::DeviceSize value, vk::DeviceSize alignment)
+    {
+        return (value + alignment - 1) & ~(alignment - 1);
+    }
+}
+
+/*TLSF*/
+
+TlsfAllocator::TlsfAllocator(vk::DeviceSize size) : size(size), freeBytes(size)
+{
+    for (auto& list : freeLists) {
+        std::fill(std::begin(list), std::end(list), INVALID);
+    }
+
+    uint32_t node = newNode();
+    nodes[node] = { 0, size, INVALID, INVALID, INVALID, INVALID, false };
+    insertFree(node);
+}
+
+/// <summary>
+/// First level is the highest set bit of size, second level splits that power of two range linearly into SL_COUNT classes
+/// </summary>
+void TlsfAllocator::mapping(vk::DeviceSize size, uint32_t& fl, uint32_t& sl)
+{
+    fl = highestBit(size);
+    if (fl < SL_LOG2) {
+        sl = static_cast<uint32_t>(size << (SL_LOG2 - fl)) & (SL_COUNT - 1);
+    }
+    else {
+        sl = static_cast<uint32_t>(size >> (fl - SL_LOG2)) & (SL_COUNT - 1);
+    }
+}
+
+uint32_t TlsfAllocator::newNode()
+{
+    if (!spareNodes.empty()) {
+        uint32_t node = spareNodes.back();
+        spareNodes.pop_back();
+        return node;
+    }
+    nodes.push_back({});
+    return static_cast<uint32_t>(nodes.size() - 1);
+}
+
+void TlsfAllocator::releaseNode(uint32_t node)
+{
+    spareNodes.push_back(node);
+}
+
+void TlsfAllocator::insertFree(uint32_t node)
+{
+    uint32_t fl, sl;
+    mapping(nodes[node].size, fl, sl);
+
+    uint32_t head = freeLists[fl][sl];
+    nodes[node].free = true;
+    nodes[node].prevFree = INVALID;
+    nodes[node].nextFree = head;
+    if (head != INVALID) {
+        nodes[head].prevFree = node;
+    }
+    freeLists[fl][sl] = node;
+
+    flBitmap |= 1ull << fl;
+    slBitmap[fl] |= 1u << sl;
+}
+
+void TlsfAllocator::removeFree(uint32_t node)
+{
+    uint32_t fl, sl;
+    mapping(nodes[node].size, fl, sl);
+
+    uint32_t prev = nodes[node].prevFree;
+    uint32_t next = nodes[node].nextFree;
+    if (prev != INVALID) {
+        nodes[prev].nextFree = next;
+    }
+    else {
+        freeLists[fl][sl] = next;
+    }
+    if (next != INVALID) {
+        nodes[next].prevFree = prev;
+    }
+    nodes[node].free = false;
+
+    if (freeLists[fl][sl] == INVALID) {
+        slBitmap[fl] &= ~(1u << sl);
+        if (!slBitmap[fl]) {
+            flBitmap &= ~(1ull << fl);
+        }
+    }
+}
+
+/// <summary>
+/// Rounds size up to the next class boundary so that any range in the class found is large enough
+/// </summary>
+uint32_t TlsfAllocator::findFree(vk::DeviceSize size) const
+{
+    uint32_t fl = highestBit(size), sl;
+    if (fl >= SL_LOG2) {
+        size += (vk::DeviceSize(1) << (fl - SL_LOG2)) - 1;
+    }
+    mapping(size, fl, sl);
+
+    uint32_t slMap = slBitmap[fl] & (~0u << sl);
+    if (!slMap) {
+        uint64_t flMap = fl + 1 < FL_COUNT ? flBitmap & (~0ull << (fl + 1)) : 0;
+        if (!flMap) return INVALID;
+
+        fl = lowestBit(flMap);
+        slMap = slBitmap[fl];
+    }
+    sl = lowestBit(slMap);
+    return freeLists[fl][sl];
+}
+
+uint32_t TlsfAllocator::allocate(vk::DeviceSize size, vk::DeviceSize alignment, vk::DeviceSize& offset)
+{
+    if (size == 0) size = 1;
+    if (alignment == 0) alignment = 1;
+
+    auto fits = [&](uint32_t node) {
+        return node != INVALID && alignUp(nodes[node].offset, alignment) + size <= nodes[node].offset + nodes[node].size;
+    };
+
+    uint32_t node = findFree(size);
+    if (!fits(node)) {
+        // the alignment padding did not fit, look for a class that fits the worst case
+        node = findFree(size + alignment - 1);
+        if (node == INVALID) return INVALID;
+    }
+    removeFree(node);
+
+    // padding in front of the aligned offset stays part of the node
+    vk::DeviceSize aligned = alignUp(nodes[node].offset, alignment);
+    vk::DeviceSize used = aligned - nodes[node].offset + size;
+
+    if (nodes[node].size - used >= MIN_SPLIT) {
+        uint32_t rest = newNode();
+        nodes[rest].offset = nodes[node].offset + used;
+        nodes[rest].size = nodes[node].size - used;
+        nodes[rest].prevPhysical = node;
+        nodes[rest].nextPhysical = nodes[node].nextPhysical;
+        if (nodes[rest].nextPhysical != INVALID) {
+            nodes[nodes[rest].nextPhysical].prevPhysical = rest;
+        }
+        nodes[node].nextPhysical = rest;
+        nodes[node].size = used;
+        insertFree(rest);
+    }
+
+    freeBytes -= nodes[node].size;
+    offset = aligned;
+    return node;
+}
+
+void TlsfAllocator::free(uint32_t node)
+{
+    freeBytes += nodes[node].size;
+
+    uint32_t next = nodes[node].nextPhysical;
+    if (next != INVALID && nodes[next].free) {
+        removeFree(next);
+        nodes[node].size += nodes[next].size;
+        nodes[node].nextPhysical = nodes[next].nextPhysical;
+        if (nodes[node].nextPhysical != INVALID) {
+            nodes[nodes[node].nextPhysical].prevPhysical = node;
+        }
+        releaseNode(next);
+    }
+
+    uint32_t prev = nodes[node].prevPhysical;
+    if (prev != INVALID && nodes[prev].free) {
+        removeFree(prev);
+        nodes[prev].size += nodes[node].size;
+        nodes[prev].nextPhysical = nodes[node].nextPhysical;
+        if (nodes[prev].nextPhysical != INVALID) {
+            nodes[nodes[prev].nextPhysical].prevPhysical = prev;
+        }
+        releaseNode(node);
+        node = prev;
+    }
+
+    insertFree(node);
+}
+
+vk::DeviceSize TlsfAllocator::getLargestFreeRange() const
+{
+    if (!flBitmap) return 0;
+
+    uint32_t fl = highestBit(flBitmap);
+    uint32_t sl = highestBit(slBitmap[fl]);
+
+    vk::DeviceSize largest = 0;
+    for (uint32_t node = freeLists[fl][sl]; node != INVALID; node = nodes[node].nextFree) {
+        largest = std::max(largest, nodes[node].size);
+    }
+    return largest;
+}
+
+/*LINEAR*/
+
+bool LinearAllocator::allocate(vk::DeviceSize size, vk::DeviceSize alignment, vk::DeviceSize& offset)
+{
+    vk::DeviceSize aligned = alignUp(head, alignment ? alignment : 1);
+    if (aligned + size > this->size) return false;
+
+    offset = aligned;
+    head = aligned + size;
+    return true;
+}
+
+/*MEMORY ALLOCATOR*/
+
+MemoryAllocator::MemoryAllocator() = default;
+MemoryAllocator::~MemoryAllocator() = default;
+
+void MemoryAllocator::create(vk::PhysicalDevice physicalDevice, vk::Device device, bool memoryBudgetSupported, const vk::DispatchLoaderDynamic& dispatcher)
+{
+    this->physicalDevice = physicalDevice;
+    this->device = device;
+    this->memoryBudgetSupported = memoryBudgetSupported;
+    this->dispatcher = &dispatcher;
+
+    memoryProperties = physicalDevice.getMemoryProperties();
+    auto limits = physicalDevice.getProperties().limits;
+    bufferImageGranularity = limits.bufferImageGranularity;
+    maxAllocationCount = limits.maxMemoryAllocationCount;
+}
+
+void MemoryAllocator::destroy()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    for (auto& block : blocks) {
+        freeBlock(*block);
+    }
+    for (auto& pool : pools) {
+        freeBlock(*pool);
+    }
+    blocks.clear();
+    pools.clear();
+}
+
+/// <summary>
+/// Picks the memory type with all required flags and most preferred flags, UINT32_MAX when none matches
+/// </summary>
+uint32_t MemoryAllocator::findMemoryType(uint32_t typeBits, vk::MemoryPropertyFlags required, vk::MemoryPropertyFlags preferred) const
+{
+    uint32_t best = UINT32_MAX;
+    int bestScore = -1;
+
+    for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++) {
+        auto flags = memoryProperties.memoryTypes[i].propertyFlags;
+        if (!(typeBits & (1u << i)) || (flags & required) != required) continue;
+
+        int score = 0;
+        for (uint32_t bit = 0; bit < 32; bit++) {
+            auto flag = static_cast<vk::MemoryPropertyFlagBits>(1u << bit);
+            if ((preferred & flag) && (flags & flag)) score++;
+        }
+        if (score > bestScore) {
+            best = i;
+            bestScore = score;
+        }
+    }
+
+    return best;
+}
+
+/// <summary>
+/// Small heaps (integrated GPUs, host visible BAR memory) get proportionally smaller blocks
+/// </summary>
+vk::DeviceSize MemoryAllocator::getBlockSize(uint32_t memoryType) const
+{
+    vk::DeviceSize heapSize = memoryProperties.memoryHeaps[memoryProperties.memoryTypes[memoryType].heapIndex].size;
+    if (heapSize <= 1024ull * 1024 * 1024) {
+        return alignUp(heapSize / 8, 1024 * 1024);
+    }
+    return DEFAULT_BLOCK_SIZE;
+}
+
+std::unique_ptr<MemoryBlock> MemoryAllocator::allocateBlock(vk::DeviceSize size, uint32_t memoryType, ResourceKind kind, AllocationStrategy strategy, bool dedicated)
+{
+    if (maxAllocationCount && deviceMemoryCount >= maxAllocationCount) {
+        throw vk::TooManyObjectsError("maxMemoryAllocationCount reached");
+    }
+
+    auto allocInfo = vk::MemoryAllocateInfo();
+    allocInfo.allocationSize = size;
+    allocInfo.memoryTypeIndex = memoryType;
+
+    auto block = std::make_unique<MemoryBlock>();
+    block->memory = device.allocateMemory(allocInfo);
+    block->size = size;
+    block->memoryType = memoryType;
+    block->kind = kind;
+    block->dedicated = dedicated;
+    deviceMemoryCount++;
+
+    if (memoryProperties.memoryTypes[memoryType].propertyFlags & vk::MemoryPropertyFlagBits::eHostVisible) {
+        block->mapped = device.mapMemory(block->memory, 0, VK_WHOLE_SIZE);
+    }
+
+    if (!dedicated) {
+        if (strategy == AllocationStrategy::Linear) {
+            block->linear = std::make_unique<LinearAllocator>(size);
+        }
+        else {
+            block->tlsf = std::make_unique<TlsfAllocator>(size);
+        }
+    }
+
+    return block;
+}
+
+void MemoryAllocator::freeBlock(MemoryBlock& block)
+{
+    if (block.mapped) {
+        device.unmapMemory(block.memory);
+    }
+    device.freeMemory(block.memory);
+    deviceMemoryCount--;
+}
+
+bool MemoryAllocator::allocateFromBlock(MemoryBlock& block, const vk::MemoryRequirements& requirements, Allocation& allocation)
+{
+    vk::DeviceSize offset = 0;
+    uint32_t node = TlsfAllocator::INVALID;
+
+    if (block.tlsf) {
+        node = block.tlsf->allocate(requirements.size, requirements.alignment, offset);
+        if (node == TlsfAllocator::INVALID) return false;
+    }
+    else if (block.linear) {
+        if (!block.linear->allocate(requirements.size, requirements.alignment, offset)) return false;
+    }
+    else if (block.allocationCount) {
+        return false;
+    }
+
+    allocation.memory = block.memory;
+    allocation.offset = offset;
+    allocation.size = requirements.size;
+    allocation.mapped = block.mapped ? static_cast<char*>(block.mapped) + offset : nullptr;
+    allocation.memoryType = block.memoryType;
+    allocation.block = &block;
+    allocation.node = node;
+    block.allocationCount++;
+    return true;
+}
+
+bool MemoryAllocator::allocateFromType(const vk::MemoryRequirements& requirements, uint32_t memoryType, ResourceKind kind, Allocation& allocation)
+{
+    vk::DeviceSize blockSize = getBlockSize(memoryType);
+
+    if (requirements.size > blockSize / 2) {
+        try {
+            blocks.push_back(allocateBlock(requirements.size, memoryType, kind, AllocationStrategy::Tlsf, true));
+        }
+        catch (const vk::OutOfDeviceMemoryError&) {
+            return false;
+        }
+        return allocateFromBlock(*blocks.back(), requirements, allocation);
+    }
+
+    // with a bufferImageGranularity above 1 linear and optimal resources never share a block,
+    // so neighbouring allocations can never alias the same granularity page
+    for (auto& block : blocks) {
+        if (block->dedicated || block->memoryType != memoryType) continue;
+        if (bufferImageGranularity > 1 && block->kind != kind) continue;
+
+        if (allocateFromBlock(*block, requirements, allocation)) {
+            return true;
+        }
+    }
+
+    if (memoryBudgetSupported) {
+        auto heap = collectStats()[memoryProperties.memoryTypes[memoryType].heapIndex];
+        if (heap.usage + blockSize > heap.budget) return false;
+    }
+
+    for (; blockSize >= requirements.size; blockSize /= 2) {
+        try {
+            blocks.push_back(allocateBlock(blockSize, memoryType, kind, AllocationStrategy::Tlsf, false));
+        }
+        catch (const vk::OutOfDeviceMemoryError&) {
+            continue;
+        }
+        return allocateFromBlock(*blocks.back(), requirements, allocation);
+    }
+
+    return false;
+}
+
+Allocation MemoryAllocator::allocate(const vk::MemoryRequirements& requirements, vk::MemoryPropertyFlags required, ResourceKind kind, vk::MemoryPropertyFlags preferred)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    Allocation allocation;
+    uint32_t typeBits = requirements.memoryTypeBits;
+
+    // fall back to the next best memory type when the preferred one is exhausted or over budget
+    for (;;) {
+        uint32_t memoryType = findMemoryType(typeBits, required, preferred);
+        if (memoryType == UINT32_MAX) break;
+
+        if (allocateFromType(requirements, memoryType, kind, allocation)) {
+            return allocation;
+        }
+        typeBits &= ~(1u << memoryType);
+    }
+
+    throw std::runtime_error("failed to allocate device memory!");
+}
+
+Allocation MemoryAllocator::allocateForBuffer(vk::Buffer buffer, vk::MemoryPropertyFlags required, vk::MemoryPropertyFlags preferred)
+{
+    Allocation allocation = allocate(device.getBufferMemoryRequirements(buffer), required, ResourceKind::Linear, preferred);
+    device.bindBufferMemory(buffer, allocation.memory, allocation.offset);
+    return allocation;
+}
+
+Allocation MemoryAllocator::allocateForImage(vk::Image image, vk::ImageTiling tiling, vk::MemoryPropertyFlags required, vk::MemoryPropertyFlags preferred)
+{
+    auto kind = tiling == vk::ImageTiling::eOptimal ? ResourceKind::Optimal : ResourceKind::Linear;
+    Allocation allocation = allocate(device.getImageMemoryRequirements(image), required, kind, preferred);
+    device.bindImageMemory(image, allocation.memory, allocation.offset);
+    return allocation;
+}
+
+void MemoryAllocator::free(Allocation& allocation)
+{
+    if (!allocation.block) return;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    MemoryBlock* block = allocation.block;
+
+    if (block->tlsf) {
+        block->tlsf->free(allocation.node);
+    }
+    block->allocationCount--;
+    allocation = Allocation();
+
+    // pools are released by destroyPool, linear allocations by resetPool
+    if (block->linear || std::any_of(pools.begin(), pools.end(), [block](auto& pool) { return pool.get() == block; })) {
+        return;
+    }
+
+    bool release = block->dedicated;
+    if (!release && block->tlsf->isEmpty()) {
+        // keep a single empty block per memory type around to avoid allocation churn
+        release = std::any_of(blocks.begin(), blocks.end(), [block](auto& other) {
+            return other.get() != block && !other->dedicated && other->memoryType == block->memoryType &&
+                other->kind == block->kind && other->allocationCount == 0;
+        });
+    }
+
+    if (release) {
+        freeBlock(*block);
+        blocks.erase(std::find_if(blocks.begin(), blocks.end(), [block](auto& other) { return other.get() == block; }));
+    }
+}
+
+Buffer MemoryAllocator::createBuffer(vk::DeviceSize size, vk::BufferUsageFlags usage, vk::MemoryPropertyFlags required, vk::MemoryPropertyFlags preferred,
+    const std::vector<uint32_t>& sharedQueueFamilies)
+{
+    std::vector<uint32_t> families = sharedQueueFamilies;
+    std::sort(families.begin(), families.end());
+    families.erase(std::unique(families.begin(), families.end()), families.end());
+
+    auto bufferInfo = vk::BufferCreateInfo();
+    bufferInfo.size = size;
+    bufferInfo.usage = usage;
+    bufferInfo.sharingMode = vk::SharingMode::eExclusive;
+    if (families.size() > 1) {
+        bufferInfo.sharingMode = vk::SharingMode::eConcurrent;
+        bufferInfo.queueFamilyIndexCount = static_cast<uint32_t>(families.size());
+        bufferInfo.pQueueFamilyIndices = families.data();
+    }
+
+    Buffer buffer;
+    buffer.buffer = device.createBuffer(bufferInfo);
+    try {
+        buffer.allocation = allocateForBuffer(buffer.buffer, required, preferred);
+    }
+    catch (...) {
+        device.destroyBuffer(buffer.buffer);
+        throw;
+    }
+    return buffer;
+}
+
+void MemoryAllocator::destroyBuffer(Buffer& buffer)
+{
+    if (buffer.buffer) {
+        device.destroyBuffer(buffer.buffer);
+        buffer.buffer = nullptr;
+    }
+    free(buffer.allocation);
+}
+
+MemoryBlock* MemoryAllocator::createPool(vk::DeviceSize size, uint32_t memoryTypeBits, vk::MemoryPropertyFlags required, AllocationStrategy strategy)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    uint32_t memoryType = findMemoryType(memoryTypeBits, required, {});
+    if (memoryType == UINT32_MAX) {
+        throw std::runtime_error("failed to find suitable memory type!");
+    }
+
+    pools.push_back(allocateBlock(size, memoryType, ResourceKind::Linear, strategy, false));
+    return pools.back().get();
+}
+
+Allocation MemoryAllocator::allocate(MemoryBlock* pool, const vk::MemoryRequirements& requirements)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    Allocation allocation;
+    if (!(requirements.memoryTypeBits & (1u << pool->memoryType)) || !allocateFromBlock(*pool, requirements, allocation)) {
+        throw std::runtime_error("memory pool exhausted!");
+    }
+    return allocation;
+}
+
+void MemoryAllocator::resetPool(MemoryBlock* pool)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    if (pool->linear) {
+        pool->linear->reset();
+        pool->allocationCount = 0;
+    }
+}
+
+void MemoryAllocator::destroyPool(MemoryBlock* pool)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    auto it = std::find_if(pools.begin(), pools.end(), [pool](auto& other) { return other.get() == pool; });
+    if (it == pools.end()) return;
+
+    freeBlock(**it);
+    pools.erase(it);
+}
+
+/// <summary>
+/// Per heap block and allocation totals, usage and budget come from VK_EXT_memory_budget when available
+/// and are estimated from our own blocks otherwise
+/// </summary>
+std::vector<MemoryHeapStats> MemoryAllocator::getStats()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return collectStats();
+}
+
+std::vector<MemoryHeapStats> MemoryAllocator::collectStats()
+{
+    std::vector<MemoryHeapStats> heaps(memoryProperties.memoryHeapCount);
+
+    auto accumulate = [&](const MemoryBlock& block) {
+        auto& heap = heaps[memoryProperties.memoryTypes[block.memoryType].heapIndex];
+        heap.blockBytes += block.size;
+        heap.allocatedBytes += block.size - block.getFreeBytes();
+        heap.blockCount++;
+        heap.allocationCount += block.allocationCount;
+        if (block.tlsf) {
+            heap.largestFreeRange = std::max(heap.largestFreeRange, block.tlsf->getLargestFreeRange());
+        }
+    };
+    for (auto& block : blocks) accumulate(*block);
+    for (auto& pool : pools) accumulate(*pool);
+
+    if (memoryBudgetSupported) {
+        auto properties = physicalDevice.getMemoryProperties2KHR<vk::PhysicalDeviceMemoryProperties2, vk::PhysicalDeviceMemoryBudgetPropertiesEXT>(*dispatcher);
+        auto& budget = properties.get<vk::PhysicalDeviceMemoryBudgetPropertiesEXT>();
+        for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; i++) {
+            heaps[i].usage = budget.heapUsage[i];
+            heaps[i].budget = budget.heapBudget[i];
+        }
+    }
+    else {
+        for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; i++) {
+            heaps[i].usage = heaps[i].blockBytes;
+            heaps[i].budget = memoryProperties.memoryHeaps[i].size / 10 * 8;
+        }
+    }
+
+    return heaps;
+}
+
+void MemoryAllocator::printStats(std::ostream& out)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    auto heaps = collectStats();
+    auto flags = out.flags();
+    const double MiB = 1024.0 * 1024.0;
+
+    out << std::fixed << std::setprecision(1);
+    out << "device memory: " << deviceMemoryCount << " vkAllocateMemory allocations (limit " << maxAllocationCount << ")"
+        << (memoryBudgetSupported ? ", VK_EXT_memory_budget" : ", estimated budget") << std::endl;
+    for (size_t i = 0; i < heaps.size(); i++) {
+        bool deviceLocal = static_cast<bool>(memoryProperties.memoryHeaps[i].flags & vk::MemoryHeapFlagBits::eDeviceLocal);
+        out << "  heap " << i << (deviceLocal ? " (device local)" : "") << ": "
+            << heaps[i].blockCount << " blocks " << heaps[i].blockBytes / MiB << " MiB, "
+            << heaps[i].allocationCount << " allocations " << heaps[i].allocatedBytes / MiB << " MiB, "
+            << "largest free range " << heaps[i].largestFreeRange / MiB << " MiB, "
+            << "usage " << heaps[i].usage / MiB << " / budget " << heaps[i].budget / MiB << " MiB" << std::endl;
+    }
+    out.flags(flags);
+}
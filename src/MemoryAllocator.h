@@ -0,0 +1,178 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+#include <vulkan/vulkan.hpp>
+
+/// <summary>
+/// Two-level segregated fit allocator over the offset range [0, size) of one memory block.
+/// O(1) allocate and free, neighbouring free ranges are merged immediately.
+/// </summary>
+class TlsfAllocator
+{
+public:
+	static constexpr uint32_t INVALID = UINT32_MAX;
+
+	explicit TlsfAllocator(vk::DeviceSize size);
+	/// <summary>
+	/// Returns a node handle for free() or INVALID when no free range fits
+	/// </summary>
+	uint32_t allocate(vk::DeviceSize size, vk::DeviceSize alignment, vk::DeviceSize& offset);
+	void free(uint32_t node);
+	vk::DeviceSize getFreeBytes() const { return freeBytes; }
+	vk::DeviceSize getLargestFreeRange() const;
+	bool isEmpty() const { return freeBytes == size; }
+
+private:
+	static constexpr uint32_t SL_LOG2 = 4;
+	static constexpr uint32_t SL_COUNT = 1 << SL_LOG2;
+	static constexpr uint32_t FL_COUNT = 64;
+	static constexpr vk::DeviceSize MIN_SPLIT = 64;
+
+	struct Node {
+		vk::DeviceSize offset;
+		vk::DeviceSize size;
+		uint32_t prevPhysical;
+		uint32_t nextPhysical;
+		uint32_t prevFree;
+		uint32_t nextFree;
+		bool free;
+	};
+
+	vk::DeviceSize size;
+	vk::DeviceSize freeBytes;
+	std::vector<Node> nodes;
+	std::vector<uint32_t> spareNodes;
+	uint64_t flBitmap = 0;
+	uint32_t slBitmap[FL_COUNT] = {};
+	uint32_t freeLists[FL_COUNT][SL_COUNT];
+
+	uint32_t newNode();
+	void releaseNode(uint32_t node);
+	void insertFree(uint32_t node);
+	void removeFree(uint32_t node);
+	uint32_t findFree(vk::DeviceSize size) const;
+	static void mapping(vk::DeviceSize size, uint32_t& fl, uint32_t& sl);
+};
+
+/// <summary>
+/// Bump allocator, allocations are only released all at once by reset()
+/// </summary>
+class LinearAllocator
+{
+public:
+	explicit LinearAllocator(vk::DeviceSize size) : size(size) {}
+	bool allocate(vk::DeviceSize size, vk::DeviceSize alignment, vk::DeviceSize& offset);
+	void reset() { head = 0; }
+	vk::DeviceSize getFreeBytes() const { return size - head; }
+
+private:
+	vk::DeviceSize size;
+	vk::DeviceSize head = 0;
+};
+
+enum class AllocationStrategy {
+	Tlsf,
+	Linear,
+};
+
+/// <summary>
+/// Kind of resource bound to an allocation, linear and optimal resources must be
+/// bufferImageGranularity apart when they share a memory block
+/// </summary>
+enum class ResourceKind {
+	Linear, // buffers and linear tiling images
+	Optimal, // optimal tiling images
+};
+
+struct MemoryBlock;
+
+struct Allocation {
+	vk::DeviceMemory memory;
+	vk::DeviceSize offset = 0;
+	vk::DeviceSize size = 0;
+	void* mapped = nullptr; // host visible blocks stay mapped for their whole lifetime
+	uint32_t memoryType = 0;
+	MemoryBlock* block = nullptr;
+	uint32_t node = TlsfAllocator::INVALID;
+};
+
+struct Buffer {
+	vk::Buffer buffer;
+	Allocation allocation;
+};
+
+struct MemoryHeapStats {
+	vk::DeviceSize blockBytes = 0;
+	vk::DeviceSize allocatedBytes = 0;
+	vk::DeviceSize largestFreeRange = 0;
+	vk::DeviceSize usage = 0;
+	vk::DeviceSize budget = 0;
+	uint32_t blockCount = 0;
+	uint32_t allocationCount = 0;
+};
+
+/// <summary>
+/// Sub-allocates device memory from large per memory type blocks.
+/// Large requests and pools get their own vk::DeviceMemory, everything else shares TLSF managed blocks.
+/// </summary>
+class MemoryAllocator
+{
+public:
+	static constexpr vk::DeviceSize DEFAULT_BLOCK_SIZE = 64ull * 1024 * 1024;
+
+	MemoryAllocator();
+	~MemoryAllocator();
+
+	void create(vk::PhysicalDevice physicalDevice, vk::Device device, bool memoryBudgetSupported, const vk::DispatchLoaderDynamic& dispatcher);
+	void destroy();
+
+	Allocation allocate(const vk::MemoryRequirements& requirements, vk::MemoryPropertyFlags required, ResourceKind kind, vk::MemoryPropertyFlags preferred = {});
+	Allocation allocateForBuffer(vk::Buffer buffer, vk::MemoryPropertyFlags required, vk::MemoryPropertyFlags preferred = {});
+	Allocation allocateForImage(vk::Image image, vk::ImageTiling tiling, vk::MemoryPropertyFlags required, vk::MemoryPropertyFlags preferred = {});
+	void free(Allocation& allocation);
+
+	/// <summary>
+	/// Exclusive unless more than one distinct queue family is listed in sharedQueueFamilies, then concurrent between those
+	/// </summary>
+	Buffer createBuffer(vk::DeviceSize size, vk::BufferUsageFlags usage, vk::MemoryPropertyFlags required, vk::MemoryPropertyFlags preferred = {},
+		const std::vector<uint32_t>& sharedQueueFamilies = {});
+	void destroyBuffer(Buffer& buffer);
+
+	/// <summary>
+	/// Pool backed by a single block of the given size, used with AllocationStrategy::Linear for per-frame data
+	/// </summary>
+	MemoryBlock* createPool(vk::DeviceSize size, uint32_t memoryTypeBits, vk::MemoryPropertyFlags required, AllocationStrategy strategy);
+	Allocation allocate(MemoryBlock* pool, const vk::MemoryRequirements& requirements);
+	void resetPool(MemoryBlock* pool);
+	void destroyPool(MemoryBlock* pool);
+
+	std::vector<MemoryHeapStats> getStats();
+	void printStats(std::ostream& out);
+	uint32_t getDeviceMemoryCount() const { return deviceMemoryCount; }
+
+private:
+	vk::PhysicalDevice physicalDevice;
+	vk::Device device;
+	const vk::DispatchLoaderDynamic* dispatcher = nullptr;
+	bool memoryBudgetSupported = false;
+	vk::PhysicalDeviceMemoryProperties memoryProperties;
+	vk::DeviceSize bufferImageGranularity = 1;
+	uint32_t maxAllocationCount = 0;
+	uint32_t deviceMemoryCount = 0;
+
+	std::mutex mutex;
+	std::vector<std::unique_ptr<MemoryBlock>> blocks;
+	std::vector<std::unique_ptr<MemoryBlock>> pools;
+
+	uint32_t findMemoryType(uint32_t typeBits, vk::MemoryPropertyFlags required, vk::MemoryPropertyFlags preferred) const;
+	vk::DeviceSize getBlockSize(uint32_t memoryType) const;
+	std::unique_ptr<MemoryBlock> allocateBlock(vk::DeviceSize size, uint32_t memoryType, ResourceKind kind, AllocationStrategy strategy, bool dedicated);
+	void freeBlock(MemoryBlock& block);
+	bool allocateFromType(const vk::MemoryRequirements& requirements, uint32_t memoryType, ResourceKind kind, Allocation& allocation);
+	static bool allocateFromBlock(MemoryBlock& block, const vk::MemoryRequirements& requirements, Allocation& allocation);
+	std::vector<MemoryHeapStats> collectStats();
+};
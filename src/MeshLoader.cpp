@@ -0,0 +1,711 @@
+#include "MeshLoader.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cfloat>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <stdexcept>
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    double millisecondsSince(Clock::time_point start) {
+        return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    }
+
+    const uint32_t NO_INDEX = UINT32_MAX;
+    const int32_t NO_RAW_INDEX = INT32_MIN;
+
+    /// <summary>
+    /// Position/uv/normal indices of one face corner, 0-based into the whole file
+    /// </summary>
+    struct Corner {
+        uint32_t position;
+        uint32_t uv;
+        uint32_t normal;
+
+        bool operator==(const Corner& other) const { return position == other.position && uv == other.uv && normal == other.normal; }
+    };
+
+    struct CornerHash {
+        size_t operator()(const Corner& corner) const {
+            uint64_t hash = corner.position;
+            hash = hash * 0x100000001b3ull ^ corner.uv;
+            hash = hash * 0x100000001b3ull ^ corner.normal;
+            hash ^= hash >> 29;
+            hash *= 0xbf58476d1ce4e5b9ull;
+            hash ^= hash >> 32;
+            return static_cast<size_t>(hash);
+        }
+    };
+
+    /// <summary>
+    /// A corner as written in the file. Positive OBJ indices are stored 0-based, negative ones are relative to the
+    /// attributes read so far and only known relative to the chunk until the chunks before it have been counted.
+    /// </summary>
+    struct RawCorner {
+        int32_t index[3]; // position, uv, normal
+        uint8_t chunkRelative; // bit i set = index[i] is relative to the chunk's first attribute
+    };
+
+    struct ObjChunk {
+        const char* begin;
+        const char* end;
+        std::vector<float> positions;
+        std::vector<float> uvs;
+        std::vector<float> normals;
+        std::vector<RawCorner> corners; // three per triangle
+        uint32_t attributeBase[3] = {}; // positions, uvs and normals in the chunks before this one
+        size_t firstCorner = 0;
+    };
+
+    const char* skipSpaces(const char* p, const char* end) {
+        while (p < end && (*p == ' ' || *p == '\t')) p++;
+        return p;
+    }
+
+    const char* skipLine(const char* p, const char* end) {
+        while (p < end && *p != '\n') p++;
+        return p < end ? p + 1 : end;
+    }
+
+    bool isDigit(char c) {
+        return c >= '0' && c <= '9';
+    }
+
+    /// <summary>
+    /// Plain decimal floats the way exporters write them, anything else (inf, nan, hex) goes through strtof.
+    /// The buffer is zero terminated so strtof can never run off its end.
+    /// </summary>
+    const char* parseFloat(const char* p, const char* end, float& value) {
+        p = skipSpaces(p, end);
+        const char* start = p;
+
+        bool negative = false;
+        if (p < end && (*p == '-' || *p == '+')) {
+            negative = *p == '-';
+            p++;
+        }
+
+        double result = 0.0;
+        bool digits = false;
+        while (p < end && isDigit(*p)) {
+            result = result * 10.0 + (*p - '0');
+            digits = true;
+            p++;
+        }
+        if (p < end && *p == '.') {
+            p++;
+            double scale = 0.1;
+            while (p < end && isDigit(*p)) {
+                result += (*p - '0') * scale;
+                scale *= 0.1;
+                digits = true;
+                p++;
+            }
+        }
+
+        if (!digits) {
+            char* parsed = nullptr;
+            value = std::strtof(start, &parsed);
+            return parsed > start ? parsed : start;
+        }
+
+        if (p < end && (*p == 'e' || *p == 'E')) {
+            p++;
+            bool negativeExponent = false;
+            if (p < end && (*p == '-' || *p == '+')) {
+                negativeExponent = *p == '-';
+                p++;
+            }
+            int exponent = 0;
+            while (p < end && isDigit(*p)) {
+                exponent = std::min(exponent * 10 + (*p - '0'), 1000);
+                p++;
+            }
+            result *= std::pow(10.0, negativeExponent ? -exponent : exponent);
+        }
+
+        value = static_cast<float>(negative ? -result : result);
+        return p;
+    }
+
+    /// <summary>
+    /// One OBJ index, NO_RAW_INDEX when the component is empty as in "1//3"
+    /// </summary>
+    const char* parseIndex(const char* p, const char* end, uint32_t countSoFar, int32_t& index, bool& chunkRelative) {
+        bool negative = p < end && *p == '-';
+        if (negative) p++;
+
+        int64_t value = 0;
+        bool digits = false;
+        while (p < end && isDigit(*p)) {
+            value = std::min<int64_t>(value * 10 + (*p - '0'), INT32_MAX);
+            digits = true;
+            p++;
+        }
+
+        chunkRelative = false;
+        if (!digits || value == 0) {
+            index = NO_RAW_INDEX;
+        }
+        else if (negative) {
+            index = static_cast<int32_t>((int64_t)countSoFar - value);
+            chunkRelative = true;
+        }
+        else {
+            index = static_cast<int32_t>(value - 1);
+        }
+        return p;
+    }
+
+    void parseChunk(ObjChunk& chunk) {
+        std::vector<RawCorner> face;
+        const char* p = chunk.begin;
+        const char* end = chunk.end;
+
+        while (p < end) {
+            p = skipSpaces(p, end);
+            if (end - p < 2) break;
+
+            if (p[0] == 'v' && (p[1] == ' ' || p[1] == '\t')) {
+                float position[3];
+                p = parseFloat(p + 1, end, position[0]);
+                p = parseFloat(p, end, position[1]);
+                p = parseFloat(p, end, position[2]);
+                chunk.positions.insert(chunk.positions.end(), position, position + 3);
+            }
+            else if (p[0] == 'v' && p[1] == 't') {
+                float uv[2];
+                p = parseFloat(p + 2, end, uv[0]);
+                p = parseFloat(p, end, uv[1]);
+                chunk.uvs.insert(chunk.uvs.end(), uv, uv + 2);
+            }
+            else if (p[0] == 'v' && p[1] == 'n') {
+                float normal[3];
+                p = parseFloat(p + 2, end, normal[0]);
+                p = parseFloat(p, end, normal[1]);
+                p = parseFloat(p, end, normal[2]);
+                chunk.normals.insert(chunk.normals.end(), normal, normal + 3);
+            }
+            else if (p[0] == 'f' && (p[1] == ' ' || p[1] == '\t')) {
+                uint32_t counts[3] = {
+                    static_cast<uint32_t>(chunk.positions.size() / 3),
+                    static_cast<uint32_t>(chunk.uvs.size() / 2),
+                    static_cast<uint32_t>(chunk.normals.size() / 3),
+                };
+
+                face.clear();
+                p = skipSpaces(p + 1, end);
+                while (p < end && *p != '\n' && *p != '\r' && *p != '#') {
+                    RawCorner corner = { { NO_RAW_INDEX, NO_RAW_INDEX, NO_RAW_INDEX }, 0 };
+                    for (uint32_t component = 0; component < 3; component++) {
+                        bool chunkRelative;
+                        p = parseIndex(p, end, counts[component], corner.index[component], chunkRelative);
+                        corner.chunkRelative |= chunkRelative ? (1 << component) : 0;
+                        if (p >= end || *p != '/') break;
+                        p++;
+                    }
+                    face.push_back(corner);
+                    // skip whatever is left of a malformed token so the loop always advances
+                    while (p < end && *p != ' ' && *p != '\t' && *p != '\n' && *p != '\r') p++;
+                    p = skipSpaces(p, end);
+                }
+
+                // polygons are triangulated as fans
+                for (size_t i = 2; i < face.size(); i++) {
+                    chunk.corners.push_back(face[0]);
+                    chunk.corners.push_back(face[i - 1]);
+                    chunk.corners.push_back(face[i]);
+                }
+            }
+            p = skipLine(p, end);
+        }
+    }
+
+    /// <summary>
+    /// Resolves a raw index against the whole file, throws when it points outside of it
+    /// </summary>
+    uint32_t resolveIndex(int32_t index, bool chunkRelative, uint32_t base, uint32_t count) {
+        if (index == NO_RAW_INDEX) return NO_INDEX;
+
+        int64_t resolved = chunkRelative ? (int64_t)base + index : index;
+        if (resolved < 0 || resolved >= count) {
+            throw std::runtime_error("mesh index out of range!");
+        }
+        return static_cast<uint32_t>(resolved);
+    }
+}
+
+Mesh MeshLoader::loadObj(const std::string& path)
+{
+    stats = MeshImportStats();
+    auto parseStart = Clock::now();
+
+    std::ifstream file(path, std::ios::ate | std::ios::binary);
+    if (!file.is_open()) {
+        throw std::runtime_error("failed to open file!");
+    }
+    size_t fileSize = (size_t)file.tellg();
+    std::vector<char> text(fileSize + 1, '\0');
+    file.seekg(0);
+    file.read(text.data(), fileSize);
+    stats.fileBytes = fileSize;
+
+    // a few chunks per thread, every chunk starts at the beginning of a line
+    uint32_t threadCount = std::max(jobs.getThreadCount(), 1u);
+    uint32_t chunkCount = static_cast<uint32_t>(std::max<size_t>(1, std::min<size_t>(threadCount * 4, fileSize / 65536 + 1)));
+    std::vector<ObjChunk> chunks(chunkCount);
+    const char* fileEnd = text.data() + fileSize;
+    const char* chunkStart = text.data();
+    for (uint32_t i = 0; i < chunkCount; i++) {
+        const char* chunkEnd = i + 1 == chunkCount ? fileEnd : text.data() + fileSize * (i + 1) / chunkCount;
+        chunkEnd = std::max(chunkEnd, chunkStart);
+        while (chunkEnd < fileEnd && chunkEnd[-1] != '\n') chunkEnd++;
+        chunks[i].begin = chunkStart;
+        chunks[i].end = chunkEnd;
+        chunkStart = chunkEnd;
+    }
+
+    jobs.parallelFor(chunkCount, 1, [&](uint32_t begin, uint32_t end, uint32_t) {
+        for (uint32_t i = begin; i < end; i++) {
+            parseChunk(chunks[i]);
+        }
+    });
+
+    uint32_t totals[3] = {};
+    size_t cornerCount = 0;
+    for (auto& chunk : chunks) {
+        uint32_t counts[3] = {
+            static_cast<uint32_t>(chunk.positions.size() / 3),
+            static_cast<uint32_t>(chunk.uvs.size() / 2),
+            static_cast<uint32_t>(chunk.normals.size() / 3),
+        };
+        for (uint32_t component = 0; component < 3; component++) {
+            chunk.attributeBase[component] = totals[component];
+            totals[component] += counts[component];
+        }
+        chunk.firstCorner = cornerCount;
+        cornerCount += chunk.corners.size();
+    }
+    if (cornerCount == 0) {
+        throw std::runtime_error("mesh " + path + " has no faces!");
+    }
+    if (cornerCount > UINT32_MAX) {
+        throw std::runtime_error("mesh " + path + " is too large!");
+    }
+
+    // gather the attributes and resolve every corner against the whole file
+    std::vector<float> positions((size_t)totals[0] * 3);
+    std::vector<float> uvs((size_t)totals[1] * 2);
+    std::vector<float> normals((size_t)totals[2] * 3);
+    std::vector<Corner> corners(cornerCount);
+    std::atomic<bool> outOfRange{ false };
+
+    jobs.parallelFor(chunkCount, 1, [&](uint32_t begin, uint32_t end, uint32_t) {
+        for (uint32_t i = begin; i < end; i++) {
+            ObjChunk& chunk = chunks[i];
+            std::copy(chunk.positions.begin(), chunk.positions.end(), positions.begin() + (size_t)chunk.attributeBase[0] * 3);
+            std::copy(chunk.uvs.begin(), chunk.uvs.end(), uvs.begin() + (size_t)chunk.attributeBase[1] * 2);
+            std::copy(chunk.normals.begin(), chunk.normals.end(), normals.begin() + (size_t)chunk.attributeBase[2] * 3);
+
+            try {
+                for (size_t c = 0; c < chunk.corners.size(); c++) {
+                    const RawCorner& raw = chunk.corners[c];
+                    Corner& corner = corners[chunk.firstCorner + c];
+                    corner.position = resolveIndex(raw.index[0], raw.chunkRelative & 1, chunk.attributeBase[0], totals[0]);
+                    corner.uv = resolveIndex(raw.index[1], raw.chunkRelative & 2, chunk.attributeBase[1], totals[1]);
+                    corner.normal = resolveIndex(raw.index[2], raw.chunkRelative & 4, chunk.attributeBase[2], totals[2]);
+                    if (corner.position == NO_INDEX) throw std::runtime_error("mesh corner without a position!");
+                }
+            }
+            catch (const std::exception&) {
+                outOfRange = true;
+            }
+            chunk = ObjChunk();
+        }
+    });
+    if (outOfRange) {
+        throw std::runtime_error("mesh " + path + " has out of range indices!");
+    }
+
+    stats.parseMilliseconds = millisecondsSince(parseStart);
+    stats.corners = cornerCount;
+    stats.triangles = cornerCount / 3;
+    auto dedupStart = Clock::now();
+
+    // partition the corners into hash shards so every shard can be deduplicated on its own thread
+    uint32_t shardCount = threadCount * 4;
+    uint32_t rangeCount = threadCount * 4;
+    uint32_t rangeSize = static_cast<uint32_t>((cornerCount + rangeCount - 1) / rangeCount);
+    std::vector<uint16_t> shardOf(cornerCount);
+    std::vector<uint32_t> shardCounts((size_t)rangeCount * shardCount, 0);
+
+    jobs.parallelFor(rangeCount, 1, [&](uint32_t begin, uint32_t end, uint32_t) {
+        for (uint32_t range = begin; range < end; range++) {
+            size_t last = std::min(cornerCount, (size_t)(range + 1) * rangeSize);
+            for (size_t i = (size_t)range * rangeSize; i < last; i++) {
+                uint16_t shard = static_cast<uint16_t>((CornerHash()(corners[i]) >> 40) % shardCount);
+                shardOf[i] = shard;
+                shardCounts[(size_t)range * shardCount + shard]++;
+            }
+        }
+    });
+
+    // shard major offsets, each shard's corners stay in file order
+    std::vector<uint32_t> scatterOffsets(shardCounts.size());
+    std::vector<uint32_t> shardBegin(shardCount + 1, 0);
+    uint32_t running = 0;
+    for (uint32_t shard = 0; shard < shardCount; shard++) {
+        shardBegin[shard] = running;
+        for (uint32_t range = 0; range < rangeCount; range++) {
+            scatterOffsets[(size_t)range * shardCount + shard] = running;
+            running += shardCounts[(size_t)range * shardCount + shard];
+        }
+    }
+    shardBegin[shardCount] = running;
+
+    std::vector<uint32_t> shardCorners(cornerCount);
+    jobs.parallelFor(rangeCount, 1, [&](uint32_t begin, uint32_t end, uint32_t) {
+        for (uint32_t range = begin; range < end; range++) {
+            uint32_t* offsets = &scatterOffsets[(size_t)range * shardCount];
+            size_t last = std::min(cornerCount, (size_t)(range + 1) * rangeSize);
+            for (size_t i = (size_t)range * rangeSize; i < last; i++) {
+                shardCorners[offsets[shardOf[i]]++] = static_cast<uint32_t>(i);
+            }
+        }
+    });
+    shardOf = std::vector<uint16_t>();
+
+    // mesh.indices first holds shard-local vertex ids, the shard offsets are added once all shards are counted
+    Mesh mesh;
+    mesh.indices.resize(cornerCount);
+    std::vector<std::vector<uint32_t>> shardVertices(shardCount); // first corner of every unique vertex
+
+    jobs.parallelFor(shardCount, 1, [&](uint32_t begin, uint32_t end, uint32_t) {
+        for (uint32_t shard = begin; shard < end; shard++) {
+            // open addressing with linear probing, slots hold shard-local vertex ids and the keys live in corners
+            uint32_t size = shardBegin[shard + 1] - shardBegin[shard];
+            size_t capacity = 16;
+            while (capacity < (size_t)size * 2) capacity *= 2;
+            std::vector<uint32_t> slots(capacity, NO_INDEX);
+            std::vector<uint32_t>& firstCorners = shardVertices[shard];
+
+            for (uint32_t i = shardBegin[shard]; i < shardBegin[shard + 1]; i++) {
+                uint32_t corner = shardCorners[i];
+                size_t slot = CornerHash()(corners[corner]) & (capacity - 1);
+                while (slots[slot] != NO_INDEX && !(corners[firstCorners[slots[slot]]] == corners[corner])) {
+                    slot = (slot + 1) & (capacity - 1);
+                }
+                if (slots[slot] == NO_INDEX) {
+                    slots[slot] = static_cast<uint32_t>(firstCorners.size());
+                    firstCorners.push_back(corner);
+                }
+                mesh.indices[corner] = slots[slot];
+            }
+        }
+    });
+
+    std::vector<uint32_t> vertexOffsets(shardCount + 1, 0);
+    for (uint32_t shard = 0; shard < shardCount; shard++) {
+        vertexOffsets[shard + 1] = vertexOffsets[shard] + static_cast<uint32_t>(shardVertices[shard].size());
+    }
+    mesh.vertices.resize(vertexOffsets[shardCount]);
+    std::atomic<bool> missingNormals{ false };
+
+    jobs.parallelFor(shardCount, 1, [&](uint32_t begin, uint32_t end, uint32_t) {
+        for (uint32_t shard = begin; shard < end; shard++) {
+            const std::vector<uint32_t>& firstCorners = shardVertices[shard];
+            for (size_t local = 0; local < firstCorners.size(); local++) {
+                const Corner& corner = corners[firstCorners[local]];
+                MeshVertex& vertex = mesh.vertices[vertexOffsets[shard] + local];
+                std::copy_n(&positions[(size_t)corner.position * 3], 3, vertex.position);
+                if (corner.uv != NO_INDEX) std::copy_n(&uvs[(size_t)corner.uv * 2], 2, vertex.uv);
+                else std::fill_n(vertex.uv, 2, 0.0f);
+                if (corner.normal != NO_INDEX) std::copy_n(&normals[(size_t)corner.normal * 3], 3, vertex.normal);
+                else {
+                    std::fill_n(vertex.normal, 3, 0.0f);
+                    missingNormals = true;
+                }
+            }
+            for (uint32_t i = shardBegin[shard]; i < shardBegin[shard + 1]; i++) {
+                mesh.indices[shardCorners[i]] += vertexOffsets[shard];
+            }
+        }
+    });
+
+    if (missingNormals) {
+        // area weighted face normals for the vertices the file gave none
+        std::vector<float> accumulated(mesh.vertices.size() * 3, 0.0f);
+        for (size_t i = 0; i < mesh.indices.size(); i += 3) {
+            const float* a = mesh.vertices[mesh.indices[i]].position;
+            const float* b = mesh.vertices[mesh.indices[i + 1]].position;
+            const float* c = mesh.vertices[mesh.indices[i + 2]].position;
+            float e1[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+            float e2[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+            float normal[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+            for (size_t k = 0; k < 3; k++) {
+                for (size_t axis = 0; axis < 3; axis++) {
+                    accumulated[(size_t)mesh.indices[i + k] * 3 + axis] += normal[axis];
+                }
+            }
+        }
+        for (size_t v = 0; v < mesh.vertices.size(); v++) {
+            MeshVertex& vertex = mesh.vertices[v];
+            if (vertex.normal[0] != 0.0f || vertex.normal[1] != 0.0f || vertex.normal[2] != 0.0f) continue;
+            float* normal = &accumulated[v * 3];
+            float length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+            for (size_t axis = 0; axis < 3; axis++) {
+                vertex.normal[axis] = length > 0.0f ? normal[axis] / length : 0.0f;
+            }
+        }
+    }
+
+    stats.vertices = mesh.vertices.size();
+    stats.dedupMilliseconds = millisecondsSince(dedupStart);
+    auto optimizeStart = Clock::now();
+
+    uint32_t vertexCount = static_cast<uint32_t>(mesh.vertices.size());
+    stats.acmrBefore = computeAcmr(mesh.indices, vertexCount, CACHE_SIZE);
+    std::vector<uint32_t> clusters;
+    optimizeVertexCache(mesh.indices, vertexCount, CACHE_SIZE, &clusters);
+    stats.acmrVertexCache = computeAcmr(mesh.indices, vertexCount, CACHE_SIZE);
+    optimizeOverdraw(mesh.vertices, mesh.indices, clusters);
+    stats.acmrOverdraw = computeAcmr(mesh.indices, vertexCount, CACHE_SIZE);
+    optimizeVertexFetch(mesh);
+
+    stats.optimizeMilliseconds = millisecondsSince(optimizeStart);
+    return mesh;
+}
+
+void MeshLoader::printStats(std::ostream& out) const
+{
+    double megabytes = stats.fileBytes / (1024.0 * 1024.0);
+    out << "mesh import: " << megabytes << " MB parsed in " << stats.parseMilliseconds << " ms ("
+        << megabytes / (stats.parseMilliseconds / 1000.0) << " MB/s), " << stats.triangles << " triangles" << std::endl;
+    out << "mesh import: " << stats.corners << " corners deduplicated to " << stats.vertices << " vertices in " << stats.dedupMilliseconds
+        << " ms, optimized in " << stats.optimizeMilliseconds << " ms, "
+        << stats.triangles / ((stats.parseMilliseconds + stats.dedupMilliseconds + stats.optimizeMilliseconds) / 1000.0) / 1e6 << " M tris/s overall" << std::endl;
+    out << "mesh import: ACMR " << stats.acmrBefore << " as loaded, " << stats.acmrVertexCache << " after vertex cache, "
+        << stats.acmrOverdraw << " after overdraw (" << CACHE_SIZE << " entry FIFO)" << std::endl;
+}
+
+void MeshLoader::optimizeVertexCache(std::vector<uint32_t>& indices, uint32_t vertexCount, uint32_t cacheSize, std::vector<uint32_t>* clusters)
+{
+    uint32_t triangleCount = static_cast<uint32_t>(indices.size() / 3);
+    if (clusters) clusters->clear();
+    if (triangleCount == 0) return;
+
+    // vertex to triangle adjacency, CSR style
+    std::vector<uint32_t> liveTriangles(vertexCount, 0);
+    for (uint32_t index : indices) liveTriangles[index]++;
+
+    std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+    for (uint32_t v = 0; v < vertexCount; v++) {
+        adjacencyOffsets[v + 1] = adjacencyOffsets[v] + liveTriangles[v];
+    }
+    std::vector<uint32_t> adjacency(indices.size());
+    std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+    for (uint32_t t = 0; t < triangleCount; t++) {
+        for (uint32_t k = 0; k < 3; k++) {
+            adjacency[fill[indices[t * 3 + k]]++] = t;
+        }
+    }
+
+    std::vector<uint32_t> cacheTime(vertexCount, 0);
+    std::vector<uint8_t> emitted(triangleCount, 0);
+    std::vector<uint32_t> deadEnds;
+    std::vector<uint32_t> candidates;
+    std::vector<uint32_t> output;
+    output.reserve(indices.size());
+
+    uint32_t time = cacheSize + 1;
+    uint32_t cursor = 0;
+    bool clusterStart = true;
+    int64_t fan = indices[0];
+
+    while (fan >= 0) {
+        candidates.clear();
+        for (uint32_t a = adjacencyOffsets[fan]; a < adjacencyOffsets[fan + 1]; a++) {
+            uint32_t t = adjacency[a];
+            if (emitted[t]) continue;
+
+            if (clusterStart && clusters) clusters->push_back(static_cast<uint32_t>(output.size() / 3));
+            clusterStart = false;
+
+            for (uint32_t k = 0; k < 3; k++) {
+                uint32_t v = indices[t * 3 + k];
+                output.push_back(v);
+                deadEnds.push_back(v);
+                candidates.push_back(v);
+                liveTriangles[v]--;
+                if (time - cacheTime[v] > cacheSize) {
+                    cacheTime[v] = time++;
+                }
+            }
+            emitted[t] = 1;
+        }
+
+        // next fan: the oldest vertex that is still cached after its remaining triangles went through
+        fan = -1;
+        uint32_t bestPriority = 0;
+        for (uint32_t v : candidates) {
+            if (liveTriangles[v] == 0) continue;
+            uint32_t priority = 0;
+            if (time - cacheTime[v] + 2 * liveTriangles[v] <= cacheSize) {
+                priority = time - cacheTime[v];
+            }
+            if (priority > bestPriority) {
+                bestPriority = priority;
+                fan = v;
+            }
+        }
+
+        if (fan < 0) {
+            // dead end: the most recent vertex with work left, otherwise the next unfinished vertex in input order
+            clusterStart = true;
+            while (!deadEnds.empty() && fan < 0) {
+                uint32_t v = deadEnds.back();
+                deadEnds.pop_back();
+                if (liveTriangles[v] > 0) fan = v;
+            }
+            while (fan < 0 && cursor < vertexCount) {
+                if (liveTriangles[cursor] > 0) fan = cursor;
+                cursor++;
+            }
+        }
+    }
+
+    indices.swap(output);
+}
+
+void MeshLoader::optimizeOverdraw(const std::vector<MeshVertex>& vertices, std::vector<uint32_t>& indices, const std::vector<uint32_t>& clusters)
+{
+    uint32_t triangleCount = static_cast<uint32_t>(indices.size() / 3);
+    if (clusters.size() < 2) return;
+
+    struct Cluster {
+        uint32_t begin;
+        uint32_t end;
+        float sortKey;
+    };
+    std::vector<Cluster> sorted(clusters.size());
+
+    double meshCentroid[3] = {};
+    double meshArea = 0.0;
+    std::vector<double> clusterCentroids(clusters.size() * 3, 0.0);
+    std::vector<double> clusterNormals(clusters.size() * 3, 0.0);
+    std::vector<double> clusterAreas(clusters.size(), 0.0);
+
+    for (size_t c = 0; c < clusters.size(); c++) {
+        sorted[c].begin = clusters[c];
+        sorted[c].end = c + 1 < clusters.size() ? clusters[c + 1] : triangleCount;
+
+        for (uint32_t t = sorted[c].begin; t < sorted[c].end; t++) {
+            const float* a = vertices[indices[t * 3]].position;
+            const float* b = vertices[indices[t * 3 + 1]].position;
+            const float* p = vertices[indices[t * 3 + 2]].position;
+            double e1[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+            double e2[3] = { p[0] - a[0], p[1] - a[1], p[2] - a[2] };
+            double normal[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+            double area = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+
+            for (size_t axis = 0; axis < 3; axis++) {
+                double centroid = (a[axis] + b[axis] + p[axis]) / 3.0;
+                clusterCentroids[c * 3 + axis] += centroid * area;
+                clusterNormals[c * 3 + axis] += normal[axis];
+                meshCentroid[axis] += centroid * area;
+            }
+            clusterAreas[c] += area;
+            meshArea += area;
+        }
+    }
+    if (meshArea <= 0.0) return;
+    for (double& axis : meshCentroid) axis /= meshArea;
+
+    // clusters facing outwards from the centre occlude the rest from most directions, draw them first
+    for (size_t c = 0; c < clusters.size(); c++) {
+        double* normal = &clusterNormals[c * 3];
+        double length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+        double dot = 0.0;
+        if (length > 0.0 && clusterAreas[c] > 0.0) {
+            for (size_t axis = 0; axis < 3; axis++) {
+                dot += (clusterCentroids[c * 3 + axis] / clusterAreas[c] - meshCentroid[axis]) * normal[axis] / length;
+            }
+        }
+        sorted[c].sortKey = static_cast<float>(dot);
+    }
+    std::stable_sort(sorted.begin(), sorted.end(), [](const Cluster& a, const Cluster& b) { return a.sortKey > b.sortKey; });
+
+    std::vector<uint32_t> output;
+    output.reserve(indices.size());
+    for (const Cluster& cluster : sorted) {
+        output.insert(output.end(), indices.begin() + (size_t)cluster.begin * 3, indices.begin() + (size_t)cluster.end * 3);
+    }
+    indices.swap(output);
+}
+
+void MeshLoader::optimizeVertexFetch(Mesh& mesh)
+{
+    std::vector<uint32_t> remap(mesh.vertices.size(), NO_INDEX);
+    std::vector<MeshVertex> vertices;
+    vertices.reserve(mesh.vertices.size());
+
+    for (uint32_t& index : mesh.indices) {
+        if (remap[index] == NO_INDEX) {
+            remap[index] = static_cast<uint32_t>(vertices.size());
+            vertices.push_back(mesh.vertices[index]);
+        }
+        index = remap[index];
+    }
+    mesh.vertices.swap(vertices);
+}
+
+double MeshLoader::computeAcmr(const std::vector<uint32_t>& indices, uint32_t vertexCount, uint32_t cacheSize)
+{
+    if (indices.empty()) return 0.0;
+
+    std::vector<uint32_t> cacheTime(vertexCount, 0);
+    uint32_t time = cacheSize + 1;
+    uint64_t misses = 0;
+    for (uint32_t index : indices) {
+        if (time - cacheTime[index] > cacheSize) {
+            cacheTime[index] = time++;
+            misses++;
+        }
+    }
+    return (double)misses / (indices.size() / 3);
+}
+
+
+std::vector<FlatVertex> MeshLoader::flatten(Mesh& mesh)
+{
+    float low[2] = { FLT_MAX, FLT_MAX };
+    float high[2] = { -FLT_MAX, -FLT_MAX };
+    for (const MeshVertex& vertex : mesh.vertices) {
+        for (size_t axis = 0; axis < 2; axis++) {
+            low[axis] = std::min(low[axis], vertex.position[axis]);
+            high[axis] = std::max(high[axis], vertex.position[axis]);
+        }
+    }
+    float center[2] = { (low[0] + high[0]) * 0.5f, (low[1] + high[1]) * 0.5f };
+    float scale = 1.0f / std::max(std::max(high[0] - low[0], high[1] - low[1]), 1e-6f);
+
+    std::vector<FlatVertex> vertices(mesh.vertices.size());
+    for (size_t i = 0; i < mesh.vertices.size(); i++) {
+        const MeshVertex& source = mesh.vertices[i];
+        // OBJ is y up, the clip space y of this renderer points down
+        vertices[i].position[0] = (source.position[0] - center[0]) * scale;
+        vertices[i].position[1] = (center[1] - source.position[1]) * scale;
+        for (size_t channel = 0; channel < 3; channel++) {
+            vertices[i].color[channel] = source.normal[channel] * 0.5f + 0.5f;
+        }
+    }
+    for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3) {
+        std::swap(mesh.indices[i + 1], mesh.indices[i + 2]);
+    }
+    return vertices;
+}
@@ -0,0 +1,84 @@
+#pragma once
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "JobSystem.h"
+
+struct MeshVertex {
+	float position[3];
+	float normal[3];
+	float uv[2];
+};
+
+/// <summary>
+/// The renderer's 2D vertex layout, what the asset packer stores as meshes/NAME.vertices
+/// </summary>
+struct FlatVertex {
+	float position[2];
+	float color[3];
+};
+
+struct Mesh {
+	std::vector<MeshVertex> vertices;
+	std::vector<uint32_t> indices; // triangle list
+};
+
+struct MeshImportStats {
+	uint64_t fileBytes = 0;
+	uint64_t triangles = 0;
+	uint64_t corners = 0; // position/uv/normal triples before deduplication
+	uint64_t vertices = 0;
+	double parseMilliseconds = 0.0;
+	double dedupMilliseconds = 0.0;
+	double optimizeMilliseconds = 0.0;
+	double acmrBefore = 0.0; // average cache miss ratio, transformed vertices per triangle
+	double acmrVertexCache = 0.0;
+	double acmrOverdraw = 0.0;
+};
+
+/// <summary>
+/// Wavefront OBJ import. The file is split into line aligned chunks that are parsed on every thread of the job system,
+/// vertices are deduplicated in parallel by partitioning the index triples into hash shards.
+/// The result is reordered for the post-transform vertex cache (Tipsify), its clusters sorted against overdraw
+/// and its vertices renumbered in first-use order for fetch locality.
+/// </summary>
+class MeshLoader
+{
+public:
+	static constexpr uint32_t CACHE_SIZE = 16;
+
+	explicit MeshLoader(JobSystem& jobs) : jobs(jobs) {}
+
+	Mesh loadObj(const std::string& path);
+	const MeshImportStats& getStats() const { return stats; }
+	void printStats(std::ostream& out) const;
+
+	/// <summary>
+	/// Tipsify (Sander, Nehab and Barczak 2007). When clusters is given it receives the first triangle of every
+	/// run that started at a dead end, the boundaries optimizeOverdraw() may reorder at.
+	/// </summary>
+	static void optimizeVertexCache(std::vector<uint32_t>& indices, uint32_t vertexCount, uint32_t cacheSize, std::vector<uint32_t>* clusters);
+	/// <summary>
+	/// Sorts the clusters so the ones facing away from the mesh centre are drawn first, triangles inside a cluster keep their order
+	/// </summary>
+	static void optimizeOverdraw(const std::vector<MeshVertex>& vertices, std::vector<uint32_t>& indices, const std::vector<uint32_t>& clusters);
+	/// <summary>
+	/// Renumbers vertices in the order the index buffer first uses them, unused vertices are dropped
+	/// </summary>
+	static void optimizeVertexFetch(Mesh& mesh);
+	/// <summary>
+	/// Vertex shader invocations per triangle with a FIFO cache of cacheSize entries, 0.5 is ideal and 3 the worst
+	/// </summary>
+	static double computeAcmr(const std::vector<uint32_t>& indices, uint32_t vertexCount, uint32_t cacheSize);
+	/// <summary>
+	/// x/y scaled into the unit square around the origin and flipped to clip space y down, the normal as colour.
+	/// The flip mirrors the mesh, so the triangles' winding is reversed to keep OBJ's counter-clockwise faces in front.
+	/// </summary>
+	static std::vector<FlatVertex> flatten(Mesh& mesh);
+
+private:
+	JobSystem& jobs;
+	MeshImportStats stats;
+};
@@ -0,0 +1,175 @@
+#include "PipelineCache.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+namespace {
+    const uint32_t CACHE_FILE_MAGIC = 0x43504B56; // "VKPC"
+    const uint32_t CACHE_FILE_VERSION = 1;
+
+    struct CacheFileHeader {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t vendorID;
+        uint32_t deviceID;
+        uint32_t driverVersion;
+        uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+        uint64_t dataSize;
+        uint64_t dataHash;
+    };
+}
+
+void PipelineCache::create(vk::Device device, const vk::PhysicalDeviceProperties& properties, const std::string& path)
+{
+    this->device = device;
+    this->properties = properties;
+    this->path = path;
+
+    std::vector<uint8_t> initialData = load();
+
+    auto createInfo = vk::PipelineCacheCreateInfo();
+    createInfo.initialDataSize = initialData.size();
+    createInfo.pInitialData = initialData.data();
+
+    try {
+        cache = device.createPipelineCache(createInfo);
+        warm = !initialData.empty();
+    }
+    catch (const vk::SystemError& e) {
+        // the driver rejected the blob despite the header matching, start cold
+        std::cout << "pipeline cache: rejected by driver (" << e.what() << ")" << std::endl;
+        createInfo.initialDataSize = 0;
+        createInfo.pInitialData = nullptr;
+        cache = device.createPipelineCache(createInfo);
+        warm = false;
+    }
+}
+
+/// <summary>
+/// Reads and validates the cache file, returns empty data when the file is missing, corrupt or stale
+/// </summary>
+std::vector<uint8_t> PipelineCache::load()
+{
+    if (path.empty()) return {};
+
+    std::ifstream file(path, std::ios::ate | std::ios::binary);
+    if (!file.is_open()) return {};
+
+    size_t fileSize = (size_t)file.tellg();
+    if (fileSize < sizeof(CacheFileHeader)) {
+        std::cout << "pipeline cache: " << path << " is truncated, ignoring" << std::endl;
+        return {};
+    }
+
+    CacheFileHeader header;
+    file.seekg(0);
+    file.read(reinterpret_cast<char*>(&header), sizeof(header));
+
+    if (header.magic != CACHE_FILE_MAGIC || header.version != CACHE_FILE_VERSION) {
+        std::cout << "pipeline cache: " << path << " has an unknown format, ignoring" << std::endl;
+        return {};
+    }
+    if (header.vendorID != properties.vendorID || header.deviceID != properties.deviceID ||
+        header.driverVersion != properties.driverVersion ||
+        memcmp(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE) != 0) {
+        std::cout << "pipeline cache: " << path << " was written by another device or driver, ignoring" << std::endl;
+        return {};
+    }
+    if (header.dataSize != fileSize - sizeof(CacheFileHeader)) {
+        std::cout << "pipeline cache: " << path << " has a size mismatch, ignoring" << std::endl;
+        return {};
+    }
+
+    std::vector<uint8_t> data((size_t)header.dataSize);
+    file.read(reinterpret_cast<char*>(data.data()), data.size());
+
+    if (!file || hash(data.data(), data.size()) != header.dataHash) {
+        std::cout << "pipeline cache: " << path << " is corrupt, ignoring" << std::endl;
+        return {};
+    }
+    if (!validateDriverHeader(data)) {
+        std::cout << "pipeline cache: " << path << " has a mismatching driver header, ignoring" << std::endl;
+        return {};
+    }
+
+    return data;
+}
+
+/// <summary>
+/// Checks the VkPipelineCacheHeaderVersionOne the driver put at the start of the blob
+/// </summary>
+bool PipelineCache::validateDriverHeader(const std::vector<uint8_t>& data) const
+{
+    const size_t headerSize = 16 + VK_UUID_SIZE;
+    if (data.size() < headerSize) return false;
+
+    uint32_t fields[4]; // headerSize, headerVersion, vendorID, deviceID
+    memcpy(fields, data.data(), sizeof(fields));
+
+    return fields[0] >= headerSize && fields[0] <= data.size() &&
+        fields[1] == static_cast<uint32_t>(vk::PipelineCacheHeaderVersion::eOne) &&
+        fields[2] == properties.vendorID &&
+        fields[3] == properties.deviceID &&
+        memcmp(data.data() + 16, properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
+
+void PipelineCache::save()
+{
+    if (!cache || path.empty()) return;
+
+    std::vector<uint8_t> data = device.getPipelineCacheData(cache);
+
+    CacheFileHeader header = {};
+    header.magic = CACHE_FILE_MAGIC;
+    header.version = CACHE_FILE_VERSION;
+    header.vendorID = properties.vendorID;
+    header.deviceID = properties.deviceID;
+    header.driverVersion = properties.driverVersion;
+    memcpy(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE);
+    header.dataSize = data.size();
+    header.dataHash = hash(data.data(), data.size());
+
+    // write to a temporary file first so a crash mid-write never leaves a half written cache behind
+    std::string tempPath = path + ".tmp";
+    {
+        std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+        if (!file.is_open()) {
+            std::cout << "pipeline cache: failed to open " << tempPath << " for writing" << std::endl;
+            return;
+        }
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char*>(data.data()), data.size());
+        if (!file) {
+            std::cout << "pipeline cache: failed to write " << tempPath << std::endl;
+            return;
+        }
+    }
+
+    std::remove(path.c_str());
+    if (std::rename(tempPath.c_str(), path.c_str()) != 0) {
+        std::cout << "pipeline cache: failed to replace " << path << std::endl;
+    }
+}
+
+void PipelineCache::destroy()
+{
+    if (cache) {
+        device.destroyPipelineCache(cache);
+        cache = nullptr;
+    }
+}
+
+/// <summary>
+/// FNV-1a 64
+/// </summary>
+uint64_t PipelineCache::hash(const uint8_t* data, size_t size)
+{
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= data[i];
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
@@ -0,0 +1,34 @@
+#pragma once
+#include <string>
+#include <vector>
+
+#include <vulkan/vulkan.hpp>
+
+/// <summary>
+/// vk::PipelineCache backed by a file on disk. The file carries its own header
+/// (vendor/device/driver version, pipelineCacheUUID, size and hash of the blob),
+/// anything that does not match the current device is discarded and the cache starts cold.
+/// </summary>
+class PipelineCache
+{
+public:
+	void create(vk::Device device, const vk::PhysicalDeviceProperties& properties, const std::string& path);
+	void save();
+	void destroy();
+	vk::PipelineCache get() const { return cache; }
+	/// <summary>
+	/// True when valid data was loaded from disk
+	/// </summary>
+	bool isWarm() const { return warm; }
+
+private:
+	vk::Device device;
+	vk::PipelineCache cache;
+	vk::PhysicalDeviceProperties properties;
+	std::string path;
+	bool warm = false;
+
+	std::vector<uint8_t> load();
+	bool validateDriverHeader(const std::vector<uint8_t>& data) const;
+	static uint64_t hash(const uint8_t* data, size_t size);
+};
@@ -0,0 +1,394 @@
+#include "PipelineLibrary.h"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <exception>
+#include <fstream>
+#include <functional>
+#include <future>
+#include <stdexcept>
+
+namespace {
+    /// <summary>
+    /// FNV-1a 64, fed field by field
+    /// </summary>
+    struct Hasher {
+        uint64_t value = 0xcbf29ce484222325ull;
+
+        void add(const void* data, size_t size) {
+            const uint8_t* bytes = static_cast<const uint8_t*>(data);
+            for (size_t i = 0; i < size; i++) {
+                value ^= bytes[i];
+                value *= 0x100000001b3ull;
+            }
+        }
+
+        template<typename T>
+        void add(const T& field) {
+            add(&field, sizeof(field));
+        }
+
+        void add(const std::string& text) {
+            add(text.size());
+            add(text.data(), text.size());
+        }
+
+        template<typename T>
+        void add(const std::vector<T>& fields) {
+            add(fields.size());
+            for (const T& field : fields) {
+                add(field);
+            }
+        }
+    };
+
+    /// <summary>
+    /// Runs job(begin, end) over threadCount slices of [0, count), the first slice on the calling thread.
+    /// Returns once every slice has finished and rethrows the first failure.
+    /// </summary>
+    void runSliced(size_t count, uint32_t threadCount, const std::function<void(size_t, size_t)>& job) {
+        std::vector<std::future<void>> slices;
+        for (uint32_t slice = 1; slice < threadCount; slice++) {
+            slices.push_back(std::async(std::launch::async, job, count * slice / threadCount, count * (slice + 1) / threadCount));
+        }
+
+        std::exception_ptr failure;
+        try {
+            job(0, count / threadCount);
+        }
+        catch (...) {
+            failure = std::current_exception();
+        }
+        for (auto& slice : slices) {
+            try {
+                slice.get();
+            }
+            catch (...) {
+                if (!failure) failure = std::current_exception();
+            }
+        }
+        if (failure) std::rethrow_exception(failure);
+    }
+
+    std::vector<char> readFile(const std::string& filename) {
+        std::ifstream file(filename, std::ios::ate | std::ios::binary);
+
+        if (!file.is_open()) {
+            throw std::runtime_error("failed to open file!");
+        }
+
+        size_t fileSize = (size_t)file.tellg();
+        std::vector<char> buffer(fileSize);
+
+        file.seekg(0);
+        file.read(buffer.data(), fileSize);
+
+        return buffer;
+    }
+
+    /// <summary>
+    /// The create info structs of one pipeline, pointing at each other. Kept in a vector sized up front
+    /// so the pointers stay valid until vkCreateGraphicsPipelines has run.
+    /// </summary>
+    struct PipelineState {
+        std::vector<vk::SpecializationMapEntry> vertexEntries;
+        std::vector<vk::SpecializationMapEntry> fragmentEntries;
+        vk::SpecializationInfo vertexSpecialization;
+        vk::SpecializationInfo fragmentSpecialization;
+        std::array<vk::PipelineShaderStageCreateInfo, 2> stages;
+        vk::PipelineVertexInputStateCreateInfo vertexInput;
+        vk::PipelineInputAssemblyStateCreateInfo inputAssembly;
+        vk::PipelineRasterizationStateCreateInfo rasterizer;
+        vk::PipelineMultisampleStateCreateInfo multisampling;
+        vk::PipelineColorBlendAttachmentState colorBlendAttachment;
+        vk::PipelineColorBlendStateCreateInfo colorBlending;
+    };
+
+    /// <summary>
+    /// Map entries for constants whose values are read straight out of the SpecializationConstant array
+    /// </summary>
+    void specialize(const std::vector<SpecializationConstant>& constants, std::vector<vk::SpecializationMapEntry>& entries, vk::SpecializationInfo& info) {
+        for (size_t i = 0; i < constants.size(); i++) {
+            entries.push_back(vk::SpecializationMapEntry(constants[i].id,
+                static_cast<uint32_t>(i * sizeof(SpecializationConstant) + offsetof(SpecializationConstant, value)), sizeof(uint32_t)));
+        }
+        info.mapEntryCount = static_cast<uint32_t>(entries.size());
+        info.pMapEntries = entries.data();
+        info.dataSize = constants.size() * sizeof(SpecializationConstant);
+        info.pData = constants.data();
+    }
+
+    void setBlend(BlendMode blend, vk::PipelineColorBlendAttachmentState& attachment) {
+        attachment.colorWriteMask = vk::ColorComponentFlagBits::eR | vk::ColorComponentFlagBits::eG | vk::ColorComponentFlagBits::eB | vk::ColorComponentFlagBits::eA;
+        attachment.blendEnable = blend != BlendMode::Opaque;
+        attachment.colorBlendOp = vk::BlendOp::eAdd;
+        attachment.alphaBlendOp = vk::BlendOp::eAdd;
+        attachment.srcAlphaBlendFactor = vk::BlendFactor::eOne;
+        attachment.dstAlphaBlendFactor = vk::BlendFactor::eZero;
+
+        if (blend == BlendMode::Alpha) {
+            attachment.srcColorBlendFactor = vk::BlendFactor::eSrcAlpha;
+            attachment.dstColorBlendFactor = vk::BlendFactor::eOneMinusSrcAlpha;
+        }
+        else if (blend == BlendMode::Additive) {
+            attachment.srcColorBlendFactor = vk::BlendFactor::eSrcAlpha;
+            attachment.dstColorBlendFactor = vk::BlendFactor::eOne;
+        }
+    }
+}
+
+uint64_t PipelineDesc::hash() const
+{
+    Hasher hasher;
+    hasher.add(vertexShader);
+    hasher.add(fragmentShader);
+    hasher.add(vertexConstants);
+    hasher.add(fragmentConstants);
+    hasher.add(bindings.size());
+    for (const auto& binding : bindings) {
+        hasher.add(binding.binding);
+        hasher.add(binding.stride);
+        hasher.add(binding.inputRate);
+    }
+    hasher.add(attributes.size());
+    for (const auto& attribute : attributes) {
+        hasher.add(attribute.location);
+        hasher.add(attribute.binding);
+        hasher.add(attribute.format);
+        hasher.add(attribute.offset);
+    }
+    hasher.add(topology);
+    hasher.add(polygonMode);
+    hasher.add(static_cast<VkCullModeFlags>(cullMode));
+    hasher.add(frontFace);
+    hasher.add(blend);
+    hasher.add(static_cast<VkPipelineLayout>(layout));
+    hasher.add(subpass);
+    hasher.add(colorFormats);
+    hasher.add(samples);
+    return hasher.value;
+}
+
+bool PipelineDesc::operator==(const PipelineDesc& other) const
+{
+    return vertexShader == other.vertexShader && fragmentShader == other.fragmentShader &&
+        vertexConstants == other.vertexConstants && fragmentConstants == other.fragmentConstants &&
+        bindings == other.bindings && attributes == other.attributes && topology == other.topology &&
+        polygonMode == other.polygonMode && cullMode == other.cullMode && frontFace == other.frontFace && blend == other.blend &&
+        layout == other.layout && subpass == other.subpass && colorFormats == other.colorFormats && samples == other.samples;
+}
+
+void PipelineLibrary::create(vk::Device device, vk::PipelineCache cache)
+{
+    this->device = device;
+    this->cache = cache;
+}
+
+void PipelineLibrary::destroy()
+{
+    if (!device) return;
+
+    for (auto& entry : pipelines) {
+        device.destroyPipeline(entry.second);
+    }
+    pipelines.clear();
+    pending.clear();
+
+    for (auto& module : shaderModules) {
+        device.destroyShaderModule(module.second);
+    }
+    shaderModules.clear();
+    device = nullptr;
+}
+
+vk::Pipeline PipelineLibrary::get(const PipelineDesc& desc)
+{
+    auto found = pipelines.find(desc);
+    if (found == pipelines.end()) {
+        request(desc);
+        build();
+        return pipelines.find(desc)->second;
+    }
+
+    if (!found->second) {
+        build();
+    }
+    return found->second;
+}
+
+void PipelineLibrary::request(const PipelineDesc& desc)
+{
+    auto inserted = pipelines.emplace(desc, nullptr);
+    if (!inserted.second) {
+        deduplicated++;
+        return;
+    }
+    pending.push_back(&*inserted.first);
+}
+
+uint32_t PipelineLibrary::build(uint32_t threadCount)
+{
+    if (pending.empty()) return 0;
+    threadCount = std::max(1u, std::min(threadCount, static_cast<uint32_t>(pending.size())));
+    loadShaderModules(threadCount);
+
+    // viewport and scissor are set while recording, a resize never touches the pipelines
+    auto viewportState = vk::PipelineViewportStateCreateInfo();
+    viewportState.viewportCount = 1;
+    viewportState.scissorCount = 1;
+
+    vk::DynamicState dynamicStates[] = { vk::DynamicState::eViewport, vk::DynamicState::eScissor };
+    auto dynamicState = vk::PipelineDynamicStateCreateInfo();
+    dynamicState.dynamicStateCount = 2;
+    dynamicState.pDynamicStates = dynamicStates;
+
+    std::vector<PipelineState> states(pending.size());
+    std::vector<vk::GraphicsPipelineCreateInfo> pipelineInfos(pending.size());
+
+    for (size_t i = 0; i < pending.size(); i++) {
+        const PipelineDesc& desc = pending[i]->first;
+        PipelineState& state = states[i];
+
+        specialize(desc.vertexConstants, state.vertexEntries, state.vertexSpecialization);
+        specialize(desc.fragmentConstants, state.fragmentEntries, state.fragmentSpecialization);
+
+        state.stages[0].stage = vk::ShaderStageFlagBits::eVertex;
+        state.stages[0].module = getShaderModule(desc.vertexShader);
+        state.stages[0].pName = "main";
+        state.stages[0].pSpecializationInfo = desc.vertexConstants.empty() ? nullptr : &state.vertexSpecialization;
+
+        state.stages[1].stage = vk::ShaderStageFlagBits::eFragment;
+        state.stages[1].module = getShaderModule(desc.fragmentShader);
+        state.stages[1].pName = "main";
+        state.stages[1].pSpecializationInfo = desc.fragmentConstants.empty() ? nullptr : &state.fragmentSpecialization;
+
+        state.vertexInput.vertexBindingDescriptionCount = static_cast<uint32_t>(desc.bindings.size());
+        state.vertexInput.pVertexBindingDescriptions = desc.bindings.data();
+        state.vertexInput.vertexAttributeDescriptionCount = static_cast<uint32_t>(desc.attributes.size());
+        state.vertexInput.pVertexAttributeDescriptions = desc.attributes.data();
+
+        state.inputAssembly.topology = desc.topology;
+        state.inputAssembly.primitiveRestartEnable = VK_FALSE;
+
+        state.rasterizer.depthClampEnable = VK_FALSE;
+        state.rasterizer.rasterizerDiscardEnable = VK_FALSE;
+        state.rasterizer.polygonMode = desc.polygonMode;
+        state.rasterizer.lineWidth = 1.0f;
+        state.rasterizer.cullMode = desc.cullMode;
+        state.rasterizer.frontFace = desc.frontFace;
+        state.rasterizer.depthBiasEnable = VK_FALSE;
+
+        state.multisampling.sampleShadingEnable = VK_FALSE;
+        state.multisampling.rasterizationSamples = desc.samples;
+
+        setBlend(desc.blend, state.colorBlendAttachment);
+        state.colorBlending.logicOpEnable = VK_FALSE;
+        state.colorBlending.attachmentCount = 1;
+        state.colorBlending.pAttachments = &state.colorBlendAttachment;
+
+        auto& pipelineInfo = pipelineInfos[i];
+        pipelineInfo.stageCount = static_cast<uint32_t>(state.stages.size());
+        pipelineInfo.pStages = state.stages.data();
+        pipelineInfo.pVertexInputState = &state.vertexInput;
+        pipelineInfo.pInputAssemblyState = &state.inputAssembly;
+        pipelineInfo.pViewportState = &viewportState;
+        pipelineInfo.pRasterizationState = &state.rasterizer;
+        pipelineInfo.pMultisampleState = &state.multisampling;
+        pipelineInfo.pColorBlendState = &state.colorBlending;
+        pipelineInfo.pDynamicState = &dynamicState;
+        pipelineInfo.layout = desc.layout;
+        pipelineInfo.renderPass = desc.renderPass;
+        pipelineInfo.subpass = desc.subpass;
+    }
+
+    // one call per thread, drivers tend to compile the pipelines of a single call one after another.
+    // The cache synchronizes internally, the slices share its lookups.
+    std::vector<vk::Pipeline> created(pending.size());
+    try {
+        runSliced(pending.size(), threadCount, [&](size_t begin, size_t end) {
+            auto result = device.createGraphicsPipelines(cache, vk::ArrayProxy<const vk::GraphicsPipelineCreateInfo>(static_cast<uint32_t>(end - begin), pipelineInfos.data() + begin));
+            std::copy(result.value.begin(), result.value.end(), created.begin() + begin);
+            if (result.result != vk::Result::eSuccess) {
+                throw std::runtime_error("failed to create graphics pipelines!");
+            }
+        });
+    }
+    catch (...) {
+        // the requests stay pending, a later build() retries them
+        for (vk::Pipeline pipeline : created) {
+            device.destroyPipeline(pipeline);
+        }
+        throw;
+    }
+
+    for (size_t i = 0; i < pending.size(); i++) {
+        pending[i]->second = created[i];
+    }
+    uint32_t count = static_cast<uint32_t>(pending.size());
+    pending.clear();
+    return count;
+}
+
+/// <summary>
+/// Reads and creates the modules the pending pipelines still miss, spread over threadCount threads
+/// </summary>
+void PipelineLibrary::loadShaderModules(uint32_t threadCount)
+{
+    std::vector<std::string> missing;
+    for (const auto* entry : pending) {
+        for (const std::string* path : { &entry->first.vertexShader, &entry->first.fragmentShader }) {
+            if (shaderModules.count(*path) == 0 && std::find(missing.begin(), missing.end(), *path) == missing.end()) {
+                missing.push_back(*path);
+            }
+        }
+    }
+    if (missing.empty()) return;
+
+    std::vector<vk::ShaderModule> modules(missing.size());
+    try {
+        runSliced(missing.size(), std::min(threadCount, static_cast<uint32_t>(missing.size())), [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                modules[i] = createShaderModule(missing[i]);
+            }
+        });
+    }
+    catch (...) {
+        for (vk::ShaderModule module : modules) {
+            device.destroyShaderModule(module);
+        }
+        throw;
+    }
+
+    for (size_t i = 0; i < missing.size(); i++) {
+        shaderModules.emplace(missing[i], modules[i]);
+    }
+}
+
+vk::ShaderModule PipelineLibrary::getShaderModule(const std::string& path)
+{
+    auto found = shaderModules.find(path);
+    if (found != shaderModules.end()) return found->second;
+
+    vk::ShaderModule module = createShaderModule(path);
+    shaderModules.emplace(path, module);
+    return module;
+}
+
+vk::ShaderModule PipelineLibrary::createShaderModule(const std::string& path) const
+{
+    AssetView packed = assets ? assets->find(path) : AssetView();
+    std::vector<char> code;
+    auto createInfo = vk::ShaderModuleCreateInfo();
+    if (packed) {
+        createInfo.codeSize = packed.size;
+        createInfo.pCode = static_cast<const uint32_t*>(packed.data);
+    }
+    else {
+        code = readFile(path);
+        createInfo.codeSize = code.size();
+        createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
+    }
+
+    return device.createShaderModule(createInfo);
+}
@@ -0,0 +1,103 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <vulkan/vulkan.hpp>
+
+#include "AssetPack.h"
+
+enum class BlendMode : uint32_t {
+	Opaque,
+	Alpha,
+	Additive,
+};
+
+/// <summary>
+/// One SPIR-V specialization constant, value holds the raw 32 bits (bit cast floats)
+/// </summary>
+struct SpecializationConstant {
+	uint32_t id;
+	uint32_t value;
+
+	bool operator==(const SpecializationConstant& other) const { return id == other.id && value == other.value; }
+};
+
+/// <summary>
+/// Everything that makes two graphics pipelines different. Viewport and scissor are always dynamic.
+/// The render pass takes part only through its compatibility (attachment formats, sample count, subpass),
+/// the handle is just what the pipeline gets created against.
+/// </summary>
+struct PipelineDesc {
+	std::string vertexShader;
+	std::string fragmentShader;
+	std::vector<SpecializationConstant> vertexConstants;
+	std::vector<SpecializationConstant> fragmentConstants;
+
+	std::vector<vk::VertexInputBindingDescription> bindings;
+	std::vector<vk::VertexInputAttributeDescription> attributes;
+	vk::PrimitiveTopology topology = vk::PrimitiveTopology::eTriangleList;
+
+	vk::PolygonMode polygonMode = vk::PolygonMode::eFill;
+	vk::CullModeFlags cullMode = vk::CullModeFlagBits::eBack;
+	vk::FrontFace frontFace = vk::FrontFace::eClockwise;
+	BlendMode blend = BlendMode::Opaque;
+
+	vk::PipelineLayout layout;
+	vk::RenderPass renderPass;
+	uint32_t subpass = 0;
+	std::vector<vk::Format> colorFormats;
+	vk::SampleCountFlagBits samples = vk::SampleCountFlagBits::e1;
+
+	uint64_t hash() const;
+	bool operator==(const PipelineDesc& other) const;
+};
+
+/// <summary>
+/// Owns every graphics pipeline and hands out one per unique PipelineDesc. Shader modules are loaded once per path.
+/// Requests queued with request() are created together by build(), split into one vkCreateGraphicsPipelines call per thread,
+/// get() creates a missing pipeline on its own. Not thread safe, one thread at a time may use the library.
+/// </summary>
+class PipelineLibrary
+{
+public:
+	void create(vk::Device device, vk::PipelineCache cache);
+	void destroy();
+	/// <summary>
+	/// Shader modules are created straight from the pack mapping when it has the path
+	/// </summary>
+	void setAssetPack(const AssetPack* assets) { this->assets = assets; }
+
+	vk::Pipeline get(const PipelineDesc& desc);
+	void request(const PipelineDesc& desc);
+	/// <summary>
+	/// Creates everything requested since the last build on up to threadCount threads, the calling one included.
+	/// Returns how many pipelines were actually created.
+	/// </summary>
+	uint32_t build(uint32_t threadCount = 1);
+
+	size_t getPipelineCount() const { return pipelines.size(); }
+	/// <summary>
+	/// Requests answered by an existing or already queued pipeline
+	/// </summary>
+	uint64_t getDeduplicatedCount() const { return deduplicated; }
+
+private:
+	struct DescHash {
+		size_t operator()(const PipelineDesc& desc) const { return static_cast<size_t>(desc.hash()); }
+	};
+
+	vk::Device device;
+	vk::PipelineCache cache;
+	const AssetPack* assets = nullptr;
+	// requested but not built yet entries hold a null pipeline, map nodes never move so pending can point into it
+	std::unordered_map<PipelineDesc, vk::Pipeline, DescHash> pipelines;
+	std::vector<std::pair<const PipelineDesc, vk::Pipeline>*> pending;
+	std::unordered_map<std::string, vk::ShaderModule> shaderModules;
+	uint64_t deduplicated = 0;
+
+	void loadShaderModules(uint32_t threadCount);
+	vk::ShaderModule getShaderModule(const std::string& path);
+	vk::ShaderModule createShaderModule(const std::string& path) const;
+};
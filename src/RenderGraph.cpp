@@ -0,0 +1,630 @@
+#include "RenderGraph.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <optional>
+#include <stdexcept>
+
+namespace {
+    struct AccessInfo {
+        vk::ImageLayout layout;
+        vk::PipelineStageFlags stages;
+        vk::AccessFlags access;
+        vk::ImageUsageFlags usage;
+        bool write;
+    };
+
+    AccessInfo describe(RenderGraph::Access access, bool clear)
+    {
+        switch (access) {
+        case RenderGraph::Access::ColorAttachment:
+            return { vk::ImageLayout::eColorAttachmentOptimal, vk::PipelineStageFlagBits::eColorAttachmentOutput,
+                clear ? vk::AccessFlagBits::eColorAttachmentWrite : vk::AccessFlagBits::eColorAttachmentRead | vk::AccessFlagBits::eColorAttachmentWrite,
+                vk::ImageUsageFlagBits::eColorAttachment, true };
+        case RenderGraph::Access::DepthAttachment:
+            return { vk::ImageLayout::eDepthStencilAttachmentOptimal, vk::PipelineStageFlagBits::eEarlyFragmentTests | vk::PipelineStageFlagBits::eLateFragmentTests,
+                vk::AccessFlagBits::eDepthStencilAttachmentRead | vk::AccessFlagBits::eDepthStencilAttachmentWrite,
+                vk::ImageUsageFlagBits::eDepthStencilAttachment, true };
+        case RenderGraph::Access::ShaderRead:
+            return { vk::ImageLayout::eShaderReadOnlyOptimal, vk::PipelineStageFlagBits::eFragmentShader, vk::AccessFlagBits::eShaderRead,
+                vk::ImageUsageFlagBits::eSampled, false };
+        case RenderGraph::Access::TransferSource:
+        default:
+            return { vk::ImageLayout::eTransferSrcOptimal, vk::PipelineStageFlagBits::eTransfer, vk::AccessFlagBits::eTransferRead,
+                vk::ImageUsageFlagBits::eTransferSrc, false };
+        }
+    }
+
+    bool isDepthFormat(vk::Format format)
+    {
+        return format == vk::Format::eD16Unorm || format == vk::Format::eX8D24UnormPack32 || format == vk::Format::eD32Sfloat ||
+            format == vk::Format::eD16UnormS8Uint || format == vk::Format::eD24UnormS8Uint || format == vk::Format::eD32SfloatS8Uint;
+    }
+
+    vk::ImageUsageFlags usageForLayout(vk::ImageLayout layout)
+    {
+        switch (layout) {
+        case vk::ImageLayout::eTransferSrcOptimal: return vk::ImageUsageFlagBits::eTransferSrc;
+        case vk::ImageLayout::eShaderReadOnlyOptimal: return vk::ImageUsageFlagBits::eSampled;
+        default: return {};
+        }
+    }
+}
+
+/// <summary>
+/// Layout, the last write and the stages that have seen it since, per resource while walking the schedule
+/// </summary>
+struct RenderGraph::ResourceState {
+    vk::ImageLayout layout = vk::ImageLayout::eUndefined;
+    vk::PipelineStageFlags writeStages;
+    vk::AccessFlags writeAccess;
+    vk::PipelineStageFlags readStages;
+};
+
+void RenderGraph::create(vk::Device device, MemoryAllocator& allocator)
+{
+    this->device = device;
+    this->allocator = &allocator;
+}
+
+void RenderGraph::destroy()
+{
+    if (!device) return;
+
+    for (auto& pass : passes) {
+        for (auto& entry : pass.framebuffers) {
+            device.destroyFramebuffer(entry.second);
+        }
+        device.destroyRenderPass(pass.renderPass);
+    }
+    for (auto& resource : resources) {
+        if (resource.imported) continue;
+        device.destroyImageView(resource.view);
+        device.destroyImage(resource.image);
+    }
+    allocator->free(transientMemory);
+
+    passes.clear();
+    resources.clear();
+    schedule.clear();
+    after = BarrierBatch();
+    barrierCount = 0;
+    transientBytes = 0;
+    unaliasedBytes = 0;
+    device = nullptr;
+}
+
+RenderGraph::ResourceId RenderGraph::createImage(const std::string& name, vk::Format format, vk::Extent2D extent)
+{
+    Resource resource;
+    resource.name = name;
+    resource.format = format;
+    resource.extent = extent;
+    resources.push_back(resource);
+    return static_cast<ResourceId>(resources.size() - 1);
+}
+
+RenderGraph::ResourceId RenderGraph::importImage(const std::string& name, vk::Format format, vk::ImageLayout initialLayout,
+    vk::PipelineStageFlags initialStage, vk::ImageLayout finalLayout)
+{
+    Resource resource;
+    resource.name = name;
+    resource.format = format;
+    resource.imported = true;
+    resource.initialLayout = initialLayout;
+    resource.initialStage = initialStage;
+    resource.finalLayout = finalLayout;
+    resources.push_back(resource);
+    return static_cast<ResourceId>(resources.size() - 1);
+}
+
+void RenderGraph::markOutput(ResourceId resource, vk::ImageLayout finalLayout)
+{
+    resources[resource].finalLayout = finalLayout;
+}
+
+RenderGraph::PassId RenderGraph::addPass(const std::string& name, std::function<void(vk::CommandBuffer)> record)
+{
+    Pass pass;
+    pass.name = name;
+    pass.record = std::move(record);
+    passes.push_back(std::move(pass));
+    return static_cast<PassId>(passes.size() - 1);
+}
+
+void RenderGraph::addColorOutput(PassId pass, ResourceId resource, const std::array<float, 4>* clearColor)
+{
+    PassAccess access;
+    access.resource = resource;
+    access.access = Access::ColorAttachment;
+    if (clearColor) {
+        access.clear = true;
+        access.clearValue = vk::ClearValue(*clearColor);
+    }
+    passes[pass].accesses.push_back(access);
+}
+
+void RenderGraph::addDepthOutput(PassId pass, ResourceId resource, const float* clearDepth)
+{
+    PassAccess access;
+    access.resource = resource;
+    access.access = Access::DepthAttachment;
+    if (clearDepth) {
+        access.clear = true;
+        access.clearValue.depthStencil = vk::ClearDepthStencilValue(*clearDepth, 0);
+    }
+    passes[pass].accesses.push_back(access);
+}
+
+void RenderGraph::addShaderInput(PassId pass, ResourceId resource)
+{
+    PassAccess access;
+    access.resource = resource;
+    access.access = Access::ShaderRead;
+    passes[pass].accesses.push_back(access);
+}
+
+void RenderGraph::addTransferInput(PassId pass, ResourceId resource)
+{
+    PassAccess access;
+    access.resource = resource;
+    access.access = Access::TransferSource;
+    passes[pass].accesses.push_back(access);
+}
+
+void RenderGraph::compile(bool aliasTransients)
+{
+    cull();
+
+    for (uint32_t index = 0; index < schedule.size(); index++) {
+        for (const auto& access : passes[schedule[index]].accesses) {
+            Resource& resource = resources[access.resource];
+            resource.firstUse = std::min(resource.firstUse, index);
+            resource.lastUse = std::max(resource.lastUse, index);
+            resource.usage |= describe(access.access, access.clear).usage;
+        }
+    }
+    for (auto& resource : resources) {
+        resource.usage |= usageForLayout(resource.finalLayout);
+    }
+
+    createTransientImages(aliasTransients);
+    schedulePasses();
+}
+
+/// <summary>
+/// Walks the passes backwards from the outputs. A pass survives when it has side effects or writes something a later
+/// surviving pass (or the outside) still needs, clearing an image ends the need for whatever was in it before.
+/// </summary>
+void RenderGraph::cull()
+{
+    std::vector<bool> needed(resources.size());
+    for (size_t i = 0; i < resources.size(); i++) {
+        needed[i] = resources[i].finalLayout != vk::ImageLayout::eUndefined;
+    }
+
+    std::vector<bool> live(passes.size());
+    for (size_t i = passes.size(); i-- > 0;) {
+        Pass& pass = passes[i];
+        live[i] = pass.sideEffect;
+        for (const auto& access : pass.accesses) {
+            live[i] = live[i] || (describe(access.access, access.clear).write && needed[access.resource]);
+        }
+        if (!live[i]) continue;
+
+        for (const auto& access : pass.accesses) {
+            bool overwrites = describe(access.access, access.clear).write && access.clear;
+            needed[access.resource] = !overwrites;
+        }
+    }
+
+    schedule.clear();
+    for (uint32_t i = 0; i < passes.size(); i++) {
+        if (live[i]) schedule.push_back(i);
+    }
+}
+
+/// <summary>
+/// Largest first, each transient goes to the lowest offset no lifetime-overlapping image occupies.
+/// Everything shares one allocation, so the memory types of all transients have to intersect.
+/// </summary>
+void RenderGraph::createTransientImages(bool aliasTransients)
+{
+    std::vector<ResourceId> transients;
+    vk::DeviceSize alignment = 1;
+    uint32_t memoryTypeBits = ~0u;
+
+    for (ResourceId id = 0; id < resources.size(); id++) {
+        Resource& resource = resources[id];
+        if (resource.imported || resource.firstUse == UINT32_MAX) continue;
+        // an output is read after the graph, nothing may move into its memory
+        if (resource.finalLayout != vk::ImageLayout::eUndefined) {
+            resource.lastUse = static_cast<uint32_t>(schedule.size());
+        }
+
+        auto imageInfo = vk::ImageCreateInfo();
+        imageInfo.imageType = vk::ImageType::e2D;
+        imageInfo.format = resource.format;
+        imageInfo.extent = vk::Extent3D(resource.extent.width, resource.extent.height, 1);
+        imageInfo.mipLevels = 1;
+        imageInfo.arrayLayers = 1;
+        imageInfo.samples = vk::SampleCountFlagBits::e1;
+        imageInfo.tiling = vk::ImageTiling::eOptimal;
+        imageInfo.usage = resource.usage;
+        imageInfo.sharingMode = vk::SharingMode::eExclusive;
+        imageInfo.initialLayout = vk::ImageLayout::eUndefined;
+
+        resource.image = device.createImage(imageInfo);
+        resource.requirements = device.getImageMemoryRequirements(resource.image);
+        alignment = std::max(alignment, resource.requirements.alignment);
+        memoryTypeBits &= resource.requirements.memoryTypeBits;
+        transients.push_back(id);
+    }
+    if (transients.empty()) return;
+    if (memoryTypeBits == 0) {
+        throw std::runtime_error("render graph transients share no memory type!");
+    }
+
+    std::stable_sort(transients.begin(), transients.end(), [&](ResourceId a, ResourceId b) {
+        return resources[a].requirements.size > resources[b].requirements.size;
+    });
+
+    auto alignUp = [](vk::DeviceSize value, vk::DeviceSize alignment) { return (value + alignment - 1) / alignment * alignment; };
+    std::vector<ResourceId> placed;
+    for (ResourceId id : transients) {
+        Resource& resource = resources[id];
+        vk::DeviceSize size = resource.requirements.size;
+        unaliasedBytes = alignUp(unaliasedBytes, resource.requirements.alignment) + size;
+
+        std::vector<ResourceId> overlapping;
+        for (ResourceId other : placed) {
+            const Resource& o = resources[other];
+            bool aliveTogether = !(o.lastUse < resource.firstUse || resource.lastUse < o.firstUse);
+            if (aliveTogether || !aliasTransients) overlapping.push_back(other);
+        }
+
+        std::vector<vk::DeviceSize> candidates = { 0 };
+        for (ResourceId other : overlapping) {
+            candidates.push_back(alignUp(resources[other].memoryOffset + resources[other].requirements.size, resource.requirements.alignment));
+        }
+        std::sort(candidates.begin(), candidates.end());
+
+        for (vk::DeviceSize offset : candidates) {
+            bool fits = true;
+            for (ResourceId other : overlapping) {
+                const Resource& o = resources[other];
+                fits = fits && (offset + size <= o.memoryOffset || o.memoryOffset + o.requirements.size <= offset);
+            }
+            if (fits) {
+                resource.memoryOffset = offset;
+                break;
+            }
+        }
+        transientBytes = std::max(transientBytes, resource.memoryOffset + size);
+        placed.push_back(id);
+    }
+
+    vk::MemoryRequirements requirements(transientBytes, alignment, memoryTypeBits);
+    transientMemory = allocator->allocate(requirements, vk::MemoryPropertyFlagBits::eDeviceLocal, ResourceKind::Optimal);
+
+    for (ResourceId id : transients) {
+        Resource& resource = resources[id];
+        device.bindImageMemory(resource.image, transientMemory.memory, transientMemory.offset + resource.memoryOffset);
+
+        auto viewInfo = vk::ImageViewCreateInfo();
+        viewInfo.image = resource.image;
+        viewInfo.viewType = vk::ImageViewType::e2D;
+        viewInfo.format = resource.format;
+        viewInfo.subresourceRange = vk::ImageSubresourceRange(isDepthFormat(resource.format) ? vk::ImageAspectFlagBits::eDepth : vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1);
+        resource.view = device.createImageView(viewInfo);
+    }
+}
+
+/// <summary>
+/// Tracks every resource through the schedule and batches what each pass needs into one barrier in front of it:
+/// a layout change, a read or write after a write, or a write after reads. Reads after reads in the same layout are free.
+/// An image taking over aliased memory waits for the last accesses of the images that lived there before. Transients are
+/// single instances shared by all frames in flight, so their first use also waits for the previous frame's last accesses
+/// to the same memory, see waitForPreviousFrame().
+/// Attachments get their load and store ops from the same walk, the last attachment use of an output does its final transition.
+/// </summary>
+void RenderGraph::schedulePasses()
+{
+    std::vector<ResourceState> states(resources.size());
+    for (size_t i = 0; i < resources.size(); i++) {
+        if (resources[i].imported) {
+            states[i].layout = resources[i].initialLayout;
+            states[i].writeStages = resources[i].initialStage;
+        }
+    }
+
+    for (uint32_t index = 0; index < schedule.size(); index++) {
+        Pass& pass = passes[schedule[index]];
+        pass.before = BarrierBatch();
+
+        std::vector<vk::AttachmentDescription> colorAttachments;
+        std::vector<vk::ClearValue> colorClears;
+        std::vector<ResourceId> colorResources;
+        std::optional<vk::AttachmentDescription> depthAttachment;
+        vk::ClearValue depthClear;
+        ResourceId depthResource = 0;
+
+        for (const auto& access : pass.accesses) {
+            const Resource& resource = resources[access.resource];
+            ResourceState& state = states[access.resource];
+            AccessInfo info = describe(access.access, access.clear);
+
+            if (!resource.imported && resource.firstUse == index) {
+                for (ResourceId other = 0; other < resources.size(); other++) {
+                    const Resource& o = resources[other];
+                    bool sharesMemory = !o.imported && o.image && other != access.resource && o.lastUse < index &&
+                        resource.memoryOffset < o.memoryOffset + o.requirements.size && o.memoryOffset < resource.memoryOffset + resource.requirements.size;
+                    if (sharesMemory) {
+                        state.writeStages |= states[other].writeStages | states[other].readStages;
+                        state.writeAccess |= states[other].writeAccess;
+                    }
+                }
+            }
+
+            vk::ImageLayout oldLayout = state.layout;
+            bool layoutChange = oldLayout != info.layout;
+            bool hazard = (layoutChange || info.write) ? (layoutChange || state.writeStages || state.readStages)
+                : (state.writeStages && (state.readStages & info.stages) != info.stages);
+            if (hazard) {
+                vk::PipelineStageFlags srcStages = info.write || layoutChange ? state.writeStages | state.readStages : state.writeStages;
+                pass.before.srcStages |= srcStages ? srcStages : vk::PipelineStageFlags(vk::PipelineStageFlagBits::eTopOfPipe);
+                pass.before.dstStages |= info.stages;
+                pass.before.barriers.push_back({ access.resource, state.writeAccess, info.access, oldLayout, info.layout });
+                barrierCount++;
+            }
+
+            if (info.write) {
+                state = { info.layout, info.stages, info.access, {} };
+            }
+            else if (layoutChange) {
+                // later readers in other stages have to wait for the transition
+                state = { info.layout, info.stages, {}, info.stages };
+            }
+            else {
+                state.readStages |= info.stages;
+            }
+
+            if (access.access != Access::ColorAttachment && access.access != Access::DepthAttachment) continue;
+
+            bool output = resource.finalLayout != vk::ImageLayout::eUndefined;
+            auto attachment = vk::AttachmentDescription();
+            attachment.format = resource.format;
+            attachment.samples = vk::SampleCountFlagBits::e1;
+            attachment.loadOp = access.clear ? vk::AttachmentLoadOp::eClear : oldLayout == vk::ImageLayout::eUndefined ? vk::AttachmentLoadOp::eDontCare : vk::AttachmentLoadOp::eLoad;
+            attachment.storeOp = output || resource.lastUse > index ? vk::AttachmentStoreOp::eStore : vk::AttachmentStoreOp::eDontCare;
+            attachment.stencilLoadOp = vk::AttachmentLoadOp::eDontCare;
+            attachment.stencilStoreOp = vk::AttachmentStoreOp::eDontCare;
+            attachment.initialLayout = info.layout;
+            attachment.finalLayout = info.layout;
+            if (output && resource.lastUse == index) {
+                attachment.finalLayout = resource.finalLayout;
+                state.layout = resource.finalLayout;
+            }
+
+            if (access.access == Access::ColorAttachment) {
+                colorAttachments.push_back(attachment);
+                colorClears.push_back(access.clearValue);
+                colorResources.push_back(access.resource);
+            }
+            else {
+                depthAttachment = attachment;
+                depthClear = access.clearValue;
+                depthResource = access.resource;
+            }
+        }
+
+        if (colorAttachments.empty() && !depthAttachment) continue;
+
+        std::vector<vk::AttachmentDescription> attachments = colorAttachments;
+        pass.attachments = colorResources;
+        pass.clearValues = colorClears;
+        std::vector<vk::AttachmentReference> colorRefs;
+        for (uint32_t i = 0; i < colorAttachments.size(); i++) {
+            colorRefs.push_back(vk::AttachmentReference(i, vk::ImageLayout::eColorAttachmentOptimal));
+        }
+        auto depthRef = vk::AttachmentReference(static_cast<uint32_t>(attachments.size()), vk::ImageLayout::eDepthStencilAttachmentOptimal);
+        if (depthAttachment) {
+            attachments.push_back(*depthAttachment);
+            pass.attachments.push_back(depthResource);
+            pass.clearValues.push_back(depthClear);
+        }
+
+        auto subpass = vk::SubpassDescription();
+        subpass.pipelineBindPoint = vk::PipelineBindPoint::eGraphics;
+        subpass.colorAttachmentCount = static_cast<uint32_t>(colorRefs.size());
+        subpass.pColorAttachments = colorRefs.data();
+        subpass.pDepthStencilAttachment = depthAttachment ? &depthRef : nullptr;
+
+        // the barriers in front of the pass already did the external synchronization
+        auto renderPassInfo = vk::RenderPassCreateInfo();
+        renderPassInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+        renderPassInfo.pAttachments = attachments.data();
+        renderPassInfo.subpassCount = 1;
+        renderPassInfo.pSubpasses = &subpass;
+        pass.renderPass = device.createRenderPass(renderPassInfo);
+    }
+
+    after = BarrierBatch();
+    for (ResourceId id = 0; id < resources.size(); id++) {
+        const Resource& resource = resources[id];
+        ResourceState& state = states[id];
+        if (resource.finalLayout == vk::ImageLayout::eUndefined || state.layout == resource.finalLayout) continue;
+        if (!resource.imported && !resource.image) continue;
+
+        vk::PipelineStageFlags srcStages = state.writeStages | state.readStages;
+        after.srcStages |= srcStages ? srcStages : vk::PipelineStageFlags(vk::PipelineStageFlagBits::eTopOfPipe);
+        after.dstStages |= vk::PipelineStageFlagBits::eBottomOfPipe;
+        after.barriers.push_back({ id, state.writeAccess, {}, state.layout, resource.finalLayout });
+        barrierCount++;
+    }
+
+    waitForPreviousFrame(states);
+}
+
+/// <summary>
+/// Adds the previous frame's last accesses of every transient sharing a transient's memory range, the transient itself
+/// included, to the barrier in front of its first use. The previous frame's commands were submitted earlier on the same
+/// queue, so the barrier's source scope reaches them. An output is read outside the graph after its final transition,
+/// which nothing here can name, so it is waited for with all commands.
+/// </summary>
+void RenderGraph::waitForPreviousFrame(const std::vector<ResourceState>& endStates)
+{
+    for (ResourceId id = 0; id < resources.size(); id++) {
+        const Resource& resource = resources[id];
+        if (resource.imported || !resource.image) continue;
+
+        vk::PipelineStageFlags srcStages;
+        vk::AccessFlags srcAccess;
+        for (ResourceId other = 0; other < resources.size(); other++) {
+            const Resource& o = resources[other];
+            bool sharesMemory = !o.imported && o.image &&
+                resource.memoryOffset < o.memoryOffset + o.requirements.size && o.memoryOffset < resource.memoryOffset + resource.requirements.size;
+            if (!sharesMemory) continue;
+
+            if (o.finalLayout != vk::ImageLayout::eUndefined) {
+                srcStages |= vk::PipelineStageFlagBits::eAllCommands;
+            }
+            srcStages |= endStates[other].writeStages | endStates[other].readStages;
+            srcAccess |= endStates[other].writeAccess;
+        }
+
+        // the first use always changes the layout away from undefined, so it always has a barrier
+        BarrierBatch& batch = passes[schedule[resource.firstUse]].before;
+        batch.srcStages |= srcStages;
+        for (auto& barrier : batch.barriers) {
+            if (barrier.resource == id) barrier.srcAccess |= srcAccess;
+        }
+    }
+}
+
+void RenderGraph::setImportedImage(ResourceId resource, vk::Image image, vk::ImageView view, vk::Extent2D extent)
+{
+    resources[resource].image = image;
+    resources[resource].view = view;
+    resources[resource].extent = extent;
+}
+
+void RenderGraph::execute(vk::CommandBuffer commandBuffer)
+{
+    for (PassId id : schedule) {
+        Pass& pass = passes[id];
+        recordBarriers(commandBuffer, pass.before);
+
+        if (!pass.renderPass) {
+            if (pass.record) pass.record(commandBuffer);
+            continue;
+        }
+
+        pass.framebuffer = findFramebuffer(pass);
+        auto renderPassInfo = vk::RenderPassBeginInfo();
+        renderPassInfo.renderPass = pass.renderPass;
+        renderPassInfo.framebuffer = pass.framebuffer;
+        renderPassInfo.renderArea = vk::Rect2D({ 0, 0 }, resources[pass.attachments[0]].extent);
+        renderPassInfo.clearValueCount = static_cast<uint32_t>(pass.clearValues.size());
+        renderPassInfo.pClearValues = pass.clearValues.data();
+
+        commandBuffer.beginRenderPass(renderPassInfo, pass.contents);
+        if (pass.record) pass.record(commandBuffer);
+        commandBuffer.endRenderPass();
+    }
+    recordBarriers(commandBuffer, after);
+}
+
+vk::Framebuffer RenderGraph::findFramebuffer(Pass& pass)
+{
+    std::vector<VkImageView> views;
+    vk::Extent2D extent = resources[pass.attachments[0]].extent;
+    for (ResourceId id : pass.attachments) {
+        const Resource& resource = resources[id];
+        if (!resource.view) {
+            throw std::runtime_error("render graph image " + resource.name + " was never bound!");
+        }
+        if (resource.extent != extent) {
+            throw std::runtime_error("attachments of render graph pass " + pass.name + " differ in size!");
+        }
+        views.push_back(static_cast<VkImageView>(resource.view));
+    }
+
+    auto found = pass.framebuffers.find(views);
+    if (found != pass.framebuffers.end()) return found->second;
+
+    auto framebufferInfo = vk::FramebufferCreateInfo();
+    framebufferInfo.renderPass = pass.renderPass;
+    framebufferInfo.attachmentCount = static_cast<uint32_t>(views.size());
+    framebufferInfo.pAttachments = reinterpret_cast<const vk::ImageView*>(views.data());
+    framebufferInfo.width = extent.width;
+    framebufferInfo.height = extent.height;
+    framebufferInfo.layers = 1;
+
+    vk::Framebuffer framebuffer = device.createFramebuffer(framebufferInfo);
+    pass.framebuffers.emplace(std::move(views), framebuffer);
+    return framebuffer;
+}
+
+void RenderGraph::releaseFramebuffers(DeletionQueue& deletionQueue, uint64_t lastUse)
+{
+    for (auto& pass : passes) {
+        for (auto& entry : pass.framebuffers) {
+            deletionQueue.push(lastUse, entry.second);
+        }
+        pass.framebuffers.clear();
+        pass.framebuffer = nullptr;
+    }
+}
+
+void RenderGraph::recordBarriers(vk::CommandBuffer commandBuffer, const BarrierBatch& batch) const
+{
+    if (batch.barriers.empty()) return;
+
+    std::vector<vk::ImageMemoryBarrier> barriers;
+    for (const auto& barrier : batch.barriers) {
+        const Resource& resource = resources[barrier.resource];
+        auto imageBarrier = vk::ImageMemoryBarrier();
+        imageBarrier.srcAccessMask = barrier.srcAccess;
+        imageBarrier.dstAccessMask = barrier.dstAccess;
+        imageBarrier.oldLayout = barrier.oldLayout;
+        imageBarrier.newLayout = barrier.newLayout;
+        imageBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        imageBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        imageBarrier.image = resource.image;
+        imageBarrier.subresourceRange = vk::ImageSubresourceRange(isDepthFormat(resource.format) ? vk::ImageAspectFlagBits::eDepth : vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1);
+        barriers.push_back(imageBarrier);
+    }
+    commandBuffer.pipelineBarrier(batch.srcStages, batch.dstStages, {}, nullptr, nullptr, barriers);
+}
+
+void RenderGraph::printReport(std::ostream& out) const
+{
+    auto flags = out.flags();
+    const double MiB = 1024.0 * 1024.0;
+
+    out << "render graph: " << schedule.size() << " of " << passes.size() << " passes live, " << barrierCount << " image barriers" << std::endl;
+    for (PassId id = 0; id < passes.size(); id++) {
+        const Pass& pass = passes[id];
+        bool live = std::find(schedule.begin(), schedule.end(), id) != schedule.end();
+        out << "  " << pass.name << ": ";
+        if (!live) {
+            out << "culled" << std::endl;
+            continue;
+        }
+        out << pass.before.barriers.size() << " barriers before, " << pass.attachments.size() << " attachments" << std::endl;
+    }
+
+    out << std::fixed << std::setprecision(1);
+    for (const auto& resource : resources) {
+        if (resource.imported || !resource.image) continue;
+        out << "  transient " << resource.name << ": " << resource.requirements.size / MiB << " MiB at offset "
+            << resource.memoryOffset / MiB << " MiB, passes " << resource.firstUse << "-" << resource.lastUse << std::endl;
+    }
+    out << "render graph: peak attachment memory " << transientBytes / MiB << " MiB aliased, " << unaliasedBytes / MiB << " MiB without aliasing";
+    if (unaliasedBytes > 0) {
+        out << " (" << 100.0 * (1.0 - (double)transientBytes / unaliasedBytes) << "% saved)";
+    }
+    out << std::endl;
+    out.flags(flags);
+}
@@ -0,0 +1,170 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include <vulkan/vulkan.hpp>
+
+#include "DeletionQueue.h"
+#include "MemoryAllocator.h"
+
+/// <summary>
+/// Frame described as passes that declare which images they read and write. compile() drops passes nothing depends on,
+/// works out the image layout transitions and the barriers between passes, creates one render pass per graphics pass
+/// and places transient images whose lifetimes don't overlap at the same memory. execute() records the whole frame.
+/// Passes run in declaration order, a pass may only read what an earlier pass wrote.
+/// </summary>
+class RenderGraph
+{
+public:
+	using ResourceId = uint32_t;
+	using PassId = uint32_t;
+
+	enum class Access : uint32_t {
+		ColorAttachment,
+		DepthAttachment,
+		ShaderRead, // sampled in the fragment shader
+		TransferSource,
+	};
+
+	void create(vk::Device device, MemoryAllocator& allocator);
+	void destroy();
+
+	/// <summary>
+	/// Image owned by the graph that only lives between its first and last use, its memory may be shared with others
+	/// </summary>
+	ResourceId createImage(const std::string& name, vk::Format format, vk::Extent2D extent);
+	/// <summary>
+	/// Image owned by someone else and bound every frame with setImportedImage(). It arrives in initialLayout once
+	/// initialStage is done with it and leaves in finalLayout, Undefined when nothing after the graph reads it.
+	/// </summary>
+	ResourceId importImage(const std::string& name, vk::Format format, vk::ImageLayout initialLayout, vk::PipelineStageFlags initialStage,
+		vk::ImageLayout finalLayout);
+	/// <summary>
+	/// Keeps a transient image alive to the end of the graph and leaves it in finalLayout
+	/// </summary>
+	void markOutput(ResourceId resource, vk::ImageLayout finalLayout);
+
+	PassId addPass(const std::string& name, std::function<void(vk::CommandBuffer)> record = nullptr);
+	void addColorOutput(PassId pass, ResourceId resource, const std::array<float, 4>* clearColor = nullptr);
+	void addDepthOutput(PassId pass, ResourceId resource, const float* clearDepth = nullptr);
+	void addShaderInput(PassId pass, ResourceId resource);
+	void addTransferInput(PassId pass, ResourceId resource);
+	/// <summary>
+	/// The pass does something outside the graph (a readback, a query), it is never culled
+	/// </summary>
+	void setSideEffect(PassId pass) { passes[pass].sideEffect = true; }
+
+	/// <summary>
+	/// Culls, schedules barriers, creates render passes and transient images. aliasTransients = false gives every
+	/// transient image its own memory, the report has both numbers either way.
+	/// </summary>
+	void compile(bool aliasTransients = true);
+
+	/// <summary>
+	/// Per-frame binding of an imported image, before execute()
+	/// </summary>
+	void setImportedImage(ResourceId resource, vk::Image image, vk::ImageView view, vk::Extent2D extent);
+	void setRecord(PassId pass, std::function<void(vk::CommandBuffer)> record) { passes[pass].record = std::move(record); }
+	void setSubpassContents(PassId pass, vk::SubpassContents contents) { passes[pass].contents = contents; }
+	void execute(vk::CommandBuffer commandBuffer);
+
+	/// <summary>
+	/// Render pass of a graphics pass, pipelines used in it are created against this one
+	/// </summary>
+	vk::RenderPass getRenderPass(PassId pass) const { return passes[pass].renderPass; }
+	/// <summary>
+	/// Framebuffer the pass is recorded into during execute(), for secondary command buffer inheritance
+	/// </summary>
+	vk::Framebuffer getFramebuffer(PassId pass) const { return passes[pass].framebuffer; }
+	/// <summary>
+	/// Cached framebuffers reference imported views, hand them over before those views are destroyed
+	/// </summary>
+	void releaseFramebuffers(DeletionQueue& deletionQueue, uint64_t lastUse);
+
+	uint32_t getLivePassCount() const { return static_cast<uint32_t>(schedule.size()); }
+	uint32_t getBarrierCount() const { return barrierCount; }
+	vk::DeviceSize getTransientBytes() const { return transientBytes; }
+	vk::DeviceSize getUnaliasedBytes() const { return unaliasedBytes; }
+	void printReport(std::ostream& out) const;
+
+private:
+	struct Resource {
+		std::string name;
+		vk::Format format;
+		vk::Extent2D extent;
+		bool imported = false;
+		vk::ImageLayout initialLayout = vk::ImageLayout::eUndefined;
+		vk::PipelineStageFlags initialStage;
+		vk::ImageLayout finalLayout = vk::ImageLayout::eUndefined; // anything else makes the image an output
+
+		vk::ImageUsageFlags usage;
+		vk::Image image;
+		vk::ImageView view;
+		vk::MemoryRequirements requirements;
+		vk::DeviceSize memoryOffset = 0;
+		uint32_t firstUse = UINT32_MAX; // indices into schedule
+		uint32_t lastUse = 0;
+	};
+
+	struct PassAccess {
+		ResourceId resource;
+		Access access;
+		bool clear = false;
+		vk::ClearValue clearValue;
+	};
+
+	struct ImageBarrier {
+		ResourceId resource;
+		vk::AccessFlags srcAccess;
+		vk::AccessFlags dstAccess;
+		vk::ImageLayout oldLayout;
+		vk::ImageLayout newLayout;
+	};
+
+	struct ResourceState;
+
+	struct BarrierBatch {
+		vk::PipelineStageFlags srcStages;
+		vk::PipelineStageFlags dstStages;
+		std::vector<ImageBarrier> barriers;
+	};
+
+	struct Pass {
+		std::string name;
+		std::vector<PassAccess> accesses;
+		bool sideEffect = false;
+		std::function<void(vk::CommandBuffer)> record;
+		vk::SubpassContents contents = vk::SubpassContents::eInline;
+
+		BarrierBatch before;
+		vk::RenderPass renderPass;
+		std::vector<ResourceId> attachments; // colors, then depth
+		std::vector<vk::ClearValue> clearValues;
+		std::map<std::vector<VkImageView>, vk::Framebuffer> framebuffers;
+		vk::Framebuffer framebuffer;
+	};
+
+	vk::Device device;
+	MemoryAllocator* allocator = nullptr;
+	std::vector<Resource> resources;
+	std::vector<Pass> passes;
+	std::vector<PassId> schedule; // live passes in execution order
+	BarrierBatch after; // transitions into final layouts no render pass could do
+	Allocation transientMemory;
+
+	uint32_t barrierCount = 0;
+	vk::DeviceSize transientBytes = 0;
+	vk::DeviceSize unaliasedBytes = 0;
+
+	void cull();
+	void createTransientImages(bool aliasTransients);
+	void schedulePasses();
+	void waitForPreviousFrame(const std::vector<ResourceState>& endStates);
+	vk::Framebuffer findFramebuffer(Pass& pass);
+	void recordBarriers(vk::CommandBuffer commandBuffer, const BarrierBatch& batch) const;
+};
@@ -0,0 +1,242 @@
+#include "StagingUploader.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+void StagingUploader::create(vk::Device device, MemoryAllocator& allocator, vk::Queue queue, uint32_t queueFamily, vk::DeviceSize stagingSize)
+{
+    this->device = device;
+    this->allocator = &allocator;
+    this->queue = queue;
+    this->queueFamily = queueFamily;
+    this->stagingSize = stagingSize;
+
+    staging = allocator.createBuffer(stagingSize, vk::BufferUsageFlagBits::eTransferSrc,
+        vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent);
+
+    auto poolInfo = vk::CommandPoolCreateInfo();
+    poolInfo.flags = vk::CommandPoolCreateFlagBits::eTransient;
+    poolInfo.queueFamilyIndex = queueFamily;
+    commandPool = device.createCommandPool(poolInfo);
+
+    auto allocInfo = vk::CommandBufferAllocateInfo();
+    allocInfo.commandPool = commandPool;
+    allocInfo.level = vk::CommandBufferLevel::ePrimary;
+    allocInfo.commandBufferCount = 1;
+    commandBuffer = device.allocateCommandBuffers(allocInfo)[0];
+
+    fence = device.createFence(vk::FenceCreateInfo());
+}
+
+void StagingUploader::destroy()
+{
+    if (!device) return;
+
+    device.destroyFence(fence);
+    device.destroyCommandPool(commandPool);
+    device.destroyCommandPool(ownerCommandPool);
+    device.destroySemaphore(transferSemaphore);
+    device.destroySemaphore(returnSemaphore);
+    ownerCommandPool = nullptr;
+    handedOver.clear();
+    allocator->destroyBuffer(staging);
+    device = nullptr;
+}
+
+void StagingUploader::setOwner(vk::Queue queue, uint32_t queueFamily)
+{
+    if (queueFamily == this->queueFamily) return;
+
+    ownerQueue = queue;
+    ownerFamily = queueFamily;
+
+    auto poolInfo = vk::CommandPoolCreateInfo();
+    poolInfo.flags = vk::CommandPoolCreateFlagBits::eTransient;
+    poolInfo.queueFamilyIndex = queueFamily;
+    ownerCommandPool = device.createCommandPool(poolInfo);
+
+    auto allocInfo = vk::CommandBufferAllocateInfo();
+    allocInfo.commandPool = ownerCommandPool;
+    allocInfo.level = vk::CommandBufferLevel::ePrimary;
+    allocInfo.commandBufferCount = 2;
+    auto ownerCommandBuffers = device.allocateCommandBuffers(allocInfo);
+    ownerCommandBuffer = ownerCommandBuffers[0];
+    returnCommandBuffer = ownerCommandBuffers[1];
+
+    transferSemaphore = device.createSemaphore(vk::SemaphoreCreateInfo());
+    returnSemaphore = device.createSemaphore(vk::SemaphoreCreateInfo());
+}
+
+void StagingUploader::upload(vk::Buffer destination, vk::DeviceSize offset, const void* data, vk::DeviceSize size, bool concurrent)
+{
+    const char* source = static_cast<const char*>(data);
+
+    while (size > 0) {
+        vk::DeviceSize chunk = std::min(size, stagingSize - stagingHead);
+        if (chunk == 0) {
+            flush();
+            continue;
+        }
+
+        memcpy(static_cast<char*>(staging.allocation.mapped) + stagingHead, source, (size_t)chunk);
+        pending.push_back({ destination, vk::BufferCopy(stagingHead, offset, chunk), concurrent });
+
+        // keep source offsets 16 byte aligned for the copy engine
+        stagingHead = std::min((stagingHead + chunk + 15) & ~vk::DeviceSize(15), stagingSize);
+        source += chunk;
+        offset += chunk;
+        size -= chunk;
+        uploadedBytes += chunk;
+    }
+}
+
+/// <summary>
+/// Submits the last batch of a flush and waits for it, on the timeline when there is one
+/// </summary>
+void StagingUploader::submit(vk::Queue target, vk::SubmitInfo submitInfo)
+{
+    if (timeline) {
+        uint64_t signalValue = timeline->next();
+        vk::Semaphore signalSemaphore = timeline->get();
+        uint64_t waitValue = 0;
+
+        auto timelineInfo = vk::TimelineSemaphoreSubmitInfoKHR();
+        timelineInfo.waitSemaphoreValueCount = submitInfo.waitSemaphoreCount;
+        timelineInfo.pWaitSemaphoreValues = &waitValue;
+        timelineInfo.signalSemaphoreValueCount = 1;
+        timelineInfo.pSignalSemaphoreValues = &signalValue;
+        submitInfo.pNext = &timelineInfo;
+        submitInfo.signalSemaphoreCount = 1;
+        submitInfo.pSignalSemaphores = &signalSemaphore;
+
+        target.submit(submitInfo, nullptr);
+        timeline->wait(signalValue);
+        return;
+    }
+
+    target.submit(submitInfo, fence);
+
+    auto ret = device.waitForFences(1, &fence, VK_TRUE, UINT64_MAX);
+    if (ret != vk::Result::eSuccess) throw std::runtime_error("fence failed");
+    device.resetFences(1, &fence);
+}
+
+void StagingUploader::flush()
+{
+    if (pending.empty()) return;
+
+    auto beginInfo = vk::CommandBufferBeginInfo();
+    beginInfo.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit;
+    commandBuffer.begin(beginInfo);
+
+    // one vkCmdCopyBuffer per destination with all of its regions
+    std::stable_sort(pending.begin(), pending.end(), [](const PendingCopy& a, const PendingCopy& b) {
+        return a.destination < b.destination;
+    });
+
+    // destinations the owner family got in an earlier flush go back to the transfer family before the copies
+    std::vector<vk::BufferMemoryBarrier> returnReleases;
+    std::vector<vk::BufferMemoryBarrier> returnAcquires;
+    if (transfersOwnership()) {
+        for (size_t i = 0; i < pending.size(); i++) {
+            bool first = i == 0 || pending[i - 1].destination != pending[i].destination;
+            if (!first || pending[i].concurrent || !handedOver.count(static_cast<VkBuffer>(pending[i].destination))) continue;
+            returnReleases.push_back(vk::BufferMemoryBarrier(vk::AccessFlagBits::eMemoryWrite, {}, ownerFamily, queueFamily, pending[i].destination, 0, VK_WHOLE_SIZE));
+            returnAcquires.push_back(vk::BufferMemoryBarrier({}, vk::AccessFlagBits::eTransferWrite, ownerFamily, queueFamily, pending[i].destination, 0, VK_WHOLE_SIZE));
+        }
+    }
+    if (!returnAcquires.empty()) {
+        commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTopOfPipe, vk::PipelineStageFlagBits::eTransfer, {}, nullptr, returnAcquires, nullptr);
+    }
+
+    std::vector<vk::BufferCopy> regions;
+    std::vector<vk::BufferMemoryBarrier> releases;
+    std::vector<vk::BufferMemoryBarrier> acquires;
+    for (size_t i = 0; i < pending.size();) {
+        regions.clear();
+        size_t end = i;
+        while (end < pending.size() && pending[end].destination == pending[i].destination) {
+            regions.push_back(pending[end].region);
+            end++;
+        }
+        commandBuffer.copyBuffer(staging.buffer, pending[i].destination, regions);
+
+        if (transfersOwnership() && !pending[i].concurrent) {
+            releases.push_back(vk::BufferMemoryBarrier(vk::AccessFlagBits::eTransferWrite, {}, queueFamily, ownerFamily, pending[i].destination, 0, VK_WHOLE_SIZE));
+            acquires.push_back(vk::BufferMemoryBarrier({}, vk::AccessFlagBits::eMemoryRead, queueFamily, ownerFamily, pending[i].destination, 0, VK_WHOLE_SIZE));
+            handedOver.insert(static_cast<VkBuffer>(pending[i].destination));
+        }
+        i = end;
+    }
+
+    if (!transfersOwnership()) {
+        auto barrier = vk::MemoryBarrier(vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eMemoryRead);
+        commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eAllCommands, {}, barrier, nullptr, nullptr);
+        commandBuffer.end();
+
+        auto submitInfo = vk::SubmitInfo();
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = &commandBuffer;
+        submit(queue, submitInfo);
+    }
+    else {
+        if (!returnReleases.empty()) {
+            // after everything already submitted to the owner queue, the transfer submission waits for it
+            auto beginInfo = vk::CommandBufferBeginInfo();
+            beginInfo.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit;
+            returnCommandBuffer.begin(beginInfo);
+            returnCommandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eAllCommands, vk::PipelineStageFlagBits::eBottomOfPipe, {}, nullptr, returnReleases, nullptr);
+            returnCommandBuffer.end();
+
+            auto returnSubmit = vk::SubmitInfo();
+            returnSubmit.commandBufferCount = 1;
+            returnSubmit.pCommandBuffers = &returnCommandBuffer;
+            returnSubmit.signalSemaphoreCount = 1;
+            returnSubmit.pSignalSemaphores = &returnSemaphore;
+            ownerQueue.submit(returnSubmit, nullptr);
+        }
+
+        // release on the transfer queue, the semaphore orders the acquire on the owner queue after it
+        if (!releases.empty()) {
+            commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eBottomOfPipe, {}, nullptr, releases, nullptr);
+        }
+        commandBuffer.end();
+
+        vk::PipelineStageFlags returnWaitStage = vk::PipelineStageFlagBits::eTransfer;
+        auto transferSubmit = vk::SubmitInfo();
+        if (!returnReleases.empty()) {
+            transferSubmit.waitSemaphoreCount = 1;
+            transferSubmit.pWaitSemaphores = &returnSemaphore;
+            transferSubmit.pWaitDstStageMask = &returnWaitStage;
+        }
+        transferSubmit.commandBufferCount = 1;
+        transferSubmit.pCommandBuffers = &commandBuffer;
+        transferSubmit.signalSemaphoreCount = 1;
+        transferSubmit.pSignalSemaphores = &transferSemaphore;
+        queue.submit(transferSubmit, nullptr);
+
+        auto beginInfo = vk::CommandBufferBeginInfo();
+        beginInfo.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit;
+        ownerCommandBuffer.begin(beginInfo);
+        if (!acquires.empty()) {
+            ownerCommandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTopOfPipe, vk::PipelineStageFlagBits::eAllCommands, {}, nullptr, acquires, nullptr);
+        }
+        ownerCommandBuffer.end();
+
+        vk::PipelineStageFlags waitStage = vk::PipelineStageFlagBits::eAllCommands;
+        auto ownerSubmit = vk::SubmitInfo();
+        ownerSubmit.waitSemaphoreCount = 1;
+        ownerSubmit.pWaitSemaphores = &transferSemaphore;
+        ownerSubmit.pWaitDstStageMask = &waitStage;
+        ownerSubmit.commandBufferCount = 1;
+        ownerSubmit.pCommandBuffers = &ownerCommandBuffer;
+        submit(ownerQueue, ownerSubmit);
+        device.resetCommandPool(ownerCommandPool, {});
+    }
+    device.resetCommandPool(commandPool, {});
+
+    pending.clear();
+    stagingHead = 0;
+    submitCount++;
+}
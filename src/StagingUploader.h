@@ -0,0 +1,86 @@
+#pragma once
+#include <cstdint>
+#include <unordered_set>
+#include <vector>
+
+#include <vulkan/vulkan.hpp>
+
+#include "MemoryAllocator.h"
+#include "TimelineSemaphore.h"
+
+/// <summary>
+/// Copies data into device local buffers through one persistently mapped staging buffer.
+/// upload() only memcpys into the staging buffer, flush() records every pending copy into a single
+/// command buffer and submits it once, the staging buffer is flushed early only when it runs full.
+/// When the copies run on a dedicated transfer queue, exclusive destinations are released to the owner
+/// queue family and acquired there by a second small submission. A destination the owner family already holds
+/// from an earlier flush is handed back to the transfer family before it is copied into again.
+/// </summary>
+class StagingUploader
+{
+public:
+	static constexpr vk::DeviceSize DEFAULT_STAGING_SIZE = 32ull * 1024 * 1024;
+
+	void create(vk::Device device, MemoryAllocator& allocator, vk::Queue queue, uint32_t queueFamily, vk::DeviceSize stagingSize = DEFAULT_STAGING_SIZE);
+	void destroy();
+	/// <summary>
+	/// Signal and wait on timeline values instead of the uploader's own fence, the last submission of a flush signals it
+	/// </summary>
+	void setTimeline(TimelineSemaphore* timeline) { this->timeline = timeline; }
+	/// <summary>
+	/// Queue that uses the uploaded buffers, when it is in another family than the upload queue ownership is transferred to it
+	/// </summary>
+	void setOwner(vk::Queue queue, uint32_t queueFamily);
+	/// <summary>
+	/// concurrent = the destination is shared between queue families and needs no ownership transfer
+	/// </summary>
+	void upload(vk::Buffer destination, vk::DeviceSize offset, const void* data, vk::DeviceSize size, bool concurrent = false);
+	/// <summary>
+	/// Submits all pending copies and waits for them, the data is visible to every later submission
+	/// </summary>
+	void flush();
+	/// <summary>
+	/// Drops what the uploader knows about the ownership of destination, call it before destroying an exclusive buffer it uploaded to
+	/// </summary>
+	void forget(vk::Buffer destination) { handedOver.erase(static_cast<VkBuffer>(destination)); }
+
+	uint64_t getSubmitCount() const { return submitCount; }
+	vk::DeviceSize getUploadedBytes() const { return uploadedBytes; }
+
+private:
+	struct PendingCopy {
+		vk::Buffer destination;
+		vk::BufferCopy region;
+		bool concurrent;
+	};
+
+	vk::Device device;
+	MemoryAllocator* allocator = nullptr;
+	vk::Queue queue;
+	uint32_t queueFamily = 0;
+	vk::CommandPool commandPool;
+	vk::CommandBuffer commandBuffer;
+	vk::Fence fence;
+	TimelineSemaphore* timeline = nullptr;
+
+	// only set up when the owner is in another queue family
+	vk::Queue ownerQueue;
+	uint32_t ownerFamily = 0;
+	vk::CommandPool ownerCommandPool;
+	vk::CommandBuffer ownerCommandBuffer;
+	vk::CommandBuffer returnCommandBuffer; // releases destinations back to the transfer family
+	vk::Semaphore transferSemaphore;
+	vk::Semaphore returnSemaphore;
+	std::unordered_set<VkBuffer> handedOver; // exclusive destinations the owner family holds
+
+	Buffer staging;
+	vk::DeviceSize stagingSize = 0;
+	vk::DeviceSize stagingHead = 0;
+	std::vector<PendingCopy> pending;
+
+	uint64_t submitCount = 0;
+	vk::DeviceSize uploadedBytes = 0;
+
+	bool transfersOwnership() const { return static_cast<bool>(ownerCommandPool); }
+	void submit(vk::Queue target, vk::SubmitInfo submitInfo);
+};
@@ -0,0 +1,68 @@
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "app.h"
+
+/// <summary>
+/// Startup benchmark: StartupBenchmark [--cycles N] [--json F] [app options...]
+/// Creates and tears down the whole app N times in one process and reports min/median/max per init and teardown phase.
+/// Every cycle gets a fresh instance and device, pass --no-pipeline-cache for cold pipeline compiles as well.
+/// Any other option goes to the app as on its own command line.
+/// </summary>
+int main(int argc, char** argv)
+{
+    uint32_t cycles = 10;
+    std::string jsonPath = "startup.json";
+    std::vector<char*> appArgs = { argv[0] };
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--cycles") == 0 && i + 1 < argc) {
+            cycles = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+        }
+        else if (strcmp(argv[i], "--json") == 0 && i + 1 < argc) {
+            jsonPath = argv[++i];
+        }
+        else {
+            appArgs.push_back(argv[i]);
+        }
+    }
+    if (cycles == 0) {
+        std::cerr << "--cycles must be at least 1" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    try {
+        AppConfig config = AppConfig::fromArgs(static_cast<int>(appArgs.size()), appArgs.data());
+#ifndef _WIN32
+        config.headless = true;
+#endif
+
+        StartupProfiler profiler;
+        for (uint32_t cycle = 0; cycle < cycles; cycle++) {
+            StartupProfiler::Scope cycleScope(&profiler, "cycle total");
+            HelloTriangleApplication app(config, &profiler);
+            {
+                // what the first frame would wait for, pipelines compile in the background during initialize()
+                StartupProfiler::Scope readyScope(&profiler, "ready total");
+                app.initialize();
+                app.waitForPipelines();
+            }
+        }
+
+        std::cout << "startup: " << cycles << " init/cleanup cycles" << std::endl;
+        profiler.printSummary(std::cout);
+        if (!jsonPath.empty() && !profiler.writeJson(jsonPath)) {
+            return EXIT_FAILURE;
+        }
+    }
+    catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,85 @@
+#include "StartupProfiler.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+
+namespace {
+    std::string escapeJson(const std::string& text)
+    {
+        std::string escaped;
+        for (char c : text) {
+            if (c == '"' || c == '\\') {
+                escaped.push_back('\\');
+                escaped.push_back(c);
+            }
+            else if (static_cast<unsigned char>(c) < 0x20) {
+                escaped.push_back(' ');
+            }
+            else {
+                escaped.push_back(c);
+            }
+        }
+        return escaped;
+    }
+}
+
+void StartupProfiler::addSample(const std::string& phase, double milliseconds)
+{
+    auto found = samples.find(phase);
+    if (found == samples.end()) {
+        phases.push_back(phase);
+        found = samples.emplace(phase, FrameStats()).first;
+    }
+    found->second.addSample(milliseconds);
+}
+
+void StartupProfiler::printSummary(std::ostream& out) const
+{
+    auto flags = out.flags();
+    size_t width = 0;
+    for (const auto& phase : phases) {
+        width = std::max(width, phase.size());
+    }
+
+    out << std::fixed << std::setprecision(3);
+    for (const auto& phase : phases) {
+        const FrameStats& stats = samples.at(phase);
+        out << std::left << std::setw(static_cast<int>(width)) << phase << std::right
+            << "  min " << std::setw(9) << stats.min()
+            << "  median " << std::setw(9) << stats.percentile(50.0)
+            << "  max " << std::setw(9) << stats.max() << " ms over " << stats.count() << std::endl;
+    }
+    out.flags(flags);
+}
+
+bool StartupProfiler::writeJson(const std::string& path) const
+{
+    std::ofstream file(path, std::ios::trunc);
+    if (!file.is_open()) {
+        std::cout << "startup profiler: could not write " << path << std::endl;
+        return false;
+    }
+
+    file << "{\n  \"info\": {";
+    const char* separator = "\n";
+    for (const auto& entry : info) {
+        file << separator << "    \"" << escapeJson(entry.first) << "\": \"" << escapeJson(entry.second) << "\"";
+        separator = ",\n";
+    }
+    file << "\n  },\n  \"phases\": [";
+
+    file << std::fixed << std::setprecision(4);
+    separator = "\n";
+    for (const auto& phase : phases) {
+        const FrameStats& stats = samples.at(phase);
+        file << separator << "    {\"name\": \"" << escapeJson(phase) << "\", \"samples\": " << stats.count()
+            << ", \"min_ms\": " << stats.min() << ", \"median_ms\": " << stats.percentile(50.0) << ", \"max_ms\": " << stats.max() << "}";
+        separator = ",\n";
+    }
+    file << "\n  ]\n}\n";
+
+    std::cout << "startup profiler: wrote " << phases.size() << " phases to " << path << std::endl;
+    return file.good();
+}
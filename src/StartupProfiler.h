@@ -0,0 +1,50 @@
+#pragma once
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "FrameStats.h"
+
+/// <summary>
+/// Wall time of named init and teardown phases over repeated cycles. Phases keep the order they were first seen in,
+/// every cycle adds one sample per phase it ran.
+/// </summary>
+class StartupProfiler
+{
+public:
+	/// <summary>
+	/// Times its own lifetime as one sample of phase, does nothing without a profiler
+	/// </summary>
+	class Scope {
+	public:
+		Scope(StartupProfiler* profiler, const char* phase) : profiler(profiler), phase(phase), start(FrameStats::Clock::now()) {}
+		~Scope() {
+			if (profiler) profiler->addSample(phase, FrameStats::toMilliseconds(FrameStats::Clock::now() - start));
+		}
+		Scope(const Scope&) = delete;
+		Scope& operator=(const Scope&) = delete;
+
+	private:
+		StartupProfiler* profiler;
+		const char* phase;
+		FrameStats::Clock::time_point start;
+	};
+
+	void addSample(const std::string& phase, double milliseconds);
+	/// <summary>
+	/// Free form key/value written into the report, device and driver so regressions can be told from driver updates
+	/// </summary>
+	void setInfo(const std::string& key, const std::string& value) { info[key] = value; }
+
+	void printSummary(std::ostream& out) const;
+	/// <summary>
+	/// { "info": {...}, "phases": [ { "name", "samples", "min_ms", "median_ms", "max_ms" }, ... ] }
+	/// </summary>
+	bool writeJson(const std::string& path) const;
+
+private:
+	std::vector<std::string> phases;
+	std::map<std::string, FrameStats> samples;
+	std::map<std::string, std::string> info;
+};
@@ -0,0 +1,50 @@
+#include "TimelineSemaphore.h"
+
+#include <stdexcept>
+
+void TimelineSemaphore::create(vk::Device device, const vk::DispatchLoaderDynamic& dispatcher)
+{
+    this->device = device;
+    this->dispatcher = &dispatcher;
+
+    auto typeInfo = vk::SemaphoreTypeCreateInfoKHR();
+    typeInfo.semaphoreType = vk::SemaphoreTypeKHR::eTimeline;
+    typeInfo.initialValue = 0;
+
+    auto semaphoreInfo = vk::SemaphoreCreateInfo();
+    semaphoreInfo.pNext = &typeInfo;
+    semaphore = device.createSemaphore(semaphoreInfo);
+
+    lastSignaled = 0;
+    completed = 0;
+}
+
+void TimelineSemaphore::destroy()
+{
+    if (!device) return;
+
+    device.destroySemaphore(semaphore);
+    device = nullptr;
+}
+
+bool TimelineSemaphore::isComplete(uint64_t value)
+{
+    if (completed >= value) return true;
+
+    completed = device.getSemaphoreCounterValueKHR(semaphore, *dispatcher);
+    return completed >= value;
+}
+
+void TimelineSemaphore::wait(uint64_t value)
+{
+    if (isComplete(value)) return;
+
+    auto waitInfo = vk::SemaphoreWaitInfoKHR();
+    waitInfo.semaphoreCount = 1;
+    waitInfo.pSemaphores = &semaphore;
+    waitInfo.pValues = &value;
+
+    auto ret = device.waitSemaphoresKHR(waitInfo, UINT64_MAX, *dispatcher);
+    if (ret != vk::Result::eSuccess) throw std::runtime_error("timeline semaphore wait failed!");
+    completed = value;
+}
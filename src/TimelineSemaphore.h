@@ -0,0 +1,36 @@
+#pragma once
+#include <cstdint>
+
+#include <vulkan/vulkan.hpp>
+
+/// <summary>
+/// VK_KHR_timeline_semaphore counter. Every signal operation takes the next value from next(), so work is
+/// identified by a single increasing number that the host can poll or wait on without any fences.
+/// Submissions signalling it have to execute in value order, i.e. go to one queue.
+/// </summary>
+class TimelineSemaphore
+{
+public:
+	void create(vk::Device device, const vk::DispatchLoaderDynamic& dispatcher);
+	void destroy();
+	vk::Semaphore get() const { return semaphore; }
+
+	/// <summary>
+	/// Value for the next signal operation
+	/// </summary>
+	uint64_t next() { return ++lastSignaled; }
+	uint64_t getLastSignaled() const { return lastSignaled; }
+
+	/// <summary>
+	/// Non-blocking, asks the device only when the cached counter is not far enough yet
+	/// </summary>
+	bool isComplete(uint64_t value);
+	void wait(uint64_t value);
+
+private:
+	vk::Device device;
+	const vk::DispatchLoaderDynamic* dispatcher = nullptr;
+	vk::Semaphore semaphore;
+	uint64_t lastSignaled = 0;
+	uint64_t completed = 0;
+};
@@ -0,0 +1,188 @@
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "Instrumentation.h"
+
+namespace {
+    /// <summary>
+    /// Bounds checked reads over the whole trace, fails instead of reading past a truncated last record
+    /// </summary>
+    struct Reader {
+        const std::vector<char>& data;
+        size_t offset;
+
+        template<typename T>
+        bool read(T& value) {
+            if (data.size() - offset < sizeof(T)) return false;
+            memcpy(&value, data.data() + offset, sizeof(T));
+            offset += sizeof(T);
+            return true;
+        }
+
+        bool readString(std::string& text) {
+            uint16_t length;
+            if (!read(length) || data.size() - offset < length) return false;
+            text.assign(data.data() + offset, length);
+            offset += length;
+            return true;
+        }
+    };
+
+    std::string escapeJson(const std::string& text)
+    {
+        std::string escaped;
+        for (char c : text) {
+            if (c == '"' || c == '\\') {
+                escaped.push_back('\\');
+                escaped.push_back(c);
+            }
+            else if (static_cast<unsigned char>(c) < 0x20) {
+                escaped.push_back(' ');
+            }
+            else {
+                escaped.push_back(c);
+            }
+        }
+        return escaped;
+    }
+}
+
+/// <summary>
+/// Offline converter: TraceConverter INPUT OUTPUT turns a trace written with --instrument into Chrome trace JSON
+/// for chrome://tracing or ui.perfetto.dev.
+/// </summary>
+int main(int argc, char** argv)
+{
+    if (argc != 3) {
+        std::cerr << "usage: TraceConverter INPUT OUTPUT" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::ifstream input(argv[1], std::ios::ate | std::ios::binary);
+    if (!input.is_open()) {
+        std::cerr << "failed to open " << argv[1] << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::vector<char> data((size_t)input.tellg());
+    input.seekg(0);
+    input.read(data.data(), data.size());
+
+    Reader reader{ data, 0 };
+    Instrumentation::FileHeader header;
+    if (!reader.read(header) || header.magic != Instrumentation::MAGIC) {
+        std::cerr << argv[1] << " is not a trace" << std::endl;
+        return EXIT_FAILURE;
+    }
+    if (header.version != Instrumentation::VERSION) {
+        std::cerr << argv[1] << " is trace version " << header.version << ", expected " << Instrumentation::VERSION << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::ofstream output(argv[2], std::ios::trunc);
+    if (!output.is_open()) {
+        std::cerr << "failed to open " << argv[2] << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    // timestamps relative to the first one, in the microseconds Chrome expects
+    const double microsecondsPerTick = 1e6 * header.clockNumerator / header.clockDenominator;
+    bool haveOrigin = false;
+    uint64_t origin = 0;
+    auto microseconds = [&](uint64_t ticks) {
+        if (!haveOrigin) {
+            origin = ticks;
+            haveOrigin = true;
+        }
+        return (static_cast<double>(ticks) - static_cast<double>(origin)) * microsecondsPerTick;
+    };
+
+    std::unordered_map<uint32_t, std::string> names;
+    uint64_t events = 0;
+    uint64_t dropped = 0;
+    const char* separator = "\n";
+
+    output << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[" << std::fixed << std::setprecision(3);
+    while (reader.offset < data.size()) {
+        Instrumentation::RecordKind kind = {};
+        if (!reader.read(kind)) {
+            std::cerr << "trace truncated at offset " << reader.offset << std::endl;
+            break;
+        }
+
+        uint32_t thread = 0;
+        uint32_t nameId = 0;
+        bool complete = true;
+        switch (kind) {
+        case Instrumentation::RecordKind::Name: {
+            std::string name;
+            complete = reader.read(nameId) && reader.readString(name);
+            if (complete) {
+                names[nameId] = name;
+            }
+            break;
+        }
+        case Instrumentation::RecordKind::Thread: {
+            std::string name;
+            complete = reader.read(thread) && reader.readString(name);
+            if (complete && !name.empty()) {
+                output << separator << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << thread
+                    << ",\"args\":{\"name\":\"" << escapeJson(name) << "\"}}";
+                separator = ",\n";
+            }
+            break;
+        }
+        case Instrumentation::RecordKind::Zone: {
+            uint64_t begin = 0, end = 0;
+            complete = reader.read(thread) && reader.read(nameId) && reader.read(begin) && reader.read(end);
+            if (complete) {
+                double start = microseconds(begin);
+                output << separator << "{\"name\":\"" << escapeJson(names[nameId]) << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << thread
+                    << ",\"ts\":" << start << ",\"dur\":" << microseconds(end) - start << "}";
+                separator = ",\n";
+                events++;
+            }
+            break;
+        }
+        case Instrumentation::RecordKind::Counter: {
+            uint64_t time = 0;
+            int64_t value = 0;
+            complete = reader.read(thread) && reader.read(nameId) && reader.read(time) && reader.read(value);
+            if (complete) {
+                output << separator << "{\"name\":\"" << escapeJson(names[nameId]) << "\",\"ph\":\"C\",\"pid\":1,\"tid\":" << thread
+                    << ",\"ts\":" << microseconds(time) << ",\"args\":{\"value\":" << value << "}}";
+                separator = ",\n";
+                events++;
+            }
+            break;
+        }
+        case Instrumentation::RecordKind::Dropped: {
+            uint64_t count = 0;
+            complete = reader.read(thread) && reader.read(count);
+            if (complete) {
+                dropped += count;
+            }
+            break;
+        }
+        default:
+            std::cerr << "unknown record " << static_cast<int>(kind) << " at offset " << reader.offset - 1 << std::endl;
+            return EXIT_FAILURE;
+        }
+
+        if (!complete) {
+            // the app was killed mid write, keep what came before
+            std::cerr << "trace truncated at offset " << reader.offset << std::endl;
+            break;
+        }
+    }
+    output << "\n]}\n";
+
+    std::cout << "converted " << events << " events, " << dropped << " were dropped while recording" << std::endl;
+    return output.good() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,47 @@
+#include "UniformRing.h"
+
+#include <stdexcept>
+
+void UniformRing::create(MemoryAllocator& allocator, vk::DeviceSize minAlignment, vk::DeviceSize bytesPerFrame, uint32_t frameCount, vk::BufferUsageFlags extraUsage)
+{
+    this->allocator = &allocator;
+    alignment = minAlignment ? minAlignment : 1;
+    partition = (bytesPerFrame + alignment - 1) / alignment * alignment;
+
+    // host coherent so writes never need vkFlushMappedMemoryRanges, device local when the heap allows (ReBAR, UMA)
+    buffer = allocator.createBuffer(partition * frameCount, vk::BufferUsageFlagBits::eUniformBuffer | extraUsage,
+        vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+        vk::MemoryPropertyFlagBits::eDeviceLocal);
+}
+
+void UniformRing::destroy()
+{
+    if (allocator) {
+        allocator->destroyBuffer(buffer);
+        allocator = nullptr;
+    }
+}
+
+void UniformRing::beginFrame(uint32_t frameIndex)
+{
+    head = frameIndex * partition;
+    end = head + partition;
+}
+
+void* UniformRing::allocate(vk::DeviceSize size, uint32_t& dynamicOffset)
+{
+    if (head + size > end) {
+        throw std::runtime_error("uniform ring partition exhausted!");
+    }
+
+    dynamicOffset = static_cast<uint32_t>(head);
+    void* data = static_cast<char*>(buffer.allocation.mapped) + head;
+    head = (head + size + alignment - 1) / alignment * alignment;
+    return data;
+}
+
+void* UniformRing::allocateArray(vk::DeviceSize elementSize, uint32_t count, uint32_t& firstOffset, vk::DeviceSize& stride)
+{
+    stride = (elementSize + alignment - 1) / alignment * alignment;
+    return allocate(stride * count, firstOffset);
+}
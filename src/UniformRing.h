@@ -0,0 +1,60 @@
+#pragma once
+#include <cstdint>
+
+#include <vulkan/vulkan.hpp>
+
+#include "MemoryAllocator.h"
+
+/// <summary>
+/// Persistently mapped uniform buffer split into one partition per frame in flight.
+/// Per-frame data is written straight into the mapping and addressed with dynamic descriptor offsets,
+/// a frame never maps, allocates or waits for anything.
+/// </summary>
+class UniformRing
+{
+public:
+	/// <summary>
+	/// extraUsage lets the same memory be bound as something else too, e.g. a storage buffer
+	/// </summary>
+	void create(MemoryAllocator& allocator, vk::DeviceSize minAlignment, vk::DeviceSize bytesPerFrame, uint32_t frameCount, vk::BufferUsageFlags extraUsage = {});
+	void destroy();
+
+	/// <summary>
+	/// Starts writing into the partition of frameIndex, the caller guarantees the GPU is done with it
+	/// </summary>
+	void beginFrame(uint32_t frameIndex);
+	/// <summary>
+	/// Reserves size bytes, returns the mapped pointer and the dynamic offset to bind them with
+	/// </summary>
+	void* allocate(vk::DeviceSize size, uint32_t& dynamicOffset);
+	/// <summary>
+	/// Reserves count aligned slots of elementSize bytes at once so several threads can fill them without touching the head,
+	/// slot i lives at the returned pointer / firstOffset plus i * stride
+	/// </summary>
+	void* allocateArray(vk::DeviceSize elementSize, uint32_t count, uint32_t& firstOffset, vk::DeviceSize& stride);
+
+	template<typename T>
+	uint32_t push(const T& value) {
+		uint32_t dynamicOffset;
+		*static_cast<T*>(allocate(sizeof(T), dynamicOffset)) = value;
+		return dynamicOffset;
+	}
+
+	vk::Buffer getBuffer() const { return buffer.buffer; }
+	vk::DeviceSize getAlignment() const { return alignment; }
+
+	/// <summary>
+	/// Partition size needed for count values of elementSize bytes
+	/// </summary>
+	static vk::DeviceSize partitionSize(vk::DeviceSize minAlignment, vk::DeviceSize elementSize, uint64_t count) {
+		return (elementSize + minAlignment - 1) / minAlignment * minAlignment * count;
+	}
+
+private:
+	MemoryAllocator* allocator = nullptr;
+	Buffer buffer;
+	vk::DeviceSize alignment = 1;
+	vk::DeviceSize partition = 0;
+	vk::DeviceSize head = 0;
+	vk::DeviceSize end = 0;
+};
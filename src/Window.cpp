@@ -4,19 +4,44 @@
 LRESULT Window::WindowProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
 {
     Window* windowObject = (Window*)GetPropW(hwnd, L"this");
+    if (!windowObject) {
+        // messages sent from inside CreateWindowW, before SetPropW
+        return DefWindowProc(hwnd, uMsg, wParam, lParam);
+    }
     switch (uMsg)
     {
     case WM_DESTROY:
         PostQuitMessage(0);
         return 0;
 
+    case WM_CLOSE:
+        // the renderer may still be presenting to the window, destroy() happens in cleanup
+        windowObject->close.store(true, std::memory_order_release);
+        windowObject->forward(WindowEvent::Kind::Close, 0, 0);
+        return 0;
+
     case WM_SIZE:
-        windowObject->windowResized = true;
-        windowObject->resize = {
-            LOWORD(lParam),//width
-            HIWORD(lParam)//height
-        };
+        windowObject->resize.store((uint64_t)LOWORD(lParam) << 32 | HIWORD(lParam), std::memory_order_relaxed);
+        windowObject->windowResized.store(true, std::memory_order_release);
+        windowObject->forward(WindowEvent::Kind::Resize, LOWORD(lParam), HIWORD(lParam));
         return 0;
+
+    case WM_KEYDOWN:
+    case WM_KEYUP:
+        windowObject->forward(WindowEvent::Kind::Key, static_cast<uint32_t>(wParam), uMsg == WM_KEYDOWN);
+        break;
+    case WM_MOUSEMOVE:
+        windowObject->forward(WindowEvent::Kind::MouseMove, LOWORD(lParam), HIWORD(lParam));
+        break;
+    case WM_LBUTTONDOWN:
+    case WM_LBUTTONUP:
+        windowObject->forward(WindowEvent::Kind::MouseButton, 0, uMsg == WM_LBUTTONDOWN);
+        break;
+    case WM_RBUTTONDOWN:
+    case WM_RBUTTONUP:
+        windowObject->forward(WindowEvent::Kind::MouseButton, 1, uMsg == WM_RBUTTONDOWN);
+        break;
+
     case WM_NCDESTROY:
         RemovePropW(hwnd, L"this");
         return 0;
@@ -32,7 +57,8 @@ bool Window::create() //todo dynamic class names
     wc.hInstance = GetModuleHandle(NULL);
     wc.lpfnWndProc = WindowProc;
     wc.lpszClassName = WindowName;
-    if (!RegisterClassW(&wc)) {
+    // the class lives as long as the process, a window created again after destroy() finds it registered
+    if (!RegisterClassW(&wc) && GetLastError() != ERROR_CLASS_ALREADY_EXISTS) {
         std::cout << "class registration failed";
         std::cout << GetLastError();
         return true;
@@ -59,9 +85,9 @@ HWND Window::getHandle()
 /// <returns>tuple(width,height)</returns>
 std::tuple<uint32_t, uint32_t> Window::getSize()
 {
-    if (windowResized) {
-        windowResized = false;
-        return { resize.width, resize.height };
+    if (windowResized.exchange(false, std::memory_order_acquire)) {
+        uint64_t size = resize.load(std::memory_order_relaxed);
+        return { static_cast<uint32_t>(size >> 32), static_cast<uint32_t>(size) };
     }
     RECT window;
     if(!GetClientRect(windowHandle, &window)) throw "failed to get client rect";
@@ -69,16 +95,14 @@ std::tuple<uint32_t, uint32_t> Window::getSize()
     
 }
 
-inline bool Window::hasResized()
-{
-    return windowResized;
-}
-
 void Window::destroy()
 {
     if (windowHandle) {
         DestroyWindow(windowHandle);
         windowHandle = nullptr;
+        // WM_DESTROY posted a quit, a window created later on this thread must not receive it
+        MSG msg;
+        PeekMessageW(&msg, NULL, WM_QUIT, WM_QUIT, PM_REMOVE);
     }
 }
 void Window::pollEvents()
@@ -107,7 +131,26 @@ void Window::pollEvents()
     }
     return;
 }
+void Window::waitEvents()
+{
+    MsgWaitForMultipleObjects(0, nullptr, FALSE, INFINITE, QS_ALLINPUT);
+    pollEvents();
+}
+
+void Window::wake()
+{
+    PostMessageW(windowHandle, WM_NULL, 0, 0);
+}
+
 bool Window::shouldClose()
 {
-    return close;
+    return close.load(std::memory_order_acquire);
+}
+
+void Window::forward(WindowEvent::Kind kind, uint32_t a, uint32_t b)
+{
+    WindowEventQueue* queue = events.load(std::memory_order_acquire);
+    if (queue) {
+        queue->push({ kind, a, b, FrameStats::Clock::now() });
+    }
 }
\ No newline at end of file
@@ -15,32 +15,47 @@
 #include <windows.h>
 
 #endif
+#include <atomic>
 #include <iostream>
 #include <tuple>
 
+#include "WindowEventQueue.h"
+
 class Window
 {
 private:
-	bool close = false;
-	bool windowResized;
+	// written by the thread pumping messages, read by the render thread
+	std::atomic<bool> close{ false };
+	std::atomic<bool> windowResized{ false };
+	std::atomic<uint64_t> resize{ 0 }; // width << 32 | height, stored before windowResized
+	std::atomic<WindowEventQueue*> events{ nullptr };
 	HWND windowHandle = nullptr;
 	LPCWSTR WindowName;
-	struct {
-		uint32_t width;
-		uint32_t height;
-	} resize;
 	/*FUNCTIONS*/
 private:
 	static LRESULT Window::WindowProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam);
+	void forward(WindowEvent::Kind kind, uint32_t a, uint32_t b);
 public:
 	Window() : WindowName(L"MainWindow") {};
 	Window(LPCWSTR WindowName) : WindowName(WindowName){};
 	bool create();
 	HWND getHandle();
 	std::tuple< uint32_t, uint32_t> getSize();
-	inline bool hasResized();
+	bool hasResized() { return windowResized; }
 	void destroy();
 	void pollEvents();
+	/// <summary>
+	/// Blocks until a message arrives or wake() is called, then handles everything queued
+	/// </summary>
+	void waitEvents();
+	/// <summary>
+	/// Ends a waitEvents() on the pumping thread, callable from any thread
+	/// </summary>
+	void wake();
+	/// <summary>
+	/// Events are forwarded into queue while set, nullptr stops forwarding
+	/// </summary>
+	void setEventQueue(WindowEventQueue* queue) { events.store(queue, std::memory_order_release); }
 	bool shouldClose();
 };
 
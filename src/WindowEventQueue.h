@@ -0,0 +1,65 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+#include "FrameStats.h"
+
+struct WindowEvent {
+	enum class Kind : uint32_t {
+		Resize, // a = width, b = height
+		Close,
+		Key, // a = virtual key, b = 1 when pressed
+		MouseMove, // a = x, b = y
+		MouseButton, // a = button, b = 1 when pressed
+	};
+
+	Kind kind;
+	uint32_t a;
+	uint32_t b;
+	FrameStats::Clock::time_point time; // when the window thread received it
+};
+
+/// <summary>
+/// Hands window events from the thread pumping the window's messages to the render thread. Single producer, single
+/// consumer, never blocks either side, a full queue drops the event and counts it. Resize and close also set atomic
+/// flags on the Window, so dropping their events loses nothing.
+/// </summary>
+class WindowEventQueue
+{
+public:
+	static constexpr uint32_t CAPACITY = 1024; // a power of two
+
+	/// <summary>
+	/// Window thread only
+	/// </summary>
+	bool push(const WindowEvent& event) {
+		uint64_t position = head.load(std::memory_order_relaxed);
+		if (position - tail.load(std::memory_order_acquire) >= CAPACITY) {
+			dropped.fetch_add(1, std::memory_order_relaxed);
+			return false;
+		}
+		events[position & (CAPACITY - 1)] = event;
+		head.store(position + 1, std::memory_order_release);
+		return true;
+	}
+
+	/// <summary>
+	/// Render thread only, false when there is nothing queued
+	/// </summary>
+	bool pop(WindowEvent& event) {
+		uint64_t position = tail.load(std::memory_order_relaxed);
+		if (position == head.load(std::memory_order_acquire)) return false;
+		event = events[position & (CAPACITY - 1)];
+		tail.store(position + 1, std::memory_order_release);
+		return true;
+	}
+
+	uint64_t droppedCount() const { return dropped.load(std::memory_order_relaxed); }
+
+private:
+	std::array<WindowEvent, CAPACITY> events;
+	alignas(64) std::atomic<uint64_t> head{ 0 };
+	alignas(64) std::atomic<uint64_t> tail{ 0 };
+	std::atomic<uint64_t> dropped{ 0 };
+};
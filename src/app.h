@@ -6,19 +6,62 @@
 #include <cstring>
 #include <cstdlib>
 #include <cstdint>
+#include <cstddef>
+#include <cfloat>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <exception>
+#include <future>
 #include <optional>
+#include <random>
 #include <set>
+#include <thread>
 
+#ifdef _WIN32
 #define VK_USE_PLATFORM_WIN32_KHR
+#endif
 #include <vulkan/vulkan.hpp>
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/common.hpp>
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
 #include <glm/vec4.hpp>
 #include <glm/mat4x4.hpp>
+#include <glm/gtc/matrix_transform.hpp>
 
+#ifdef _WIN32
 #include "Window.h"
-
-const int MAX_FRAMES_IN_FLIGHT = 2;
+#endif
+#include "AppConfig.h"
+#include "AssetPack.h"
+#include "FrameStats.h"
+#include "GpuProfiler.h"
+#include "JobSystem.h"
+#include "MeshLoader.h"
+#include "MemoryAllocator.h"
+#include "PipelineCache.h"
+#include "PipelineLibrary.h"
+#include "StagingUploader.h"
+#include "TimelineSemaphore.h"
+#include "UniformRing.h"
+#include "BindlessDescriptors.h"
+#include "DeletionQueue.h"
+#include "RenderGraph.h"
+#include "FrameReadback.h"
+#include "StartupProfiler.h"
+#include "Instrumentation.h"
+#include "DebugMessageSink.h"
+#include "WindowEventQueue.h"
+
+const uint32_t OFFSCREEN_IMAGE_COUNT = 3; // unless --images is given
+// objects past this many share uniform slots so huge draw counts don't need a huge uniform ring
+const uint32_t MAX_OBJECT_UNIFORMS = 65536;
+// storage buffer slots of the bindless descriptor table, clamped to the device's update-after-bind limits
+const uint32_t BINDLESS_STORAGE_BUFFERS = 1024;
+// instanced draws are split into batches of this many instances
+const uint32_t INSTANCES_PER_DRAW = 1 << 20;
 
 const std::vector<const char*> validationLayers = {
     "VK_LAYER_KHRONOS_validation"
@@ -37,6 +80,9 @@ const bool enableValidationLayers = true;
 struct QueueFamilyIndices {
     std::optional<uint32_t> graphicsFamily;
     std::optional<uint32_t> presentFamily;
+    // optional extras, left empty when the device has no such family
+    std::optional<uint32_t> transferFamily; // transfer without graphics, ideally the copy engine
+    std::optional<uint32_t> computeFamily; // compute without graphics
 
     bool isComplete() {
         return graphicsFamily.has_value() && presentFamily.has_value();
@@ -49,64 +95,423 @@ struct SwapChainSupportDetails {
     std::vector<vk::PresentModeKHR> presentModes;
 };
 
+struct Vertex {
+    glm::vec2 pos;
+    glm::vec3 color;
+
+    static vk::VertexInputBindingDescription getBindingDescription() {
+        auto bindingDescription = vk::VertexInputBindingDescription();
+        bindingDescription.binding = 0;
+        bindingDescription.stride = sizeof(Vertex);
+        bindingDescription.inputRate = vk::VertexInputRate::eVertex;
+
+        return bindingDescription;
+    }
+
+    static std::array<vk::VertexInputAttributeDescription, 2> getAttributeDescriptions() {
+        std::array<vk::VertexInputAttributeDescription, 2> attributeDescriptions;
+
+        attributeDescriptions[0].binding = 0;
+        attributeDescriptions[0].location = 0;
+        attributeDescriptions[0].format = vk::Format::eR32G32Sfloat;
+        attributeDescriptions[0].offset = offsetof(Vertex, pos);
+
+        attributeDescriptions[1].binding = 0;
+        attributeDescriptions[1].location = 1;
+        attributeDescriptions[1].format = vk::Format::eR32G32B32Sfloat;
+        attributeDescriptions[1].offset = offsetof(Vertex, color);
+
+        return attributeDescriptions;
+    }
+};
+
+/// <summary>
+/// Per-instance attributes of the instanced path, 20 bytes so ten million instances still fit in a few hundred MB
+/// </summary>
+struct InstanceData {
+    glm::vec4 placement; // x, y, rotation, scale
+    uint32_t color; // RGBA8
+
+    static vk::VertexInputBindingDescription getBindingDescription() {
+        auto bindingDescription = vk::VertexInputBindingDescription();
+        bindingDescription.binding = 1;
+        bindingDescription.stride = sizeof(InstanceData);
+        bindingDescription.inputRate = vk::VertexInputRate::eInstance;
+
+        return bindingDescription;
+    }
+
+    static std::array<vk::VertexInputAttributeDescription, 2> getAttributeDescriptions() {
+        std::array<vk::VertexInputAttributeDescription, 2> attributeDescriptions;
+
+        attributeDescriptions[0].binding = 1;
+        attributeDescriptions[0].location = 2;
+        attributeDescriptions[0].format = vk::Format::eR32G32B32A32Sfloat;
+        attributeDescriptions[0].offset = offsetof(InstanceData, placement);
+
+        attributeDescriptions[1].binding = 1;
+        attributeDescriptions[1].location = 3;
+        attributeDescriptions[1].format = vk::Format::eR8G8B8A8Unorm;
+        attributeDescriptions[1].offset = offsetof(InstanceData, color);
+
+        return attributeDescriptions;
+    }
+};
+
+/// <summary>
+/// Push constants of cull.comp, frustum planes point inwards
+/// </summary>
+struct CullPushConstants {
+    glm::vec4 planes[6];
+    uint32_t objectCount;
+    uint32_t indexCount;
+    uint32_t compact; // 1 = visible draws are packed at the front and counted for drawIndexedIndirectCount
+};
+
+struct CameraUniforms {
+    glm::mat4 viewProj;
+};
+
+struct ObjectUniforms {
+    glm::mat4 model;
+};
+
+/// <summary>
+/// Which bindless storage buffer holds the draw's transform and its index in there, the only per-draw state
+/// </summary>
+struct DrawPushConstants {
+    uint32_t transformBuffer;
+    uint32_t transformIndex;
+};
+
+const std::vector<Vertex> vertices = {
+    {{0.0f, -0.5f}, {1.0f, 0.0f, 0.0f}},
+    {{0.5f, 0.5f}, {0.0f, 1.0f, 0.0f}},
+    {{-0.5f, 0.5f}, {0.0f, 0.0f, 1.0f}}
+};
+
+const std::vector<uint16_t> indices = {
+    0, 1, 2
+};
+
 class HelloTriangleApplication {
 public:
+    /// <summary>
+    /// startupProfiler, when given, receives the duration of every init and teardown phase
+    /// </summary>
+    explicit HelloTriangleApplication(const AppConfig& config = AppConfig(), StartupProfiler* startupProfiler = nullptr)
+        : config(config), startupProfiler(startupProfiler) {}
+    /// <summary>
+    /// Owns the teardown, so a throw partway through initVulkan() or the main loop leaks nothing.
+    /// A throw out of a destructor would terminate, a failed teardown is reported instead.
+    /// </summary>
+    ~HelloTriangleApplication() {
+        StartupProfiler::Scope scope(startupProfiler, "cleanup total");
+        try {
+            cleanup();
+        }
+        catch (const std::exception& e) {
+            std::cerr << "cleanup failed: " << e.what() << std::endl;
+        }
+    }
+    HelloTriangleApplication(const HelloTriangleApplication&) = delete;
+    HelloTriangleApplication& operator=(const HelloTriangleApplication&) = delete;
+
     void run() {
-        window.create();
+        initialize();
+        if (!config.benchmark.empty()) {
+            waitForPipelines();
+        }
+
+        if (config.benchmark == "alloc") {
+            benchmarkAllocator();
+        }
+        else if (config.benchmark == "upload") {
+            benchmarkUpload();
+        }
+        else if (config.benchmark == "record") {
+            benchmarkRecording();
+        }
+        else if (config.benchmark == "instances") {
+            benchmarkInstances();
+        }
+        else if (config.benchmark == "cull") {
+            benchmarkCulling();
+        }
+        else if (config.benchmark == "pipelines") {
+            benchmarkPipelines();
+        }
+        else if (config.benchmark == "graph") {
+            benchmarkRenderGraph();
+        }
+        else {
+            mainLoop();
+        }
+    }
+
+    /// <summary>
+    /// Window and every Vulkan object the frame needs, run() starts with this
+    /// </summary>
+    void initialize() {
+        StartupProfiler::Scope scope(startupProfiler, "init total");
+        initStart = FrameStats::Clock::now();
+        if (!config.headless) {
+#ifdef _WIN32
+            initPhase("createWindow", [&]() {
+                if (window.create()) {
+                    throw std::runtime_error("failed to create window!");
+                }
+            });
+#else
+            throw std::runtime_error("windowed mode is only implemented on Windows, use --headless");
+#endif
+        }
         initVulkan();
-        mainLoop();
-        cleanup();
+        initMilliseconds = FrameStats::toMilliseconds(FrameStats::Clock::now() - initStart);
+    }
+
+    /// <summary>
+    /// Joins the pipeline build initialize() started and rethrows its failure. The first recorded frame calls this,
+    /// anything else that needs the pipelines earlier has to as well.
+    /// </summary>
+    void waitForPipelines() {
+        if (!pipelineBuild.valid()) return;
+
+        StartupProfiler::Scope scope(startupProfiler, "waitForPipelines");
+        auto waitStart = FrameStats::Clock::now();
+        pipelineBuild.get();
+        double waitMilliseconds = FrameStats::toMilliseconds(FrameStats::Clock::now() - waitStart);
+
+        std::cout << "pipeline creation: " << pipelinesCreated << " pipelines in " << pipelineBuildMilliseconds << " ms on up to "
+            << compileThreadCount() << " threads (" << (pipelineCache.isWarm() ? "warm" : "cold") << " cache), "
+            << (config.parallelInit ? "overlapped with init, waited " + std::to_string(waitMilliseconds) + " ms for it" : "serial") << std::endl;
+        if (startupProfiler) {
+            startupProfiler->addSample("compilePipelines", pipelineBuildMilliseconds);
+        }
     }
 
 private:
+    AppConfig config;
+    StartupProfiler* startupProfiler = nullptr;
+#ifdef _WIN32
     Window window;
+#endif
+    // window events on their way from the thread pumping messages to the render thread
+    WindowEventQueue windowEvents;
+    std::vector<FrameStats::Clock::time_point> pendingEventTimes; // received by the frame being drawn
+    FrameStats eventLatencyStats;
 
     vk::Instance instance;
     vk::DebugUtilsMessengerEXT debugMessenger;
+    DebugMessageSink debugMessages;
     vk::SurfaceKHR surface;
 
     vk::PhysicalDevice physicalDevice = nullptr;
     vk::Device device;
+    MemoryAllocator allocator;
+    bool physicalDeviceProperties2Supported = false;
+    bool memoryBudgetSupported = false;
+    uint32_t bindlessCapacity = 0; // 0 = no descriptor indexing, per-frame descriptor sets
 
     vk::Queue graphicsQueue;
     vk::Queue presentQueue;
+    // the graphics queue and family when there is no dedicated family or --single-queue is given
+    vk::Queue transferQueue;
+    vk::Queue computeQueue;
+    uint32_t graphicsFamily = 0;
+    uint32_t transferFamily = 0;
+    uint32_t computeFamily = 0;
 
     vk::SwapchainKHR swapChain;
     std::vector<vk::Image> swapChainImages;
     vk::Format swapChainImageFormat;
     vk::Extent2D swapChainExtent;
     std::vector<vk::ImageView> swapChainImageViews;
-    std::vector<vk::Framebuffer> swapChainFramebuffers;
 
-    vk::RenderPass renderPass;
+    // headless mode renders into these instead of swapchain images
+    std::vector<Allocation> offscreenImageMemory;
+    uint32_t nextOffscreenImage = 0;
+
+    RenderGraph renderGraph;
+    RenderGraph::ResourceId backbuffer = 0;
+    RenderGraph::PassId scenePass = 0;
+    RenderGraph::PassId readbackPass = 0;
+    vk::RenderPass renderPass; // owned by the render graph
+    vk::DescriptorSetLayout descriptorSetLayout;
+    AssetPack assets;
+    PipelineCache pipelineCache;
+    PipelineLibrary pipelineLibrary;
     vk::PipelineLayout pipelineLayout;
     vk::Pipeline graphicsPipeline;
+    vk::Pipeline instancedPipeline;
+
+    // GPU-driven path: cull.comp turns the instance field into one indirect draw per visible object
+    bool gpuCulling = false;
+    bool drawIndirectCountSupported = false;
+    uint32_t maxDrawIndirectCount = 1; // per drawIndexedIndirect call without the count extension
+    vk::DescriptorSetLayout cullDescriptorSetLayout;
+    vk::PipelineLayout cullPipelineLayout;
+    vk::Pipeline cullPipeline;
+    vk::DescriptorPool cullDescriptorPool;
+    // async compute: the cull pass runs on computeQueue and the graphics submit waits on it at the indirect stage
+    vk::CommandPool computeCommandPool;
+    std::vector<vk::CommandBuffer> computeCommandBuffers;
+    std::vector<vk::Semaphore> cullFinishedSemaphores;
+
+    /// <summary>
+    /// Written by the cull pass of one frame in flight and read by its indirect draws
+    /// </summary>
+    struct CullFrame {
+        Buffer commands;
+        Buffer drawCount; // host visible so the visible count can be read back after the fence
+        vk::DescriptorSet descriptorSet;
+    };
+    std::vector<CullFrame> cullFrames;
 
     vk::CommandPool commandPool;
     std::vector<vk::CommandBuffer> commandBuffers;
 
+    /// <summary>
+    /// Secondary command buffers of one recording thread for one frame in flight. The pool is reset as a whole
+    /// once the frame's fence has signalled, its buffers are handed out again in order.
+    /// </summary>
+    struct ThreadCommandPool {
+        vk::CommandPool pool;
+        std::vector<vk::CommandBuffer> buffers;
+        uint32_t used = 0;
+    };
+    JobSystem jobSystem;
+    GpuProfiler profiler;
+    std::vector<ThreadCommandPool> threadCommandPools; // [frame * thread count + thread]
+
+    StagingUploader uploader;
+    Buffer vertexBuffer;
+    Buffer indexBuffer;
+    uint32_t indexCount = 0;
+    vk::IndexType indexType = vk::IndexType::eUint16;
+    Buffer instanceBuffer;
+    uint32_t instanceCount = 0;
+    float cameraZoom = 1.0f;
+
+    UniformRing uniformRing;
+    uint32_t objectUniformSlots = 0;
+    vk::DescriptorPool descriptorPool;
+    vk::DescriptorSet descriptorSet;
+    BindlessDescriptors bindless;
+    uint32_t objectTransformBuffer = 0; // bindless index of the uniform ring
+    FrameStats::Clock::time_point startTime = FrameStats::Clock::now();
+
     std::vector<vk::Semaphore> imageAvailableSemaphores;
     std::vector<vk::Semaphore> renderFinishedSemaphores;
     std::vector<vk::Fence> inFlightFences;
     std::vector<vk::Fence> imagesInFlight;
+
+    // --timeline: one counter replaces inFlightFences/imagesInFlight, the binary semaphores stay for the swapchain
+    bool timelineSync = false;
+    TimelineSemaphore frameTimeline;
+    std::vector<uint64_t> frameTimelineValues; // value signalled by the last submission of each frame in flight
+    std::vector<uint64_t> imageTimelineValues; // value signalled by the last submission rendering to each image
     size_t currentFrame = 0;
+    uint64_t frameNumber = 0;
+
+    // set when acquire/present report the swapchain as out of date or suboptimal
+    bool swapChainStale = false;
+
+    // frame pacing measurements, only collected when a frame count is given
+    FrameStats fenceWaitStats;
+    FrameStats presentLatencyStats;
+    FrameStats::Clock::time_point nextFrameTime;
+    bool presentWaitSupported = false;
+    uint64_t nextPresentId = 1;
+
+    /// <summary>
+    /// Acquire time of the frame last submitted from a frame in flight slot and the present id it was presented with
+    /// </summary>
+    struct PresentTiming {
+        FrameStats::Clock::time_point acquireStart;
+        vk::SwapchainKHR swapChain;
+        uint64_t presentId = 0;
+    };
+    std::vector<PresentTiming> presentTimings;
+
+    // objects replaced at runtime, destroyed once the frames that used them have retired
+    DeletionQueue deletionQueue;
+
+    // --readback, --capture, --golden: every frame is copied out and collected framesInFlight frames later
+    FrameReadback readback;
+    bool lastFrameCaptured = false;
+    FrameReadback::ImageDiff goldenDiff;
 
     vk::DispatchLoaderDynamic dynamicDispatcher;
 
+    // pipelines compile on a worker thread from the middle of initVulkan() until the first frame is recorded
+    std::future<void> pipelineBuild;
+    uint32_t pipelinesCreated = 0;
+    double pipelineBuildMilliseconds = 0.0;
+
+    FrameStats::Clock::time_point initStart;
+    double initMilliseconds = 0.0;
+    double firstFrameMilliseconds = 0.0; // from initialize() to the first frame submitted
+
+    /// <summary>
+    /// Runs one init step, timed as a phase when a startup profiler is attached
+    /// </summary>
+    template<typename Step>
+    void initPhase(const char* name, Step step) {
+        StartupProfiler::Scope scope(startupProfiler, name);
+        step();
+    }
+
     void initVulkan() {
-        createInstance();
-        setupDebugMessenger();
-        createSurface();
-        pickPhysicalDevice();
-        createLogicalDevice();
-        createSwapChain();
-        createImageViews();
-        createRenderPass();
-        createGraphicsPipeline();
-        createFramebuffers();
-        createCommandPool();
-        createCommandBuffers();
-        createSyncObjects();
+        initPhase("openAssetPack", [&]() { openAssetPack(); });
+        initPhase("createInstance", [&]() { createInstance(); });
+        initPhase("setupDebugMessenger", [&]() { setupDebugMessenger(); });
+        if (!config.headless) {
+            initPhase("createSurface", [&]() { createSurface(); });
+        }
+        initPhase("pickPhysicalDevice", [&]() { pickPhysicalDevice(); });
+        initPhase("createLogicalDevice", [&]() { createLogicalDevice(); });
+        initPhase("createMemoryAllocator", [&]() { createMemoryAllocator(); });
+        initPhase("createPipelineCache", [&]() { createPipelineCache(); });
+        // pipelines only need the backbuffer format and the layouts, they compile while the rest is created
+        initPhase("chooseBackbufferFormat", [&]() { chooseBackbufferFormat(); });
+        initPhase("createRenderGraph", [&]() { createRenderGraph(); });
+        initPhase("createDescriptorSetLayout", [&]() { createDescriptorSetLayout(); });
+        initPhase("createPipelineLayouts", [&]() { createPipelineLayouts(); });
+        initPhase("startPipelineBuild", [&]() { startPipelineBuild(); });
+        if (config.headless) {
+            initPhase("createOffscreenImages", [&]() { createOffscreenImages(); });
+        }
+        else {
+            initPhase("createSwapChain", [&]() { createSwapChain(); });
+        }
+        initPhase("createImageViews", [&]() { createImageViews(); });
+        if (readsBack()) {
+            initPhase("createReadback", [&]() { readback.create(device, allocator, swapChainImageFormat, swapChainExtent, config.framesInFlight); });
+        }
+        initPhase("createCommandPool", [&]() { createCommandPool(); });
+        if (timelineSync) {
+            initPhase("createFrameTimeline", [&]() { frameTimeline.create(device, dynamicDispatcher); });
+        }
+        initPhase("createUploader", [&]() { createUploader(); });
+        initPhase("createGeometryBuffers", [&]() { createGeometryBuffers(); });
+        initPhase("createUniformRing", [&]() { createUniformRing(); });
+        initPhase("createDescriptorPool", [&]() { createDescriptorPool(); });
+        initPhase("createDescriptorSets", [&]() { createDescriptorSets(); });
+        if (usesGpuCulling()) {
+            initPhase("createCullDescriptorSets", [&]() { createCullDescriptorSets(); });
+            gpuCulling = config.cull;
+        }
+        if (config.instanceCount > 0) {
+            initPhase("createInstanceBuffer", [&]() { createInstanceBuffer(config.instanceCount); });
+        }
+        initPhase("createCommandBuffers", [&]() { createCommandBuffers(); });
+        if (usesGpuCulling() && computeFamily != graphicsFamily) {
+            initPhase("createComputeCommandBuffers", [&]() { createComputeCommandBuffers(); });
+        }
+        initPhase("createRecordThreads", [&]() { createRecordThreads(config.recordThreads); });
+        initPhase("createProfiler", [&]() { createProfiler(); });
+        initPhase("createSyncObjects", [&]() { createSyncObjects(); });
     }
 
     void mainLoop() {
@@ -115,44 +520,273 @@ private:
             drawFrame();
         }
         */
-        while (!window.shouldClose())
+        FrameStats frameStats;
+        frameStats.reserve(config.frameCount);
+
+        auto loopStart = FrameStats::Clock::now();
+#ifdef _WIN32
+        if (!config.headless && config.renderThread) {
+            renderOnThread(frameStats);
+        }
+        else
+#endif
         {
-            drawFrame();
-            window.pollEvents();
+            renderFrames(frameStats);
         }
         device.waitIdle();
+        finishReadback();
+
+        if (config.frameCount > 0) {
+            double wallMilliseconds = FrameStats::toMilliseconds(FrameStats::Clock::now() - loopStart);
+            std::cout << "init: " << initMilliseconds << " ms, first frame submitted after " << firstFrameMilliseconds << " ms" << std::endl;
+            frameStats.print(std::cout, config.headless ? "headless" : "windowed", wallMilliseconds);
+            fenceWaitStats.printDistribution(std::cout, "fence wait");
+            if (!config.headless) {
+                presentLatencyStats.printDistribution(std::cout, presentWaitSupported ? "acquire to displayed" : "acquire to present returned");
+            }
+        }
+        if (eventLatencyStats.count() > 0) {
+            eventLatencyStats.printDistribution(std::cout, "window event to frame submitted");
+        }
+        if (windowEvents.droppedCount() > 0) {
+            std::cout << "window events: " << windowEvents.droppedCount() << " dropped with a full queue" << std::endl;
+        }
+
+        if (profiler.isTracing()) {
+            for (uint32_t i = 0; i < config.framesInFlight; i++) {
+                profiler.collect(i);
+            }
+            profiler.printSummary(std::cout);
+            profiler.writeTrace(config.tracePath);
+        }
     }
 
-    void cleanup() {
-        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-            device.destroySemaphore(renderFinishedSemaphores[i]);
-            device.destroySemaphore(imageAvailableSemaphores[i]);
-            device.destroyFence(inFlightFences[i]);
+    /// <summary>
+    /// The frame loop, until the frame count is reached or the window closes. Pumps the window's messages itself
+    /// between frames unless they are pumped on another thread by renderOnThread().
+    /// </summary>
+    void renderFrames(FrameStats& frameStats) {
+        auto frameStart = FrameStats::Clock::now();
+        size_t framesRendered = 0;
+        nextFrameTime = FrameStats::Clock::now();
+        pendingEventTimes.reserve(WindowEventQueue::CAPACITY);
+        while (!shouldStop(framesRendered))
+        {
+            paceFrame();
+            takeWindowEvents();
+            drawFrame();
+            if (framesRendered == 0) {
+                firstFrameMilliseconds = FrameStats::toMilliseconds(FrameStats::Clock::now() - initStart);
+            }
+            auto frameEnd = FrameStats::Clock::now();
+            for (auto eventTime : pendingEventTimes) {
+                eventLatencyStats.addSample(eventTime, frameEnd);
+            }
+            pendingEventTimes.clear();
+#ifdef _WIN32
+            if (!config.headless && !config.renderThread) {
+                INSTRUMENT_ZONE("pollEvents");
+                window.pollEvents();
+            }
+#endif
+            framesRendered++;
+            if (config.frameCount > 0) {
+                frameStats.addSample(frameStart, frameEnd);
+                frameStart = frameEnd;
+            }
+        }
+    }
+
+#ifdef _WIN32
+    /// <summary>
+    /// Renders on a dedicated thread while this thread, the one that created the window, only pumps its messages.
+    /// A drag or resize holding the message pump in a modal loop no longer stops rendering and a slow frame no longer
+    /// delays input. Events reach the render thread through windowEvents, resize and close through the window's atomics.
+    /// Only the render thread touches Vulkan until it is joined.
+    /// </summary>
+    void renderOnThread(FrameStats& frameStats) {
+        std::atomic<bool> renderDone{ false };
+        std::exception_ptr renderFailure;
+        window.setEventQueue(&windowEvents);
+
+        std::thread renderThread([&]() {
+            INSTRUMENT_THREAD("render");
+            try {
+                renderFrames(frameStats);
+            }
+            catch (...) {
+                renderFailure = std::current_exception();
+            }
+            renderDone.store(true, std::memory_order_release);
+            window.wake();
+        });
+
+        while (!renderDone.load(std::memory_order_acquire)) {
+            INSTRUMENT_ZONE("waitEvents");
+            window.waitEvents();
+        }
+        renderThread.join();
+        window.setEventQueue(nullptr);
+
+        if (renderFailure) {
+            std::rethrow_exception(renderFailure);
         }
-        device.destroyCommandPool(commandPool);
+    }
+#endif
 
-        for (auto framebuffer : swapChainFramebuffers) {
-            device.destroyFramebuffer(framebuffer);
+    /// <summary>
+    /// Takes the window events that arrived since the last frame, the frame about to be drawn is the one that sees them.
+    /// Nothing in the renderer reacts to input yet, their arrival times feed the event to frame latency.
+    /// </summary>
+    void takeWindowEvents() {
+        WindowEvent event;
+        while (windowEvents.pop(event)) {
+            if (event.kind == WindowEvent::Kind::Resize) {
+                swapChainStale = true;
+            }
+            pendingEventTimes.push_back(event.time);
         }
+    }
 
-        device.destroyPipeline(graphicsPipeline);
-        device.destroyPipelineLayout(pipelineLayout);
-        device.destroyRenderPass(renderPass);
+    /// <summary>
+    /// Sleeps off whatever is left of the frame period when a frame rate cap is set. The deadline advances by whole
+    /// periods and is re-anchored when a frame ran long, so a slow frame is not followed by a burst.
+    /// </summary>
+    void paceFrame() {
+        if (config.fpsCap == 0) return;
+
+        auto period = std::chrono::duration_cast<FrameStats::Clock::duration>(std::chrono::duration<double>(1.0 / config.fpsCap));
+        std::this_thread::sleep_until(nextFrameTime);
+        auto now = FrameStats::Clock::now();
+        nextFrameTime = now - nextFrameTime > period ? now + period : nextFrameTime + period;
+    }
 
-        for (auto imageView : swapChainImageViews) {
-            device.destroyImageView(imageView);
+    bool shouldStop(size_t framesRendered) {
+        if (config.frameCount > 0 && framesRendered >= config.frameCount) {
+            return true;
+        }
+#ifdef _WIN32
+        if (!config.headless) {
+            return window.shouldClose();
+        }
+#endif
+        return false;
+    }
+
+    /// <summary>
+    /// Destroys whatever exists, in reverse creation order. Safe on a partially initialized app,
+    /// destroying a null handle is a no-op and every subsystem's destroy() tolerates never having been created.
+    /// </summary>
+    void cleanup() {
+        // each emplace ends the previous teardown phase
+        std::optional<StartupProfiler::Scope> phase;
+        if (pipelineBuild.valid()) {
+            // a failed init may never have joined the build, its failure doesn't matter any more
+            phase.emplace(startupProfiler, "joinPipelineBuild");
+            pipelineBuild.wait();
+            pipelineBuild = std::future<void>();
         }
+        if (device) {
+            phase.emplace(startupProfiler, "waitIdle");
+            // an exception may have left frames in flight, a lost device has nothing left to wait for
+            try {
+                device.waitIdle();
+            }
+            catch (const vk::SystemError&) {
+            }
+            phase.emplace(startupProfiler, "destroyFrameObjects");
+            deletionQueue.destroy();
+            readback.destroy();
 
-        device.destroySwapchainKHR(swapChain);
-        device.destroy();
+            for (auto semaphore : renderFinishedSemaphores) {
+                device.destroySemaphore(semaphore);
+            }
+            for (auto semaphore : imageAvailableSemaphores) {
+                device.destroySemaphore(semaphore);
+            }
+            for (auto fence : inFlightFences) {
+                device.destroyFence(fence);
+            }
+            frameTimeline.destroy();
+            profiler.destroy();
+            destroyRecordThreads();
+            device.destroyCommandPool(commandPool);
+            device.destroyCommandPool(computeCommandPool);
+            for (auto semaphore : cullFinishedSemaphores) {
+                device.destroySemaphore(semaphore);
+            }
 
-        if (enableValidationLayers) {
-            instance.destroyDebugUtilsMessengerEXT(debugMessenger, nullptr, dynamicDispatcher);
+            device.destroyDescriptorPool(descriptorPool);
+            uniformRing.destroy();
+
+            destroyCullBuffers();
+            device.destroyDescriptorPool(cullDescriptorPool);
+
+            allocator.destroyBuffer(instanceBuffer);
+            allocator.destroyBuffer(indexBuffer);
+            allocator.destroyBuffer(vertexBuffer);
+            uploader.destroy();
+
+            phase.emplace(startupProfiler, "destroyPipelines");
+            renderGraph.destroy();
+
+            device.destroyPipeline(cullPipeline);
+            device.destroyPipelineLayout(cullPipelineLayout);
+            device.destroyDescriptorSetLayout(cullDescriptorSetLayout);
+            pipelineLibrary.destroy();
+            device.destroyPipelineLayout(pipelineLayout);
+            device.destroyDescriptorSetLayout(descriptorSetLayout);
+            bindless.destroy();
+
+            phase.emplace(startupProfiler, "savePipelineCache");
+            try {
+                pipelineCache.save();
+            }
+            catch (const vk::SystemError& e) {
+                // a lost device can't hand out its cache, the rest of the teardown still has to run
+                std::cout << "pipeline cache: not saved (" << e.what() << ")" << std::endl;
+            }
+            pipelineCache.destroy();
+
+            phase.emplace(startupProfiler, "destroySwapChain");
+            for (auto imageView : swapChainImageViews) {
+                device.destroyImageView(imageView);
+            }
+
+            if (config.headless) {
+                for (size_t i = 0; i < offscreenImageMemory.size(); i++) {
+                    device.destroyImage(swapChainImages[i]);
+                    allocator.free(offscreenImageMemory[i]);
+                }
+            }
+            else {
+                device.destroySwapchainKHR(swapChain);
+            }
+            phase.emplace(startupProfiler, "destroyAllocator");
+            allocator.destroy();
+            phase.emplace(startupProfiler, "destroyDevice");
+            device.destroy();
+            device = nullptr;
         }
+        phase.reset();
+        assets.close();
 
-        instance.destroySurfaceKHR(surface);
-        instance.destroy();
+        if (instance) {
+            phase.emplace(startupProfiler, "destroyInstance");
+            if (debugMessenger) {
+                instance.destroyDebugUtilsMessengerEXT(debugMessenger, nullptr, dynamicDispatcher);
+            }
+            if (surface) {
+                instance.destroySurfaceKHR(surface);
+            }
+            instance.destroy();
+            instance = nullptr;
+        }
+        phase.reset();
+        debugMessages.destroy();
+#ifdef _WIN32
         window.destroy();
+#endif
     }
 
     void createInstance() {
@@ -171,11 +805,16 @@ private:
         createInfo.pApplicationInfo = &appInfo;
 
         auto extensions = getRequiredExtensions();
+        physicalDeviceProperties2Supported = checkInstanceExtensionSupport(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
+        if (physicalDeviceProperties2Supported) {
+            extensions.push_back(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
+        }
         createInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
         createInfo.ppEnabledExtensionNames = extensions.data();
 
         vk::DebugUtilsMessengerCreateInfoEXT debugCreateInfo;
         if (enableValidationLayers) {
+            debugMessages.create(std::cerr, DebugMessageSink::parseSeverity(config.debugSeverity), DebugMessageSink::parseTypes(config.debugTypes));
             createInfo.enabledLayerCount = static_cast<uint32_t>(validationLayers.size());
             createInfo.ppEnabledLayerNames = validationLayers.data();
 
@@ -195,10 +834,8 @@ private:
     }
 
     void populateDebugMessengerCreateInfo(vk::DebugUtilsMessengerCreateInfoEXT& createInfo) {
-        createInfo = vk::DebugUtilsMessengerCreateInfoEXT()
-            .setMessageSeverity(vk::DebugUtilsMessageSeverityFlagBitsEXT::eWarning | vk::DebugUtilsMessageSeverityFlagBitsEXT::eError | vk::DebugUtilsMessageSeverityFlagBitsEXT::eInfo | vk::DebugUtilsMessageSeverityFlagBitsEXT::eVerbose)
-            .setMessageType(vk::DebugUtilsMessageTypeFlagBitsEXT::eValidation | vk::DebugUtilsMessageTypeFlagBitsEXT::eGeneral | vk::DebugUtilsMessageTypeFlagBitsEXT::ePerformance)
-            .setPfnUserCallback(debugCallback);
+        createInfo = vk::DebugUtilsMessengerCreateInfoEXT();
+        debugMessages.apply(createInfo);
     }
 
     void setupDebugMessenger() {
@@ -210,10 +847,12 @@ private:
     }
 
     void createSurface() {
+#ifdef _WIN32
         auto win32SurfaceCreateInfo = vk::Win32SurfaceCreateInfoKHR()
             .setHwnd(window.getHandle())
             .setHinstance(GetModuleHandle(NULL));
         surface = instance.createWin32SurfaceKHR(win32SurfaceCreateInfo);
+#endif
     }
 
     void pickPhysicalDevice() {
@@ -230,13 +869,24 @@ private:
         if (!physicalDevice) {
             throw std::runtime_error("failed to find a suitable GPU!");
         }
+
+        if (startupProfiler) {
+            auto properties = physicalDevice.getProperties();
+            startupProfiler->setInfo("device", static_cast<const char*>(properties.deviceName));
+            startupProfiler->setInfo("driverVersion", std::to_string(properties.driverVersion));
+            startupProfiler->setInfo("apiVersion", std::to_string(VK_VERSION_MAJOR(properties.apiVersion)) + "." +
+                std::to_string(VK_VERSION_MINOR(properties.apiVersion)) + "." + std::to_string(VK_VERSION_PATCH(properties.apiVersion)));
+        }
     }
 
     void createLogicalDevice() {
         QueueFamilyIndices indices = findQueueFamilies(physicalDevice);
 
         std::vector<vk::DeviceQueueCreateInfo> queueCreateInfos;
-        std::set<uint32_t> uniqueQueueFamilies = { indices.graphicsFamily.value(), indices.presentFamily.value() };
+        graphicsFamily = indices.graphicsFamily.value();
+        transferFamily = config.asyncQueues ? indices.transferFamily.value_or(graphicsFamily) : graphicsFamily;
+        computeFamily = config.asyncQueues && usesGpuCulling() ? indices.computeFamily.value_or(graphicsFamily) : graphicsFamily;
+        std::set<uint32_t> uniqueQueueFamilies = { graphicsFamily, indices.presentFamily.value(), transferFamily, computeFamily };
 
         float queuePriority = 1.0f;
         for (uint32_t queueFamily : uniqueQueueFamilies) {
@@ -248,15 +898,88 @@ private:
         }
 
         auto deviceFeatures = vk::PhysicalDeviceFeatures();
+        if (usesGpuCulling()) {
+            // one indirect command per object, each starting at its own instance
+            auto supportedFeatures = physicalDevice.getFeatures();
+            if (!supportedFeatures.multiDrawIndirect || !supportedFeatures.drawIndirectFirstInstance) {
+                throw std::runtime_error("GPU culling needs multiDrawIndirect and drawIndirectFirstInstance!");
+            }
+            deviceFeatures.multiDrawIndirect = VK_TRUE;
+            deviceFeatures.drawIndirectFirstInstance = VK_TRUE;
+        }
 
         auto createInfo = vk::DeviceCreateInfo()
     		.setQueueCreateInfos(queueCreateInfos)
     		.setPEnabledFeatures(&deviceFeatures);
+
+#ifdef VK_KHR_present_wait
+        // present ids and present wait give real acquire-to-display latency, both features have to be on
+        auto presentIdFeatures = vk::PhysicalDevicePresentIdFeaturesKHR();
+        auto presentWaitFeatures = vk::PhysicalDevicePresentWaitFeaturesKHR();
+        presentWaitSupported = !config.headless && physicalDeviceProperties2Supported &&
+            checkDeviceExtensionSupport(physicalDevice, VK_KHR_PRESENT_ID_EXTENSION_NAME) &&
+            checkDeviceExtensionSupport(physicalDevice, VK_KHR_PRESENT_WAIT_EXTENSION_NAME);
+        if (presentWaitSupported) {
+            auto features = physicalDevice.getFeatures2KHR<vk::PhysicalDeviceFeatures2, vk::PhysicalDevicePresentIdFeaturesKHR, vk::PhysicalDevicePresentWaitFeaturesKHR>(dynamicDispatcher);
+            presentWaitSupported = features.get<vk::PhysicalDevicePresentIdFeaturesKHR>().presentId &&
+                features.get<vk::PhysicalDevicePresentWaitFeaturesKHR>().presentWait;
+        }
+        if (presentWaitSupported) {
+            presentIdFeatures.presentId = VK_TRUE;
+            presentIdFeatures.pNext = &presentWaitFeatures;
+            presentWaitFeatures.presentWait = VK_TRUE;
+            createInfo.pNext = &presentIdFeatures;
+        }
+#endif
         
         createInfo.pEnabledFeatures = &deviceFeatures;
 
-        createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
-        createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+        timelineSync = config.timeline && isTimelineSemaphoreSupported();
+        if (config.timeline && !timelineSync) {
+            std::cout << "timeline semaphores not supported, synchronizing with fences" << std::endl;
+        }
+
+        auto extensions = getRequiredDeviceExtensions();
+        memoryBudgetSupported = physicalDeviceProperties2Supported && checkDeviceExtensionSupport(physicalDevice, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+        if (memoryBudgetSupported) {
+            extensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+        }
+        auto timelineFeatures = vk::PhysicalDeviceTimelineSemaphoreFeaturesKHR();
+        if (timelineSync) {
+            extensions.push_back(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME);
+            timelineFeatures.timelineSemaphore = VK_TRUE;
+            timelineFeatures.pNext = const_cast<void*>(createInfo.pNext);
+            createInfo.pNext = &timelineFeatures;
+        }
+#ifdef VK_KHR_present_wait
+        if (presentWaitSupported) {
+            extensions.push_back(VK_KHR_PRESENT_ID_EXTENSION_NAME);
+            extensions.push_back(VK_KHR_PRESENT_WAIT_EXTENSION_NAME);
+        }
+#endif
+        auto indexingFeatures = vk::PhysicalDeviceDescriptorIndexingFeaturesEXT();
+        bindlessCapacity = config.bindless ? queryBindlessCapacity() : 0;
+        if (bindlessCapacity > 0) {
+            extensions.push_back(VK_KHR_MAINTENANCE3_EXTENSION_NAME);
+            extensions.push_back(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+            indexingFeatures.runtimeDescriptorArray = VK_TRUE;
+            indexingFeatures.descriptorBindingStorageBufferUpdateAfterBind = VK_TRUE;
+            indexingFeatures.descriptorBindingPartiallyBound = VK_TRUE;
+            indexingFeatures.descriptorBindingVariableDescriptorCount = VK_TRUE;
+            deviceFeatures.shaderStorageBufferArrayDynamicIndexing = VK_TRUE;
+            indexingFeatures.pNext = const_cast<void*>(createInfo.pNext);
+            createInfo.pNext = &indexingFeatures;
+        }
+        else if (config.bindless) {
+            std::cout << "descriptor indexing not supported, rewriting descriptor sets every frame" << std::endl;
+        }
+        drawIndirectCountSupported = usesGpuCulling() && checkDeviceExtensionSupport(physicalDevice, VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+        if (drawIndirectCountSupported) {
+            extensions.push_back(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+        }
+        maxDrawIndirectCount = physicalDevice.getProperties().limits.maxDrawIndirectCount;
+        createInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
+        createInfo.ppEnabledExtensionNames = extensions.data();
 
         if (enableValidationLayers) {
             createInfo.setPEnabledLayerNames(validationLayers);
@@ -267,18 +990,82 @@ private:
 
         device = physicalDevice.createDevice(createInfo);
 
-        graphicsQueue = device.getQueue(indices.graphicsFamily.value(), 0);
+        graphicsQueue = device.getQueue(graphicsFamily, 0);
         presentQueue = device.getQueue(indices.presentFamily.value(), 0);
+        transferQueue = device.getQueue(transferFamily, 0);
+        computeQueue = device.getQueue(computeFamily, 0);
+        if (transferFamily != graphicsFamily) {
+            std::cout << "uploads on dedicated transfer queue family " << transferFamily << std::endl;
+        }
+        if (computeFamily != graphicsFamily) {
+            std::cout << "culling on async compute queue family " << computeFamily << std::endl;
+        }
     }
 
-    void createSwapChain() {
+    bool isTimelineSemaphoreSupported() {
+        if (!physicalDeviceProperties2Supported || !checkDeviceExtensionSupport(physicalDevice, VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME)) {
+            return false;
+        }
+        auto features = physicalDevice.getFeatures2KHR<vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceTimelineSemaphoreFeaturesKHR>(dynamicDispatcher);
+        return features.get<vk::PhysicalDeviceTimelineSemaphoreFeaturesKHR>().timelineSemaphore;
+    }
+
+    /// <summary>
+    /// Storage buffer slots the bindless table can have on this device, 0 when descriptor indexing can't back it
+    /// </summary>
+    uint32_t queryBindlessCapacity() {
+        if (!physicalDeviceProperties2Supported || !checkDeviceExtensionSupport(physicalDevice, VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME) ||
+            !checkDeviceExtensionSupport(physicalDevice, VK_KHR_MAINTENANCE3_EXTENSION_NAME)) {
+            return 0;
+        }
+        auto features = physicalDevice.getFeatures2KHR<vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceDescriptorIndexingFeaturesEXT>(dynamicDispatcher);
+        auto& indexing = features.get<vk::PhysicalDeviceDescriptorIndexingFeaturesEXT>();
+        // the bindless vertex shader picks its transform buffer from the table by a push constant index
+        if (!features.get<vk::PhysicalDeviceFeatures2>().features.shaderStorageBufferArrayDynamicIndexing ||
+            !indexing.runtimeDescriptorArray || !indexing.descriptorBindingStorageBufferUpdateAfterBind ||
+            !indexing.descriptorBindingPartiallyBound || !indexing.descriptorBindingVariableDescriptorCount) {
+            return 0;
+        }
+        auto properties = physicalDevice.getProperties2KHR<vk::PhysicalDeviceProperties2, vk::PhysicalDeviceDescriptorIndexingPropertiesEXT>(dynamicDispatcher);
+        auto& limits = properties.get<vk::PhysicalDeviceDescriptorIndexingPropertiesEXT>();
+        return std::min({ BINDLESS_STORAGE_BUFFERS, limits.maxDescriptorSetUpdateAfterBindStorageBuffers,
+            limits.maxPerStageDescriptorUpdateAfterBindStorageBuffers });
+    }
+
+    void createMemoryAllocator() {
+        allocator.create(physicalDevice, device, memoryBudgetSupported, dynamicDispatcher);
+        deletionQueue.create(device, allocator);
+    }
+
+    /// <summary>
+    /// Shaders and meshes come from the mapped pack when there is one, hashes are checked in debug builds
+    /// </summary>
+    void openAssetPack() {
+        if (config.assetPackPath.empty()) return;
+
+        if (assets.open(config.assetPackPath, enableValidationLayers)) {
+            std::cout << "asset pack: " << assets.getEntryCount() << " assets mapped from " << config.assetPackPath << std::endl;
+        }
+        else {
+            std::cout << "asset pack: " << config.assetPackPath << " not available, loading loose files" << std::endl;
+        }
+    }
+
+    void createPipelineCache() {
+        pipelineCache.create(device, physicalDevice.getProperties(), config.pipelineCachePath);
+    }
+
+    void createSwapChain(vk::SwapchainKHR oldSwapChain = nullptr) {
+#ifdef _WIN32
+        window.getSize(); // the new swapchain matches the current size, drop any pending resize
+#endif
         SwapChainSupportDetails swapChainSupport = querySwapChainSupport(physicalDevice);
 
         vk::SurfaceFormatKHR surfaceFormat = chooseSwapSurfaceFormat(swapChainSupport.formats);
         vk::PresentModeKHR presentMode = chooseSwapPresentMode(swapChainSupport.presentModes);
         vk::Extent2D extent = chooseSwapExtent(swapChainSupport.capabilities);
 
-        uint32_t imageCount = swapChainSupport.capabilities.minImageCount + 1;
+        uint32_t imageCount = config.imageCount > 0 ? std::max(config.imageCount, swapChainSupport.capabilities.minImageCount) : swapChainSupport.capabilities.minImageCount + 1;
         if (swapChainSupport.capabilities.maxImageCount > 0 && imageCount > swapChainSupport.capabilities.maxImageCount) {
             imageCount = swapChainSupport.capabilities.maxImageCount;
         }
@@ -292,6 +1079,12 @@ private:
         createInfo.imageExtent = extent;
         createInfo.imageArrayLayers = 1;
         createInfo.imageUsage = vk::ImageUsageFlagBits::eColorAttachment;
+        if (readsBack()) {
+            if (!(swapChainSupport.capabilities.supportedUsageFlags & vk::ImageUsageFlagBits::eTransferSrc)) {
+                throw std::runtime_error("swapchain images can't be copied from, readback needs --headless!");
+            }
+            createInfo.imageUsage |= vk::ImageUsageFlagBits::eTransferSrc;
+        }
 
         QueueFamilyIndices indices = findQueueFamilies(physicalDevice);
         uint32_t queueFamilyIndices[] = { indices.graphicsFamily.value(), indices.presentFamily.value() };
@@ -310,7 +1103,7 @@ private:
         createInfo.presentMode = presentMode;
         createInfo.clipped = VK_TRUE;
 
-        createInfo.oldSwapchain = nullptr;
+        createInfo.oldSwapchain = oldSwapChain;
 
         swapChain = device.createSwapchainKHR(createInfo);
 
@@ -320,6 +1113,42 @@ private:
         swapChainExtent = extent;
     }
 
+    /// <summary>
+    /// The format createSwapChain() will pick, or the offscreen one, known before any image exists
+    /// </summary>
+    void chooseBackbufferFormat() {
+        if (config.headless) {
+            swapChainImageFormat = vk::Format::eR8G8B8A8Unorm;
+            return;
+        }
+        swapChainImageFormat = chooseSwapSurfaceFormat(querySwapChainSupport(physicalDevice).formats).format;
+    }
+
+    void createOffscreenImages() {
+        swapChainExtent = vk::Extent2D(config.width, config.height);
+
+        uint32_t imageCount = config.imageCount > 0 ? config.imageCount : OFFSCREEN_IMAGE_COUNT;
+        swapChainImages.resize(imageCount);
+        offscreenImageMemory.resize(imageCount);
+
+        for (uint32_t i = 0; i < imageCount; i++) {
+            auto imageInfo = vk::ImageCreateInfo();
+            imageInfo.imageType = vk::ImageType::e2D;
+            imageInfo.format = swapChainImageFormat;
+            imageInfo.extent = vk::Extent3D(swapChainExtent.width, swapChainExtent.height, 1);
+            imageInfo.mipLevels = 1;
+            imageInfo.arrayLayers = 1;
+            imageInfo.samples = vk::SampleCountFlagBits::e1;
+            imageInfo.tiling = vk::ImageTiling::eOptimal;
+            imageInfo.usage = vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eTransferSrc;
+            imageInfo.sharingMode = vk::SharingMode::eExclusive;
+            imageInfo.initialLayout = vk::ImageLayout::eUndefined;
+
+            swapChainImages[i] = device.createImage(imageInfo);
+            offscreenImageMemory[i] = allocator.allocateForImage(swapChainImages[i], imageInfo.tiling, vk::MemoryPropertyFlagBits::eDeviceLocal);
+        }
+    }
+
     void createImageViews() {
         swapChainImageViews.resize(swapChainImages.size());
 
@@ -342,233 +1171,858 @@ private:
         }
     }
 
-    void createRenderPass() {
-        auto colorAttachment = vk::AttachmentDescription();
-        colorAttachment.format = swapChainImageFormat;
-        colorAttachment.samples = vk::SampleCountFlagBits::e1;
-        colorAttachment.loadOp = vk::AttachmentLoadOp::eClear;
-        colorAttachment.storeOp = vk::AttachmentStoreOp::eStore;
-        colorAttachment.stencilLoadOp = vk::AttachmentLoadOp::eDontCare;
-        colorAttachment.stencilStoreOp = vk::AttachmentStoreOp::eDontCare;
-        colorAttachment.initialLayout = vk::ImageLayout::eUndefined;
-        colorAttachment.finalLayout = vk::ImageLayout::ePresentSrcKHR;
-
-        auto colorAttachmentRef = vk::AttachmentReference();
-        colorAttachmentRef.attachment = 0;
-        colorAttachmentRef.layout = vk::ImageLayout::eColorAttachmentOptimal;
-
-        auto subpass = vk::SubpassDescription();
-        subpass.pipelineBindPoint = vk::PipelineBindPoint::eGraphics;
-        subpass.colorAttachmentCount = 1;
-        subpass.pColorAttachments = &colorAttachmentRef;
-
-        auto dependency = vk::SubpassDependency();
-        dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
-        dependency.dstSubpass = 0;
-        dependency.srcStageMask = vk::PipelineStageFlagBits::eColorAttachmentOutput;
-        dependency.dstStageMask = vk::PipelineStageFlagBits::eColorAttachmentOutput;
-        dependency.dstAccessMask = vk::AccessFlagBits::eColorAttachmentWrite;
-
-        auto renderPassInfo = vk::RenderPassCreateInfo();
-        renderPassInfo.attachmentCount = 1;
-        renderPassInfo.pAttachments = &colorAttachment;
-        renderPassInfo.subpassCount = 1;
-        renderPassInfo.pSubpasses = &subpass;
-        renderPassInfo.dependencyCount = 1;
-        renderPassInfo.pDependencies = &dependency;
-
-        renderPass = device.createRenderPass(renderPassInfo);
-    }
-
-    void createGraphicsPipeline() {
-        auto vertShaderCode = readFile("shaders/vert.spv");
-        auto fragShaderCode = readFile("shaders/frag.spv");
-
-        vk::ShaderModule vertShaderModule = createShaderModule(vertShaderCode);
-        vk::ShaderModule fragShaderModule = createShaderModule(fragShaderCode);
-
-        auto vertShaderStageInfo = vk::PipelineShaderStageCreateInfo();
-        vertShaderStageInfo.stage = vk::ShaderStageFlagBits::eVertex;
-        vertShaderStageInfo.module = vertShaderModule;
-        vertShaderStageInfo.pName = "main";
-
-        auto fragShaderStageInfo = vk::PipelineShaderStageCreateInfo();
-        fragShaderStageInfo.stage = vk::ShaderStageFlagBits::eFragment;
-        fragShaderStageInfo.module = fragShaderModule;
-        fragShaderStageInfo.pName = "main";
-
-        vk::PipelineShaderStageCreateInfo shaderStages[] = { vertShaderStageInfo, fragShaderStageInfo };
-
-        auto vertexInputInfo = vk::PipelineVertexInputStateCreateInfo();
-        vertexInputInfo.vertexBindingDescriptionCount = 0;
-        vertexInputInfo.vertexAttributeDescriptionCount = 0;
-
-        auto inputAssembly = vk::PipelineInputAssemblyStateCreateInfo();
-        inputAssembly.topology = vk::PrimitiveTopology::eTriangleList;
-        inputAssembly.primitiveRestartEnable = VK_FALSE;
-
-        auto viewport = vk::Viewport();
-        viewport.x = 0.0f;
-        viewport.y = 0.0f;
-        viewport.width = (float)swapChainExtent.width;
-        viewport.height = (float)swapChainExtent.height;
-        viewport.minDepth = 0.0f;
-        viewport.maxDepth = 1.0f;
-
-        auto scissor = vk::Rect2D();
-        scissor.setOffset({ 0, 0 });
-        scissor.extent = swapChainExtent;
-
-        auto viewportState = vk::PipelineViewportStateCreateInfo();
-        viewportState.viewportCount = 1;
-        viewportState.pViewports = &viewport;
-        viewportState.scissorCount = 1;
-        viewportState.pScissors = &scissor;
-
-        auto rasterizer = vk::PipelineRasterizationStateCreateInfo();
-        rasterizer.depthClampEnable = VK_FALSE;
-        rasterizer.rasterizerDiscardEnable = VK_FALSE;
-        rasterizer.polygonMode = vk::PolygonMode::eFill;
-        rasterizer.lineWidth = 1.0f;
-        rasterizer.cullMode = vk::CullModeFlagBits::eBack;
-        rasterizer.frontFace = vk::FrontFace::eClockwise;
-        rasterizer.depthBiasEnable = VK_FALSE;
-
-        auto multisampling = vk::PipelineMultisampleStateCreateInfo();
-        multisampling.sampleShadingEnable = VK_FALSE;
-        multisampling.rasterizationSamples = vk::SampleCountFlagBits::e1;
-
-        auto colorBlendAttachment = vk::PipelineColorBlendAttachmentState();
-        colorBlendAttachment.colorWriteMask = vk::ColorComponentFlagBits::eR | vk::ColorComponentFlagBits::eG | vk::ColorComponentFlagBits::eB | vk::ColorComponentFlagBits::eA;
-        colorBlendAttachment.blendEnable = VK_FALSE;
-
-        auto colorBlending = vk::PipelineColorBlendStateCreateInfo();
-        colorBlending.logicOpEnable = VK_FALSE;
-        colorBlending.logicOp = vk::LogicOp::eCopy;
-        colorBlending.attachmentCount = 1;
-        colorBlending.pAttachments = &colorBlendAttachment;
-        colorBlending.blendConstants[0] = 0.0f;
-        colorBlending.blendConstants[1] = 0.0f;
-        colorBlending.blendConstants[2] = 0.0f;
-        colorBlending.blendConstants[3] = 0.0f;
+    /// <summary>
+    /// The frame is a render graph with a single scene pass drawing into the swapchain (or offscreen) image,
+    /// the graph derives the layout transitions and owns the render pass the pipelines are created against.
+    /// With readback a transfer pass copies the finished image out before it is presented.
+    /// </summary>
+    void createRenderGraph() {
+        renderGraph.create(device, allocator);
+        backbuffer = renderGraph.importImage("backbuffer", swapChainImageFormat, vk::ImageLayout::eUndefined,
+            vk::PipelineStageFlagBits::eColorAttachmentOutput, config.headless ? vk::ImageLayout::eTransferSrcOptimal : vk::ImageLayout::ePresentSrcKHR);
+
+        std::array<float, 4> clearColor = { 0.0f, 0.0f, 0.0f, 1.0f };
+        scenePass = renderGraph.addPass("scene");
+        renderGraph.addColorOutput(scenePass, backbuffer, &clearColor);
+
+        if (readsBack()) {
+            readbackPass = renderGraph.addPass("readback");
+            renderGraph.addTransferInput(readbackPass, backbuffer);
+            renderGraph.setSideEffect(readbackPass);
+        }
+
+        renderGraph.compile();
+        renderPass = renderGraph.getRenderPass(scenePass);
+    }
+
+    /// <summary>
+    /// Set 0 is the camera in the uniform ring, selected with a dynamic offset. Set 1 holds the bindless storage buffers.
+    /// </summary>
+    void createDescriptorSetLayout() {
+        auto binding = vk::DescriptorSetLayoutBinding();
+        binding.binding = 0;
+        binding.descriptorType = vk::DescriptorType::eUniformBufferDynamic;
+        binding.descriptorCount = 1;
+        binding.stageFlags = vk::ShaderStageFlagBits::eVertex;
+
+        auto layoutInfo = vk::DescriptorSetLayoutCreateInfo();
+        layoutInfo.bindingCount = 1;
+        layoutInfo.pBindings = &binding;
+
+        descriptorSetLayout = device.createDescriptorSetLayout(layoutInfo);
+
+        bindless.create(device, config.framesInFlight, vk::ShaderStageFlagBits::eVertex, bindlessCapacity);
+        if (bindless.isBindless()) {
+            std::cout << "bindless descriptor table with " << bindless.getCapacity() << " storage buffer slots" << std::endl;
+        }
+    }
+
+    /// <summary>
+    /// Layouts of the graphics and cull pipelines, created up front because descriptor sets are allocated against them
+    /// while the pipelines still compile
+    /// </summary>
+    void createPipelineLayouts() {
+        std::array<vk::DescriptorSetLayout, 2> setLayouts = { descriptorSetLayout, bindless.getLayout() };
+        auto pushConstantRange = vk::PushConstantRange(vk::ShaderStageFlagBits::eVertex, 0, sizeof(DrawPushConstants));
 
         auto pipelineLayoutInfo = vk::PipelineLayoutCreateInfo();
-        pipelineLayoutInfo.setLayoutCount = 0;
-        pipelineLayoutInfo.pushConstantRangeCount = 0;
+        pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(setLayouts.size());
+        pipelineLayoutInfo.pSetLayouts = setLayouts.data();
+        pipelineLayoutInfo.pushConstantRangeCount = 1;
+        pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
 
         pipelineLayout = device.createPipelineLayout(pipelineLayoutInfo);
+        pipelineLibrary.create(device, pipelineCache.get());
+        pipelineLibrary.setAssetPack(&assets);
 
-        auto pipelineInfo = vk::GraphicsPipelineCreateInfo();
-        pipelineInfo.stageCount = 2;
-        pipelineInfo.pStages = shaderStages;
-        pipelineInfo.pVertexInputState = &vertexInputInfo;
-        pipelineInfo.pInputAssemblyState = &inputAssembly;
-        pipelineInfo.pViewportState = &viewportState;
-        pipelineInfo.pRasterizationState = &rasterizer;
-        pipelineInfo.pMultisampleState = &multisampling;
-        pipelineInfo.pColorBlendState = &colorBlending;
-        pipelineInfo.layout = pipelineLayout;
-        pipelineInfo.renderPass = renderPass;
-        pipelineInfo.subpass = 0;
-        pipelineInfo.basePipelineHandle = nullptr;
-
-        graphicsPipeline = device.createGraphicsPipeline(nullptr, pipelineInfo).value;
-        device.destroyShaderModule(fragShaderModule);
-        device.destroyShaderModule(vertShaderModule);
-    }
-
-    void createFramebuffers() {
-        swapChainFramebuffers.resize(swapChainImageViews.size());
-
-        for (size_t i = 0; i < swapChainImageViews.size(); i++) {
-            vk::ImageView attachments[] = {
-                swapChainImageViews[i]
-            };
+        if (usesGpuCulling()) {
+            createCullPipelineLayout();
+        }
+    }
+
+    uint32_t compileThreadCount() const {
+        return config.parallelInit ? std::max(1u, std::thread::hardware_concurrency()) : 1;
+    }
+
+    /// <summary>
+    /// Compiles the graphics pipelines and the cull pipeline on worker threads, waitForPipelines() joins them.
+    /// The descriptions are taken here, the worker reads nothing the main thread goes on to change.
+    /// With --serial-init everything compiles right here, one batch after the other.
+    /// </summary>
+    void startPipelineBuild() {
+        bool instanced = config.instanceCount > 0 || config.benchmark == "instances" || usesGpuCulling();
+        std::vector<PipelineDesc> descs = { objectPipelineDesc() };
+        if (instanced) {
+            descs.push_back(instancedPipelineDesc());
+        }
+
+        auto build = [this, descs]() {
+            auto compileStart = FrameStats::Clock::now();
+            std::future<void> cull;
+            if (usesGpuCulling()) {
+                cull = std::async(config.parallelInit ? std::launch::async : std::launch::deferred, [this]() { createComputePipeline(); });
+            }
+
+            for (const auto& desc : descs) {
+                pipelineLibrary.request(desc);
+            }
+            pipelinesCreated = pipelineLibrary.build(compileThreadCount());
+            graphicsPipeline = pipelineLibrary.get(descs[0]);
+            if (descs.size() > 1) {
+                instancedPipeline = pipelineLibrary.get(descs[1]);
+            }
+
+            if (cull.valid()) cull.get();
+            pipelineBuildMilliseconds = FrameStats::toMilliseconds(FrameStats::Clock::now() - compileStart);
+        };
+
+        if (config.parallelInit) {
+            pipelineBuild = std::async(std::launch::async, build);
+        }
+        else {
+            pipelineBuild = std::async(std::launch::deferred, build);
+            pipelineBuild.wait();
+        }
+    }
+
+    /// <summary>
+    /// Fixed function state shared by every pipeline of the render pass, variants change the vertex stage,
+    /// the specialization constants of frag.spv or the blend and raster state
+    /// </summary>
+    PipelineDesc basePipelineDesc(const std::string& vertShaderPath) {
+        PipelineDesc desc;
+        desc.vertexShader = vertShaderPath;
+        desc.fragmentShader = "shaders/frag.spv";
+        desc.layout = pipelineLayout;
+        desc.renderPass = renderPass;
+        desc.subpass = 0;
+        desc.colorFormats = { swapChainImageFormat };
+        desc.samples = vk::SampleCountFlagBits::e1;
+        return desc;
+    }
+
+    PipelineDesc objectPipelineDesc() {
+        PipelineDesc desc = basePipelineDesc(bindless.isBindless() ? "shaders/vert_bindless.spv" : "shaders/vert.spv");
+        auto attributeDescriptions = Vertex::getAttributeDescriptions();
+        desc.bindings = { Vertex::getBindingDescription() };
+        desc.attributes.assign(attributeDescriptions.begin(), attributeDescriptions.end());
+        return desc;
+    }
 
-            auto framebufferInfo = vk::FramebufferCreateInfo();
-            framebufferInfo.renderPass = renderPass;
-            framebufferInfo.attachmentCount = 1;
-            framebufferInfo.pAttachments = attachments;
-            framebufferInfo.width = swapChainExtent.width;
-            framebufferInfo.height = swapChainExtent.height;
-            framebufferInfo.layers = 1;
+    /// <summary>
+    /// Per-vertex Vertex data in binding 0 and per-instance InstanceData in binding 1
+    /// </summary>
+    PipelineDesc instancedPipelineDesc() {
+        PipelineDesc desc = basePipelineDesc("shaders/instanced_vert.spv");
+        auto vertexAttributes = Vertex::getAttributeDescriptions();
+        auto instanceAttributes = InstanceData::getAttributeDescriptions();
+
+        desc.bindings = { Vertex::getBindingDescription(), InstanceData::getBindingDescription() };
+        desc.attributes.assign(vertexAttributes.begin(), vertexAttributes.end());
+        desc.attributes.insert(desc.attributes.end(), instanceAttributes.begin(), instanceAttributes.end());
+        return desc;
+    }
+
+    bool usesGpuCulling() const {
+        return config.cull || config.benchmark == "cull";
+    }
 
-            swapChainFramebuffers[i] = device.createFramebuffer(framebufferInfo);
+    /// <summary>
+    /// cull.comp reads the instance buffer and writes the indirect commands and draw count of one frame in flight
+    /// </summary>
+    void createCullPipelineLayout() {
+        std::array<vk::DescriptorSetLayoutBinding, 3> bindings;
+        for (uint32_t i = 0; i < bindings.size(); i++) {
+            bindings[i].binding = i;
+            bindings[i].descriptorType = vk::DescriptorType::eStorageBuffer;
+            bindings[i].descriptorCount = 1;
+            bindings[i].stageFlags = vk::ShaderStageFlagBits::eCompute;
         }
+
+        auto layoutInfo = vk::DescriptorSetLayoutCreateInfo();
+        layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+        layoutInfo.pBindings = bindings.data();
+        cullDescriptorSetLayout = device.createDescriptorSetLayout(layoutInfo);
+
+        auto pushConstantRange = vk::PushConstantRange(vk::ShaderStageFlagBits::eCompute, 0, sizeof(CullPushConstants));
+        auto pipelineLayoutInfo = vk::PipelineLayoutCreateInfo();
+        pipelineLayoutInfo.setLayoutCount = 1;
+        pipelineLayoutInfo.pSetLayouts = &cullDescriptorSetLayout;
+        pipelineLayoutInfo.pushConstantRangeCount = 1;
+        pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+        cullPipelineLayout = device.createPipelineLayout(pipelineLayoutInfo);
+    }
+
+    /// <summary>
+    /// Runs on the pipeline build thread, everything it touches besides cullPipeline is read only by then
+    /// </summary>
+    void createComputePipeline() {
+        vk::ShaderModule computeShaderModule = loadShaderModule("shaders/cull.spv");
+
+        auto pipelineInfo = vk::ComputePipelineCreateInfo();
+        pipelineInfo.stage.stage = vk::ShaderStageFlagBits::eCompute;
+        pipelineInfo.stage.module = computeShaderModule;
+        pipelineInfo.stage.pName = "main";
+        pipelineInfo.layout = cullPipelineLayout;
+
+        cullPipeline = device.createComputePipeline(pipelineCache.get(), pipelineInfo).value;
+        device.destroyShaderModule(computeShaderModule);
     }
 
     void createCommandPool() {
         QueueFamilyIndices queueFamilyIndices = findQueueFamilies(physicalDevice);
 
         auto poolInfo = vk::CommandPoolCreateInfo();
+        poolInfo.flags = vk::CommandPoolCreateFlagBits::eResetCommandBuffer;
         poolInfo.queueFamilyIndex = queueFamilyIndices.graphicsFamily.value();
 
         commandPool = device.createCommandPool(poolInfo);
     }
 
-    void createCommandBuffers() {
-        commandBuffers.resize(swapChainFramebuffers.size());
+    /// <summary>
+    /// Copies run on the transfer queue, exclusive buffers are handed over to the graphics family after each flush
+    /// </summary>
+    void createUploader() {
+        uploader.create(device, allocator, transferQueue, transferFamily);
+        uploader.setOwner(graphicsQueue, graphicsFamily);
+        if (timelineSync) {
+            uploader.setTimeline(&frameTimeline);
+        }
+    }
 
-        auto allocInfo = vk::CommandBufferAllocateInfo();
-        allocInfo.commandPool = commandPool;
-        allocInfo.level = vk::CommandBufferLevel::ePrimary;
-        allocInfo.commandBufferCount = static_cast<uint32_t>(commandBuffers.size());
+    /// <summary>
+    /// Vertex and index data go through the staging buffer together and land in device local memory with one submission.
+    /// A --mesh is copied into the staging buffer straight from the asset pack mapping, a --mesh-file is imported first.
+    /// </summary>
+    void createGeometryBuffers() {
+        const void* vertexData = vertices.data();
+        vk::DeviceSize vertexBufferSize = sizeof(vertices[0]) * vertices.size();
+        const void* indexData = indices.data();
+        vk::DeviceSize indexBufferSize = sizeof(indices[0]) * indices.size();
+        indexCount = static_cast<uint32_t>(indices.size());
+        indexType = vk::IndexType::eUint16;
+
+        if (!config.meshName.empty()) {
+            static_assert(sizeof(Vertex) == sizeof(FlatVertex), "the asset packer bakes meshes as FlatVertex");
+            AssetView meshVertices = assets.find("meshes/" + config.meshName + ".vertices");
+            AssetView meshIndices = assets.find("meshes/" + config.meshName + ".indices");
+            if (!meshVertices || !meshIndices || meshVertices.size % sizeof(Vertex) != 0 || meshIndices.size % sizeof(uint32_t) != 0) {
+                throw std::runtime_error("mesh " + config.meshName + " is not in the asset pack!");
+            }
+            vertexData = meshVertices.data;
+            vertexBufferSize = meshVertices.size;
+            indexData = meshIndices.data;
+            indexBufferSize = meshIndices.size;
+            indexCount = static_cast<uint32_t>(meshIndices.size / sizeof(uint32_t));
+            indexType = vk::IndexType::eUint32;
+        }
 
-        commandBuffers = device.allocateCommandBuffers(allocInfo);
+        std::vector<Vertex> importedVertices;
+        Mesh imported;
+        if (!config.meshFile.empty()) {
+            imported = importMesh(config.meshFile, importedVertices);
+            vertexData = importedVertices.data();
+            vertexBufferSize = sizeof(Vertex) * importedVertices.size();
+            indexData = imported.indices.data();
+            indexBufferSize = sizeof(uint32_t) * imported.indices.size();
+            indexCount = static_cast<uint32_t>(imported.indices.size());
+            indexType = vk::IndexType::eUint32;
+        }
 
-        for (size_t i = 0; i < commandBuffers.size(); i++) {
-            auto beginInfo = vk::CommandBufferBeginInfo();
-            commandBuffers[i].begin(beginInfo);
+        vertexBuffer = allocator.createBuffer(vertexBufferSize, vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eVertexBuffer, vk::MemoryPropertyFlagBits::eDeviceLocal);
+        uploader.upload(vertexBuffer.buffer, 0, vertexData, vertexBufferSize);
 
-            auto renderPassInfo = vk::RenderPassBeginInfo();
-            renderPassInfo.renderPass = renderPass;
-            renderPassInfo.framebuffer = swapChainFramebuffers[i];
-            renderPassInfo.renderArea.setOffset({ 0, 0 });
-            renderPassInfo.renderArea.extent = swapChainExtent;
+        indexBuffer = allocator.createBuffer(indexBufferSize, vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eIndexBuffer, vk::MemoryPropertyFlagBits::eDeviceLocal);
+        uploader.upload(indexBuffer.buffer, 0, indexData, indexBufferSize);
 
-            std::array<float, 4> colors = { 0.0f, 0.0f, 0.0f , 1.0f };
-            auto clearColor = vk::ClearValue(colors);//
-            renderPassInfo.clearValueCount = 1;
-            renderPassInfo.pClearValues = &clearColor;
+        uploader.flush();
+    }
+
+    /// <summary>
+    /// Imports an OBJ on every core and fits it into the 2D vertex format the same way the asset packer bakes meshes
+    /// </summary>
+    Mesh importMesh(const std::string& path, std::vector<Vertex>& vertices) {
+        JobSystem importJobs;
+        importJobs.create(std::max(std::thread::hardware_concurrency(), 1u) - 1);
+        MeshLoader loader(importJobs);
+        Mesh mesh = loader.loadObj(path);
+        loader.printStats(std::cout);
+
+        std::vector<FlatVertex> flat = MeshLoader::flatten(mesh);
+        vertices.resize(flat.size());
+        for (size_t i = 0; i < flat.size(); i++) {
+            vertices[i].pos = glm::vec2(flat[i].position[0], flat[i].position[1]);
+            vertices[i].color = glm::vec3(flat[i].color[0], flat[i].color[1], flat[i].color[2]);
+        }
+        return mesh;
+    }
 
-            commandBuffers[i].beginRenderPass(renderPassInfo, vk::SubpassContents::eInline);
-            commandBuffers[i].bindPipeline(vk::PipelineBindPoint::eGraphics, graphicsPipeline);
-            commandBuffers[i].draw(3, 1, 0, 0);
-            commandBuffers[i].endRenderPass();
+    /// <summary>
+    /// Lays count instances out on a square grid over [-1, 1] and streams them into a device local vertex buffer,
+    /// generated in slices so the host never holds the whole field
+    /// </summary>
+    void createInstanceBuffer(uint32_t count) {
+        deletionQueue.push(frameNumber, instanceBuffer);
+        instanceCount = 0;
+
+        // shared with the transfer and compute families up front, no ownership transfers on upload or per frame
+        instanceBuffer = allocator.createBuffer(sizeof(InstanceData) * (vk::DeviceSize)count,
+            vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eVertexBuffer | vk::BufferUsageFlagBits::eStorageBuffer,
+            vk::MemoryPropertyFlagBits::eDeviceLocal, {}, { graphicsFamily, transferFamily, computeFamily });
+
+        uint32_t side = static_cast<uint32_t>(std::ceil(std::sqrt((double)count)));
+        float cell = 2.0f / side;
+        std::vector<InstanceData> slice(std::min(count, 65536u));
+
+        for (uint32_t first = 0; first < count; first += static_cast<uint32_t>(slice.size())) {
+            uint32_t sliceCount = std::min(count - first, static_cast<uint32_t>(slice.size()));
+            for (uint32_t i = 0; i < sliceCount; i++) {
+                uint32_t index = first + i;
+                slice[i].placement = glm::vec4(-1.0f + cell * (index % side + 0.5f), -1.0f + cell * (index / side + 0.5f), (float)index, cell * 0.5f);
+                // cheap integer hash for a stable per-instance tint
+                uint32_t hash = index * 2654435761u;
+                slice[i].color = hash | 0xff000000u;
+            }
+            uploader.upload(instanceBuffer.buffer, first * sizeof(InstanceData), slice.data(), sliceCount * sizeof(InstanceData), true);
+        }
+        uploader.flush();
 
-            commandBuffers[i].end();
+        if (!cullFrames.empty()) {
+            createCullBuffers(count);
         }
+        instanceCount = count;
     }
 
-    void createSyncObjects() {
-        imageAvailableSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-        renderFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-        inFlightFences.resize(MAX_FRAMES_IN_FLIGHT);
-        imagesInFlight.resize(swapChainImages.size(), nullptr);
+    /// <summary>
+    /// The ring doubles as the storage buffer of object transforms. Every allocation starts on a whole transform
+    /// (all alignments are powers of two), so a transform block is addressed by its offset / sizeof(ObjectUniforms).
+    /// </summary>
+    void createUniformRing() {
+        auto limits = physicalDevice.getProperties().limits;
+        vk::DeviceSize minAlignment = std::max({ limits.minUniformBufferOffsetAlignment, limits.minStorageBufferOffsetAlignment, (vk::DeviceSize)sizeof(ObjectUniforms) });
+        objectUniformSlots = config.benchmark == "record" || config.benchmark == "cull" ? MAX_OBJECT_UNIFORMS : std::min(config.objectCount, MAX_OBJECT_UNIFORMS);
+        vk::DeviceSize bytesPerFrame = UniformRing::partitionSize(minAlignment, sizeof(CameraUniforms), 1) +
+            UniformRing::partitionSize(minAlignment, sizeof(ObjectUniforms) * objectUniformSlots, 1);
+
+        uniformRing.create(allocator, minAlignment, bytesPerFrame, config.framesInFlight, vk::BufferUsageFlagBits::eStorageBuffer);
+    }
 
-        auto semaphoreInfo = vk::SemaphoreCreateInfo();
-    	
-        auto fenceInfo = vk::FenceCreateInfo();
-        fenceInfo.flags = vk::FenceCreateFlagBits::eSignaled;
+    void createDescriptorPool() {
+        auto poolSize = vk::DescriptorPoolSize();
+        poolSize.type = vk::DescriptorType::eUniformBufferDynamic;
+        poolSize.descriptorCount = 1;
 
-        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-            imageAvailableSemaphores[i] = device.createSemaphore(semaphoreInfo);
-            renderFinishedSemaphores[i] = device.createSemaphore(semaphoreInfo);
-            inFlightFences[i] = device.createFence(fenceInfo);
-        }
+        auto poolInfo = vk::DescriptorPoolCreateInfo();
+        poolInfo.poolSizeCount = 1;
+        poolInfo.pPoolSizes = &poolSize;
+        poolInfo.maxSets = 1;
+
+        descriptorPool = device.createDescriptorPool(poolInfo);
     }
 
-    void drawFrame() {
-        auto ret = device.waitForFences(1, &inFlightFences[currentFrame], VK_TRUE, UINT64_MAX);
-    	if(ret != vk::Result::eSuccess) throw std::runtime_error("fence failed");
-    	
-        auto imageIndex = device.acquireNextImageKHR(swapChain, UINT64_MAX, imageAvailableSemaphores[currentFrame], nullptr).value;
+    /// <summary>
+    /// A single camera set covers every frame, the ring partition is chosen by the dynamic offset.
+    /// The whole ring is one bindless storage buffer, draws index their transform in it through push constants.
+    /// </summary>
+    void createDescriptorSets() {
+        auto allocInfo = vk::DescriptorSetAllocateInfo();
+        allocInfo.descriptorPool = descriptorPool;
+        allocInfo.descriptorSetCount = 1;
+        allocInfo.pSetLayouts = &descriptorSetLayout;
 
-        if (imagesInFlight[imageIndex]) {
-            ret = device.waitForFences(1, &imagesInFlight[imageIndex], VK_TRUE, UINT64_MAX);
-            if (ret != vk::Result::eSuccess) throw std::runtime_error("fence failed");
+        descriptorSet = device.allocateDescriptorSets(allocInfo)[0];
+
+        auto cameraInfo = vk::DescriptorBufferInfo(uniformRing.getBuffer(), 0, sizeof(CameraUniforms));
+
+        auto descriptorWrite = vk::WriteDescriptorSet();
+        descriptorWrite.dstSet = descriptorSet;
+        descriptorWrite.dstBinding = 0;
+        descriptorWrite.descriptorType = vk::DescriptorType::eUniformBufferDynamic;
+        descriptorWrite.descriptorCount = 1;
+        descriptorWrite.pBufferInfo = &cameraInfo;
+
+        device.updateDescriptorSets(descriptorWrite, nullptr);
+
+        objectTransformBuffer = bindless.addStorageBuffer(uniformRing.getBuffer(), 0, VK_WHOLE_SIZE);
+    }
+
+    void createCullDescriptorSets() {
+        auto poolSize = vk::DescriptorPoolSize();
+        poolSize.type = vk::DescriptorType::eStorageBuffer;
+        poolSize.descriptorCount = 3 * config.framesInFlight;
+
+        auto poolInfo = vk::DescriptorPoolCreateInfo();
+        poolInfo.poolSizeCount = 1;
+        poolInfo.pPoolSizes = &poolSize;
+        poolInfo.maxSets = config.framesInFlight;
+        cullDescriptorPool = device.createDescriptorPool(poolInfo);
+
+        std::vector<vk::DescriptorSetLayout> layouts(config.framesInFlight, cullDescriptorSetLayout);
+        auto allocInfo = vk::DescriptorSetAllocateInfo();
+        allocInfo.descriptorPool = cullDescriptorPool;
+        allocInfo.descriptorSetCount = config.framesInFlight;
+        allocInfo.pSetLayouts = layouts.data();
+        auto descriptorSets = device.allocateDescriptorSets(allocInfo);
+
+        cullFrames.resize(config.framesInFlight);
+        for (size_t i = 0; i < config.framesInFlight; i++) {
+            cullFrames[i].descriptorSet = descriptorSets[i];
+        }
+    }
+
+    /// <summary>
+    /// Sizes the per-frame command buffers for count objects and points the cull descriptor sets at them
+    /// </summary>
+    void createCullBuffers(uint32_t count) {
+        for (auto& frame : cullFrames) {
+            deletionQueue.push(frameNumber, frame.commands);
+            deletionQueue.push(frameNumber, frame.drawCount);
+
+            // written on the compute queue and read on the graphics queue every frame, concurrent beats two ownership barriers
+            frame.commands = allocator.createBuffer(sizeof(vk::DrawIndexedIndirectCommand) * (vk::DeviceSize)count,
+                vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eIndirectBuffer, vk::MemoryPropertyFlagBits::eDeviceLocal,
+                {}, { graphicsFamily, computeFamily });
+            frame.drawCount = allocator.createBuffer(sizeof(uint32_t),
+                vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eIndirectBuffer | vk::BufferUsageFlagBits::eTransferDst,
+                vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent, {}, { graphicsFamily, computeFamily });
+
+            std::array<vk::DescriptorBufferInfo, 3> bufferInfos = {
+                vk::DescriptorBufferInfo(instanceBuffer.buffer, 0, VK_WHOLE_SIZE),
+                vk::DescriptorBufferInfo(frame.commands.buffer, 0, VK_WHOLE_SIZE),
+                vk::DescriptorBufferInfo(frame.drawCount.buffer, 0, VK_WHOLE_SIZE),
+            };
+
+            std::array<vk::WriteDescriptorSet, 3> descriptorWrites;
+            for (uint32_t i = 0; i < descriptorWrites.size(); i++) {
+                descriptorWrites[i].dstSet = frame.descriptorSet;
+                descriptorWrites[i].dstBinding = i;
+                descriptorWrites[i].descriptorType = vk::DescriptorType::eStorageBuffer;
+                descriptorWrites[i].descriptorCount = 1;
+                descriptorWrites[i].pBufferInfo = &bufferInfos[i];
+            }
+            device.updateDescriptorSets(descriptorWrites, nullptr);
+        }
+    }
+
+    void destroyCullBuffers() {
+        for (auto& frame : cullFrames) {
+            allocator.destroyBuffer(frame.commands);
+            allocator.destroyBuffer(frame.drawCount);
+        }
+    }
+
+    /// <summary>
+    /// One primary command buffer per frame in flight, re-recorded every frame
+    /// </summary>
+    void createCommandBuffers() {
+        auto allocInfo = vk::CommandBufferAllocateInfo();
+        allocInfo.commandPool = commandPool;
+        allocInfo.level = vk::CommandBufferLevel::ePrimary;
+        allocInfo.commandBufferCount = config.framesInFlight;
+
+        commandBuffers = device.allocateCommandBuffers(allocInfo);
+    }
+
+    /// <summary>
+    /// One cull command buffer and one semaphore for the graphics submit to wait on per frame in flight.
+    /// Reusing them is covered by the frame slot wait, the graphics submit of a frame always waits on its cull submit.
+    /// </summary>
+    void createComputeCommandBuffers() {
+        auto poolInfo = vk::CommandPoolCreateInfo();
+        poolInfo.flags = vk::CommandPoolCreateFlagBits::eResetCommandBuffer;
+        poolInfo.queueFamilyIndex = computeFamily;
+        computeCommandPool = device.createCommandPool(poolInfo);
+
+        auto allocInfo = vk::CommandBufferAllocateInfo();
+        allocInfo.commandPool = computeCommandPool;
+        allocInfo.level = vk::CommandBufferLevel::ePrimary;
+        allocInfo.commandBufferCount = config.framesInFlight;
+        computeCommandBuffers = device.allocateCommandBuffers(allocInfo);
+
+        for (size_t i = 0; i < config.framesInFlight; i++) {
+            cullFinishedSemaphores.push_back(device.createSemaphore(vk::SemaphoreCreateInfo()));
+        }
+    }
+
+    /// <summary>
+    /// True when this frame's cull pass goes to the compute queue rather than into the graphics command buffer
+    /// </summary>
+    bool cullsOnComputeQueue() const {
+        return gpuCulling && instanceCount > 0 && !computeCommandBuffers.empty();
+    }
+
+    /// <summary>
+    /// threadCount = 0 records inline into the primary command buffer. Otherwise the draws are split across
+    /// threadCount threads (the main thread plus threadCount - 1 workers), each with its own command pool per frame in flight.
+    /// </summary>
+    void createRecordThreads(uint32_t threadCount) {
+        destroyRecordThreads();
+        if (threadCount == 0) return;
+
+        jobSystem.create(threadCount - 1);
+
+        QueueFamilyIndices queueFamilyIndices = findQueueFamilies(physicalDevice);
+        auto poolInfo = vk::CommandPoolCreateInfo();
+        poolInfo.flags = vk::CommandPoolCreateFlagBits::eTransient;
+        poolInfo.queueFamilyIndex = queueFamilyIndices.graphicsFamily.value();
+
+        threadCommandPools.resize(config.framesInFlight * jobSystem.getThreadCount());
+        for (auto& threadPool : threadCommandPools) {
+            threadPool.pool = device.createCommandPool(poolInfo);
+        }
+    }
+
+    void destroyRecordThreads() {
+        jobSystem.destroy();
+        for (auto& threadPool : threadCommandPools) {
+            device.destroyCommandPool(threadPool.pool);
+        }
+        threadCommandPools.clear();
+    }
+
+    /// <summary>
+    /// Timestamps only when a trace was requested, debug labels whenever validation is on
+    /// </summary>
+    void createProfiler() {
+        QueueFamilyIndices queueFamilyIndices = findQueueFamilies(physicalDevice);
+        profiler.create(device, physicalDevice, graphicsQueue, queueFamilyIndices.graphicsFamily.value(), config.framesInFlight,
+            !config.tracePath.empty(), enableValidationLayers ? &dynamicDispatcher : nullptr);
+    }
+
+    /// <summary>
+    /// Next free secondary command buffer of threadIndex for currentFrame, only ever called from that thread
+    /// </summary>
+    vk::CommandBuffer acquireSecondaryCommandBuffer(uint32_t threadIndex) {
+        auto& threadPool = threadCommandPools[currentFrame * jobSystem.getThreadCount() + threadIndex];
+        if (threadPool.used == threadPool.buffers.size()) {
+            auto allocInfo = vk::CommandBufferAllocateInfo();
+            allocInfo.commandPool = threadPool.pool;
+            allocInfo.level = vk::CommandBufferLevel::eSecondary;
+            allocInfo.commandBufferCount = 1;
+            threadPool.buffers.push_back(device.allocateCommandBuffers(allocInfo)[0]);
+        }
+        return threadPool.buffers[threadPool.used++];
+    }
+
+    /// <summary>
+    /// Per-frame uniform locations and descriptor sets shared by every recording thread
+    /// </summary>
+    struct DrawRange {
+        float time;
+        uint32_t cameraOffset;
+        ObjectUniforms* objects;
+        uint32_t firstObject; // index of objects[0] in the ring's storage buffer
+        vk::DescriptorSet bindlessSet;
+    };
+
+    /// <summary>
+    /// Writes this frame's camera and object transforms into the ring partition of currentFrame and records drawCount draws,
+    /// either inline or through secondary command buffers recorded in parallel
+    /// </summary>
+    void recordCommandBuffer(vk::CommandBuffer commandBuffer, uint32_t imageIndex, uint32_t drawCount) {
+        waitForPipelines();
+        // a handful of instanced draws is not worth spreading over threads
+        bool parallel = !threadCommandPools.empty() && instanceCount == 0;
+
+        auto beginInfo = vk::CommandBufferBeginInfo();
+        beginInfo.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit;
+        commandBuffer.begin(beginInfo);
+        profiler.beginFrame(commandBuffer, static_cast<uint32_t>(currentFrame), frameNumber);
+        if (cullsOnComputeQueue()) {
+            vk::CommandBuffer computeCommandBuffer = computeCommandBuffers[currentFrame];
+            computeCommandBuffer.begin(beginInfo);
+            recordCullPass(computeCommandBuffer);
+            computeCommandBuffer.end();
+        }
+        else if (gpuCulling && instanceCount > 0) {
+            recordCullPass(commandBuffer);
+        }
+
+        DrawRange range;
+        range.time = std::chrono::duration<float>(FrameStats::Clock::now() - startTime).count();
+        uniformRing.beginFrame(static_cast<uint32_t>(currentFrame));
+        range.cameraOffset = uniformRing.push(CameraUniforms{ cameraViewProjection() });
+        uint32_t objectsOffset;
+        range.objects = static_cast<ObjectUniforms*>(uniformRing.allocate(sizeof(ObjectUniforms) * objectUniformSlots, objectsOffset));
+        range.firstObject = objectsOffset / sizeof(ObjectUniforms);
+        range.bindlessSet = bindless.beginFrame(static_cast<uint32_t>(currentFrame));
+
+        renderGraph.setImportedImage(backbuffer, swapChainImages[imageIndex], swapChainImageViews[imageIndex], swapChainExtent);
+        renderGraph.setSubpassContents(scenePass, parallel ? vk::SubpassContents::eSecondaryCommandBuffers : vk::SubpassContents::eInline);
+        renderGraph.setRecord(scenePass, [&](vk::CommandBuffer passCommandBuffer) {
+            if (instanceCount > 0) {
+                recordInstancedDraws(passCommandBuffer, range);
+            }
+            else if (!parallel) {
+                recordDraws(passCommandBuffer, range, 0, drawCount);
+            }
+            else {
+                recordParallelDraws(passCommandBuffer, range, drawCount);
+            }
+        });
+        if (readsBack()) {
+            renderGraph.setRecord(readbackPass, [&](vk::CommandBuffer passCommandBuffer) {
+                readback.recordCopy(passCommandBuffer, swapChainImages[imageIndex], frameNumber);
+            });
+        }
+
+        // timestamps can't go into a render pass whose contents are secondaries, the scope wraps the whole graph
+        std::optional<GpuProfiler::Scope> renderPassScope(std::in_place, profiler, commandBuffer, "render pass");
+        renderGraph.execute(commandBuffer);
+        renderPassScope.reset();
+        commandBuffer.end();
+    }
+
+    /// <summary>
+    /// Splits the draws over the job system into secondary command buffers that continue the scene pass
+    /// </summary>
+    void recordParallelDraws(vk::CommandBuffer commandBuffer, const DrawRange& range, uint32_t drawCount) {
+        // the GPU is done with currentFrame, all of its secondaries go back to their pools at once
+        for (uint32_t thread = 0; thread < jobSystem.getThreadCount(); thread++) {
+            auto& threadPool = threadCommandPools[currentFrame * jobSystem.getThreadCount() + thread];
+            device.resetCommandPool(threadPool.pool, {});
+            threadPool.used = 0;
+        }
+
+        auto inheritance = vk::CommandBufferInheritanceInfo();
+        inheritance.renderPass = renderPass;
+        inheritance.subpass = 0;
+        inheritance.framebuffer = renderGraph.getFramebuffer(scenePass);
+
+        // a few chunks per thread so stealing can even out uneven chunks
+        uint32_t grain = std::max(256u, drawCount / (jobSystem.getThreadCount() * 4) + 1);
+        std::vector<vk::CommandBuffer> secondaries((drawCount + grain - 1) / grain);
+
+        jobSystem.parallelFor(drawCount, grain, [&](uint32_t begin, uint32_t end, uint32_t threadIndex) {
+            vk::CommandBuffer secondary = acquireSecondaryCommandBuffer(threadIndex);
+
+            auto secondaryBeginInfo = vk::CommandBufferBeginInfo();
+            secondaryBeginInfo.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit | vk::CommandBufferUsageFlagBits::eRenderPassContinue;
+            secondaryBeginInfo.pInheritanceInfo = &inheritance;
+            secondary.begin(secondaryBeginInfo);
+            recordDraws(secondary, range, begin, end);
+            secondary.end();
+
+            secondaries[begin / grain] = secondary;
+        });
+
+        // executed in chunk order, so the draw order matches the inline path
+        commandBuffer.executeCommands(secondaries);
+    }
+
+    /// <summary>
+    /// Binds the frame state once and records draws [begin, end). Draw i uses transform slot i % objectUniformSlots and the
+    /// draw that owns a slot writes it, so ranges can be recorded on any thread without synchronisation.
+    /// Between draws only the push constants change, no descriptor set is rebound.
+    /// </summary>
+    void recordDraws(vk::CommandBuffer commandBuffer, const DrawRange& range, uint32_t begin, uint32_t end) {
+        commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, graphicsPipeline);
+
+        auto viewport = vk::Viewport(0.0f, 0.0f, (float)swapChainExtent.width, (float)swapChainExtent.height, 0.0f, 1.0f);
+        commandBuffer.setViewport(0, viewport);
+        auto scissor = vk::Rect2D({ 0, 0 }, swapChainExtent);
+        commandBuffer.setScissor(0, scissor);
+
+        vk::DeviceSize offsets[] = { 0 };
+        commandBuffer.bindVertexBuffers(0, 1, &vertexBuffer.buffer, offsets);
+        commandBuffer.bindIndexBuffer(indexBuffer.buffer, 0, indexType);
+
+        std::array<vk::DescriptorSet, 2> sets = { descriptorSet, range.bindlessSet };
+        commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, pipelineLayout, 0, 2, sets.data(), 1, &range.cameraOffset);
+
+        DrawPushConstants constants;
+        constants.transformBuffer = objectTransformBuffer;
+        for (uint32_t i = begin; i < end; i++) {
+            uint32_t slot = i % objectUniformSlots;
+            if (slot == i) {
+                range.objects[slot] = ObjectUniforms{ objectTransform(i, range.time) };
+            }
+            constants.transformIndex = range.firstObject + slot;
+            commandBuffer.pushConstants(pipelineLayout, vk::ShaderStageFlagBits::eVertex, 0, sizeof(constants), &constants);
+            commandBuffer.drawIndexed(indexCount, 1, 0, 0, 0);
+        }
+    }
+
+    /// <summary>
+    /// Frustum culls every instance on the GPU and leaves this frame's indirect commands ready for the vertex stage.
+    /// On the compute queue the cull-finished semaphore orders the draws after it and the pass gets no timestamp scope,
+    /// the frame's queries are only reset later in the graphics command buffer.
+    /// </summary>
+    void recordCullPass(vk::CommandBuffer commandBuffer) {
+        std::optional<GpuProfiler::Scope> cullScope;
+        if (!cullsOnComputeQueue()) {
+            cullScope.emplace(profiler, commandBuffer, "cull");
+        }
+        CullFrame& frame = cullFrames[currentFrame];
+
+        commandBuffer.fillBuffer(frame.drawCount.buffer, 0, sizeof(uint32_t), 0);
+        auto clearBarrier = vk::MemoryBarrier(vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite);
+        commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eComputeShader, {}, clearBarrier, nullptr, nullptr);
+
+        CullPushConstants params;
+        glm::mat4 viewProj = glm::transpose(cameraViewProjection());
+        // Gribb/Hartmann: planes are sums/differences of the rows of viewProj, near is row 2 alone for 0..1 depth
+        params.planes[0] = viewProj[3] + viewProj[0];
+        params.planes[1] = viewProj[3] - viewProj[0];
+        params.planes[2] = viewProj[3] + viewProj[1];
+        params.planes[3] = viewProj[3] - viewProj[1];
+        params.planes[4] = viewProj[2];
+        params.planes[5] = viewProj[3] - viewProj[2];
+        for (auto& plane : params.planes) {
+            plane /= glm::length(glm::vec3(plane));
+        }
+        params.objectCount = instanceCount;
+        params.indexCount = indexCount;
+        params.compact = drawIndirectCountSupported ? 1 : 0;
+
+        commandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, cullPipeline);
+        commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, cullPipelineLayout, 0, 1, &frame.descriptorSet, 0, nullptr);
+        commandBuffer.pushConstants(cullPipelineLayout, vk::ShaderStageFlagBits::eCompute, 0, sizeof(params), &params);
+        commandBuffer.dispatch((instanceCount + 63) / 64, 1, 1);
+
+        auto cullBarrier = vk::MemoryBarrier(vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eIndirectCommandRead | vk::AccessFlagBits::eHostRead);
+        commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eDrawIndirect | vk::PipelineStageFlagBits::eHost,
+            {}, cullBarrier, nullptr, nullptr);
+    }
+
+    /// <summary>
+    /// The whole instance field in one draw per INSTANCES_PER_DRAW batch, or the indirect commands of the cull pass
+    /// </summary>
+    void recordInstancedDraws(vk::CommandBuffer commandBuffer, const DrawRange& range) {
+        commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, instancedPipeline);
+
+        auto viewport = vk::Viewport(0.0f, 0.0f, (float)swapChainExtent.width, (float)swapChainExtent.height, 0.0f, 1.0f);
+        commandBuffer.setViewport(0, viewport);
+        auto scissor = vk::Rect2D({ 0, 0 }, swapChainExtent);
+        commandBuffer.setScissor(0, scissor);
+
+        vk::Buffer buffers[] = { vertexBuffer.buffer, instanceBuffer.buffer };
+        vk::DeviceSize offsets[] = { 0, 0 };
+        commandBuffer.bindVertexBuffers(0, 2, buffers, offsets);
+        commandBuffer.bindIndexBuffer(indexBuffer.buffer, 0, indexType);
+
+        // the instanced shader only reads the camera
+        commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, pipelineLayout, 0, 1, &descriptorSet, 1, &range.cameraOffset);
+
+        if (gpuCulling) {
+            CullFrame& frame = cullFrames[currentFrame];
+            uint32_t stride = sizeof(vk::DrawIndexedIndirectCommand);
+            if (drawIndirectCountSupported) {
+                commandBuffer.drawIndexedIndirectCountKHR(frame.commands.buffer, 0, frame.drawCount.buffer, 0, instanceCount, stride, dynamicDispatcher);
+            }
+            else {
+                for (uint32_t first = 0; first < instanceCount; first += maxDrawIndirectCount) {
+                    commandBuffer.drawIndexedIndirect(frame.commands.buffer, (vk::DeviceSize)first * stride, std::min(maxDrawIndirectCount, instanceCount - first), stride);
+                }
+            }
+            return;
+        }
+
+        for (uint32_t first = 0; first < instanceCount; first += INSTANCES_PER_DRAW) {
+            commandBuffer.drawIndexed(indexCount, std::min(INSTANCES_PER_DRAW, instanceCount - first), 0, 0, first);
+        }
+    }
+
+    /// <summary>
+    /// Looks down -z at the [-1, 1] square the objects are laid out in. Vulkan clip space already has Y
+    /// pointing down, the scene is authored that way so the projection is not flipped.
+    /// </summary>
+    glm::mat4 cameraViewProjection() {
+        float aspect = swapChainExtent.width / (float)swapChainExtent.height;
+        glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 0.0f, 1.0f / cameraZoom), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+        glm::mat4 proj = glm::perspective(glm::radians(90.0f), aspect, 0.1f, 10.0f);
+        return proj * view;
+    }
+
+    /// <summary>
+    /// Objects fill a square grid, each spinning around its own center
+    /// </summary>
+    glm::mat4 objectTransform(uint32_t index, float time) {
+        uint32_t side = static_cast<uint32_t>(std::ceil(std::sqrt((double)config.objectCount)));
+        float cell = 2.0f / side;
+        float x = -1.0f + cell * (index % side + 0.5f);
+        float y = -1.0f + cell * (index / side + 0.5f);
+
+        glm::mat4 model = glm::translate(glm::mat4(1.0f), glm::vec3(x, y, 0.0f));
+        model = glm::rotate(model, time * glm::radians(90.0f) + index, glm::vec3(0.0f, 0.0f, 1.0f));
+        return glm::scale(model, glm::vec3(cell * 0.5f));
+    }
+
+    void createSyncObjects() {
+        imageAvailableSemaphores.resize(config.framesInFlight);
+        renderFinishedSemaphores.resize(config.framesInFlight);
+        inFlightFences.resize(config.framesInFlight);
+        presentTimings.assign(config.framesInFlight, PresentTiming());
+        imagesInFlight.resize(swapChainImages.size(), nullptr);
+        frameTimelineValues.assign(config.framesInFlight, 0);
+        imageTimelineValues.assign(swapChainImages.size(), 0);
+
+        auto semaphoreInfo = vk::SemaphoreCreateInfo();
+    	
+        auto fenceInfo = vk::FenceCreateInfo();
+        fenceInfo.flags = vk::FenceCreateFlagBits::eSignaled;
+
+        for (size_t i = 0; i < config.framesInFlight; i++) {
+            imageAvailableSemaphores[i] = device.createSemaphore(semaphoreInfo);
+            renderFinishedSemaphores[i] = device.createSemaphore(semaphoreInfo);
+            if (!timelineSync) {
+                inFlightFences[i] = device.createFence(fenceInfo);
+            }
+        }
+    }
+
+    void drawFrame() {
+        INSTRUMENT_ZONE("frame");
+        INSTRUMENT_COUNTER("frame number", frameNumber);
+        auto waitStart = FrameStats::Clock::now();
+        waitForFrameSlot();
+        auto waitEnd = FrameStats::Clock::now();
+        profiler.addCpuSpan("wait for frame", waitStart, waitEnd);
+        profiler.collect(static_cast<uint32_t>(currentFrame));
+        if (config.frameCount > 0) {
+            fenceWaitStats.addSample(waitStart, waitEnd);
+        }
+
+        retireDeletions();
+        INSTRUMENT_COUNTER("deferred deletions", deletionQueue.size());
+        collectReadbacks();
+
+        if (config.headless) {
+            drawOffscreenFrame();
+            return;
+        }
+
+#ifdef _WIN32
+        swapChainStale |= window.hasResized();
+#endif
+        if (swapChainStale && !recreateSwapChain()) {
+            return; // minimized, nothing to render into
+        }
+
+        waitForPresent();
+
+        uint32_t imageIndex;
+        auto acquireStart = FrameStats::Clock::now();
+        try {
+            GpuProfiler::CpuScope acquireScope(profiler, "acquire");
+            INSTRUMENT_ZONE("acquire");
+            auto acquired = device.acquireNextImageKHR(swapChain, UINT64_MAX, imageAvailableSemaphores[currentFrame], nullptr);
+            imageIndex = acquired.value;
+            // a suboptimal image can still be rendered and presented, recreate after this frame
+            swapChainStale |= acquired.result == vk::Result::eSuboptimalKHR;
+        }
+        catch (const vk::OutOfDateKHRError&) {
+            swapChainStale = true;
+            return;
+        }
+
+        waitForImage(imageIndex);
+
+        {
+            GpuProfiler::CpuScope recordScope(profiler, "record");
+            INSTRUMENT_ZONE("record");
+            recordCommandBuffer(commandBuffers[currentFrame], imageIndex, config.objectCount);
         }
-        imagesInFlight[imageIndex] = inFlightFences[currentFrame];
 
         auto submitInfo = vk::SubmitInfo();
     	
@@ -579,15 +2033,13 @@ private:
         submitInfo.pWaitDstStageMask = waitStages;
 
         submitInfo.commandBufferCount = 1;
-        submitInfo.pCommandBuffers = &commandBuffers[imageIndex];
+        submitInfo.pCommandBuffers = &commandBuffers[currentFrame];
 
         vk::Semaphore signalSemaphores[] = { renderFinishedSemaphores[currentFrame] };
         submitInfo.signalSemaphoreCount = 1;
         submitInfo.pSignalSemaphores = signalSemaphores;
 
-        device.resetFences(1, &inFlightFences[currentFrame]);
-
-        graphicsQueue.submit(submitInfo, inFlightFences[currentFrame]);
+        submitFrame(submitInfo, imageIndex);
 
         auto presentInfo = vk::PresentInfoKHR();
 
@@ -600,10 +2052,547 @@ private:
 
         presentInfo.pImageIndices = &imageIndex;
 
-        ret = presentQueue.presentKHR(presentInfo);
-        if (ret != vk::Result::eSuccess) throw std::runtime_error("presentation failed");
+        PresentTiming& timing = presentTimings[currentFrame];
+        timing.acquireStart = acquireStart;
+        timing.swapChain = swapChain;
+        timing.presentId = 0;
+#ifdef VK_KHR_present_wait
+        auto presentId = vk::PresentIdKHR();
+        if (presentWaitSupported) {
+            timing.presentId = nextPresentId++;
+            presentId.swapchainCount = 1;
+            presentId.pPresentIds = &timing.presentId;
+            presentInfo.pNext = &presentId;
+        }
+#endif
+
+        try {
+            GpuProfiler::CpuScope presentScope(profiler, "present");
+            INSTRUMENT_ZONE("present");
+            auto ret = presentQueue.presentKHR(presentInfo);
+            if (ret == vk::Result::eSuboptimalKHR) swapChainStale = true;
+            else if (ret != vk::Result::eSuccess) throw std::runtime_error("presentation failed");
+        }
+        catch (const vk::OutOfDateKHRError&) {
+            swapChainStale = true;
+        }
+        if (config.frameCount > 0 && !presentWaitSupported) {
+            presentLatencyStats.addSample(acquireStart, FrameStats::Clock::now());
+        }
+
+        frameNumber++;
+        currentFrame = (currentFrame + 1) % config.framesInFlight;
+    }
+
+    /// <summary>
+    /// Blocks until the GPU is done with the previous use of the currentFrame slot
+    /// </summary>
+    void waitForFrameSlot() {
+        INSTRUMENT_ZONE("waitForFrameSlot");
+        if (timelineSync) {
+            frameTimeline.wait(frameTimelineValues[currentFrame]);
+            return;
+        }
+
+        auto ret = device.waitForFences(1, &inFlightFences[currentFrame], VK_TRUE, UINT64_MAX);
+        if (ret != vk::Result::eSuccess) throw std::runtime_error("fence failed");
+    }
+
+    /// <summary>
+    /// Blocks until the last frame rendering to imageIndex from another slot is done with it
+    /// </summary>
+    void waitForImage(uint32_t imageIndex) {
+        if (timelineSync) {
+            frameTimeline.wait(imageTimelineValues[imageIndex]);
+            return;
+        }
+
+        if (imagesInFlight[imageIndex]) {
+            auto ret = device.waitForFences(1, &imagesInFlight[imageIndex], VK_TRUE, UINT64_MAX);
+            if (ret != vk::Result::eSuccess) throw std::runtime_error("fence failed");
+        }
+        imagesInFlight[imageIndex] = inFlightFences[currentFrame];
+    }
+
+    /// <summary>
+    /// Submits the frame and marks its slot and image busy, either with the slot's fence or with the next timeline value.
+    /// submitInfo carries at most one wait and one signal semaphore, both binary. An async cull pass is submitted
+    /// to the compute queue first and the graphics submit waits on it before reading the indirect commands.
+    /// </summary>
+    void submitFrame(vk::SubmitInfo submitInfo, uint32_t imageIndex) {
+        GpuProfiler::CpuScope submitScope(profiler, "submit");
+        INSTRUMENT_ZONE("submit");
+
+        std::array<vk::Semaphore, 2> waitSemaphores;
+        std::array<vk::PipelineStageFlags, 2> waitStages;
+        uint32_t waitCount = 0;
+        if (submitInfo.waitSemaphoreCount > 0) {
+            waitSemaphores[waitCount] = submitInfo.pWaitSemaphores[0];
+            waitStages[waitCount++] = submitInfo.pWaitDstStageMask[0];
+        }
+        if (cullsOnComputeQueue()) {
+            auto computeSubmitInfo = vk::SubmitInfo();
+            computeSubmitInfo.commandBufferCount = 1;
+            computeSubmitInfo.pCommandBuffers = &computeCommandBuffers[currentFrame];
+            computeSubmitInfo.signalSemaphoreCount = 1;
+            computeSubmitInfo.pSignalSemaphores = &cullFinishedSemaphores[currentFrame];
+            computeQueue.submit(computeSubmitInfo, nullptr);
+
+            waitSemaphores[waitCount] = cullFinishedSemaphores[currentFrame];
+            waitStages[waitCount++] = vk::PipelineStageFlagBits::eDrawIndirect;
+        }
+        submitInfo.waitSemaphoreCount = waitCount;
+        submitInfo.pWaitSemaphores = waitSemaphores.data();
+        submitInfo.pWaitDstStageMask = waitStages.data();
+
+        if (!timelineSync) {
+            device.resetFences(1, &inFlightFences[currentFrame]);
+            graphicsQueue.submit(submitInfo, inFlightFences[currentFrame]);
+            return;
+        }
+
+        uint64_t value = frameTimeline.next();
 
-        currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+        // binary semaphores ignore their entries in the value arrays
+        std::array<vk::Semaphore, 2> signalSemaphores;
+        std::array<uint64_t, 2> signalValues = { 0, 0 };
+        uint32_t signalCount = 0;
+        if (submitInfo.signalSemaphoreCount > 0) {
+            signalSemaphores[signalCount++] = submitInfo.pSignalSemaphores[0];
+        }
+        signalSemaphores[signalCount] = frameTimeline.get();
+        signalValues[signalCount++] = value;
+        std::array<uint64_t, 2> waitValues = { 0, 0 };
+
+        auto timelineInfo = vk::TimelineSemaphoreSubmitInfoKHR();
+        timelineInfo.waitSemaphoreValueCount = waitCount;
+        timelineInfo.pWaitSemaphoreValues = waitValues.data();
+        timelineInfo.signalSemaphoreValueCount = signalCount;
+        timelineInfo.pSignalSemaphoreValues = signalValues.data();
+
+        submitInfo.pNext = &timelineInfo;
+        submitInfo.signalSemaphoreCount = signalCount;
+        submitInfo.pSignalSemaphores = signalSemaphores.data();
+        graphicsQueue.submit(submitInfo, nullptr);
+
+        frameTimelineValues[currentFrame] = value;
+        imageTimelineValues[imageIndex] = value;
+    }
+
+    /// <summary>
+    /// With VK_KHR_present_wait, blocks until the frame last submitted from this slot has reached the display and
+    /// records its acquire-to-display latency. This also keeps the CPU at most framesInFlight displayed frames ahead.
+    /// </summary>
+    void waitForPresent() {
+        INSTRUMENT_ZONE("waitForPresent");
+#ifdef VK_KHR_present_wait
+        PresentTiming& timing = presentTimings[currentFrame];
+        // ids belong to one swapchain, a recreated swapchain starts over
+        if (!presentWaitSupported || timing.presentId == 0 || timing.swapChain != swapChain) return;
+
+        try {
+            auto ret = device.waitForPresentKHR(swapChain, timing.presentId, 100'000'000, dynamicDispatcher);
+            if (ret == vk::Result::eSuccess && config.frameCount > 0) {
+                presentLatencyStats.addSample(timing.acquireStart, FrameStats::Clock::now());
+            }
+        }
+        catch (const vk::OutOfDateKHRError&) {
+            swapChainStale = true;
+        }
+        timing.presentId = 0;
+#endif
+    }
+
+    /// <summary>
+    /// Replaces swapchain, image views and framebuffers without waiting for the device to go idle,
+    /// the previous objects are retired and destroyed once the frames still using them have completed.
+    /// Render graph and pipeline are kept, the graph creates framebuffers for the new images on first use.
+    /// Viewport and scissor are dynamic state.
+    /// </summary>
+    /// <returns>false when the window is minimized and there is nothing to render into</returns>
+    bool recreateSwapChain() {
+        vk::Extent2D extent = chooseSwapExtent(physicalDevice.getSurfaceCapabilitiesKHR(surface));
+        if (extent.width == 0 || extent.height == 0) {
+            return false;
+        }
+
+        // frameNumber is the next frame, the ones before it may still be rendering into the old images
+        renderGraph.releaseFramebuffers(deletionQueue, frameNumber);
+        for (auto imageView : swapChainImageViews) {
+            deletionQueue.push(frameNumber, imageView);
+        }
+        deletionQueue.push(frameNumber, swapChain);
+        swapChainImageViews.clear();
+
+        createSwapChain(swapChain);
+        createImageViews();
+        if (readsBack()) {
+            readback.resize(swapChainExtent, deletionQueue, frameNumber);
+        }
+
+        imagesInFlight.assign(swapChainImages.size(), nullptr);
+        imageTimelineValues.assign(swapChainImages.size(), 0);
+        swapChainStale = false;
+        return true;
+    }
+
+    /// <summary>
+    /// Waiting on inFlightFences[currentFrame] guarantees every frame up to frameNumber - config.framesInFlight has completed
+    /// </summary>
+    void retireDeletions() {
+        if (frameNumber >= config.framesInFlight) {
+            deletionQueue.retire(frameNumber - config.framesInFlight);
+        }
+    }
+
+    /// <summary>
+    /// Benchmarks record frames without going through drawFrame(), nothing would collect their copies
+    /// </summary>
+    bool readsBack() const {
+        return config.readback && config.benchmark.empty();
+    }
+
+    /// <summary>
+    /// Same guarantee as retireDeletions(), the copies of frames up to frameNumber - config.framesInFlight can be read
+    /// </summary>
+    void collectReadbacks() {
+        if (!readsBack() || frameNumber < config.framesInFlight) return;
+
+        GpuProfiler::CpuScope collectScope(profiler, "readback");
+        readback.collect(frameNumber - config.framesInFlight, [this](const FrameReadback::Capture& capture) { consumeCapture(capture); });
+    }
+
+    /// <summary>
+    /// Queues every frame for writing when the capture path has a %u for the frame number, other frames are only counted
+    /// </summary>
+    void consumeCapture(const FrameReadback::Capture& capture) {
+        size_t placeholder = config.capturePath.find("%u");
+        if (placeholder == std::string::npos) return;
+
+        std::string path = config.capturePath;
+        path.replace(placeholder, 2, std::to_string(capture.frameNumber));
+        readback.queueWrite(capture, path);
+    }
+
+    /// <summary>
+    /// Collects the frames still in the ring after the device went idle, writes the last one and checks it against the golden image
+    /// </summary>
+    void finishReadback() {
+        if (!readsBack() || frameNumber == 0) return;
+
+        uint64_t lastFrame = frameNumber - 1;
+        readback.collect(lastFrame, [&](const FrameReadback::Capture& capture) {
+            consumeCapture(capture);
+            if (capture.frameNumber != lastFrame) return;
+
+            lastFrameCaptured = true;
+            if (!config.capturePath.empty() && config.capturePath.find("%u") == std::string::npos) {
+                FrameReadback::writeImage(config.capturePath, capture);
+            }
+            if (!config.goldenPath.empty()) {
+                compareWithGolden(capture);
+            }
+        });
+        readback.flushWrites();
+
+        std::cout << "readback: " << readback.getCollectedCount() << " frames collected, " << readback.getDroppedCount() << " writes dropped" << std::endl;
+        if (config.goldenPath.empty()) return;
+        if (!lastFrameCaptured) {
+            throw std::runtime_error("the last frame was not read back, nothing to compare with " + config.goldenPath + "!");
+        }
+        std::cout << "golden: max channel difference " << goldenDiff.maxDifference << ", " << goldenDiff.pixelsOverTolerance << " of "
+            << goldenDiff.pixelCount << " pixels beyond " << config.goldenTolerance << std::endl;
+        if (goldenDiff.pixelsOverTolerance > 0) {
+            throw std::runtime_error("frame differs from golden image " + config.goldenPath + "!");
+        }
+    }
+
+    /// <summary>
+    /// A missing golden image is created from this frame, so a new test only needs its first run to be checked by eye
+    /// </summary>
+    void compareWithGolden(const FrameReadback::Capture& capture) {
+        if (!std::ifstream(config.goldenPath).good()) {
+            FrameReadback::writeImage(config.goldenPath, capture);
+            std::cout << "golden: " << config.goldenPath << " did not exist, written from the last frame" << std::endl;
+            goldenDiff = FrameReadback::ImageDiff();
+            return;
+        }
+
+        uint32_t width, height;
+        std::vector<uint8_t> rgb;
+        if (!FrameReadback::readPpm(config.goldenPath, width, height, rgb)) {
+            throw std::runtime_error("golden image " + config.goldenPath + " is not a binary PPM!");
+        }
+        if (width != capture.width || height != capture.height) {
+            throw std::runtime_error("golden image " + config.goldenPath + " is " + std::to_string(width) + "x" + std::to_string(height) + ", the frame is " +
+                std::to_string(capture.width) + "x" + std::to_string(capture.height) + "!");
+        }
+        goldenDiff = FrameReadback::compare(capture, rgb, config.goldenTolerance);
+    }
+
+    /// <summary>
+    /// Headless counterpart of the acquire/submit/present sequence, offscreen images are used round-robin
+    /// and nothing has to wait on or signal a presentation semaphore
+    /// </summary>
+    void drawOffscreenFrame() {
+        uint32_t imageIndex = nextOffscreenImage;
+        nextOffscreenImage = (nextOffscreenImage + 1) % static_cast<uint32_t>(swapChainImages.size());
+
+        waitForImage(imageIndex);
+
+        {
+            GpuProfiler::CpuScope recordScope(profiler, "record");
+            INSTRUMENT_ZONE("record");
+            recordCommandBuffer(commandBuffers[currentFrame], imageIndex, config.objectCount);
+        }
+
+        auto submitInfo = vk::SubmitInfo();
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = &commandBuffers[currentFrame];
+
+        submitFrame(submitInfo, imageIndex);
+
+        frameNumber++;
+        currentFrame = (currentFrame + 1) % config.framesInFlight;
+    }
+
+    /// <summary>
+    /// Calls frame warmupFrames + measuredFrames times and samples the time from one measured call's end to the next,
+    /// window messages are pumped in between so a long sweep doesn't leave the window unresponsive
+    /// </summary>
+    template<typename Frame>
+    FrameStats measureFrames(uint32_t warmupFrames, uint32_t measuredFrames, Frame&& frame) {
+        FrameStats stats;
+        stats.reserve(measuredFrames);
+        auto frameStart = FrameStats::Clock::now();
+        for (uint32_t i = 0; i < warmupFrames + measuredFrames; i++) {
+            frame();
+#ifdef _WIN32
+            if (!config.headless) {
+                window.pollEvents();
+            }
+#endif
+            auto frameEnd = FrameStats::Clock::now();
+            if (i >= warmupFrames) stats.addSample(frameStart, frameEnd);
+            frameStart = frameEnd;
+        }
+        return stats;
+    }
+
+    /// <summary>
+    /// Allocate/free churn against the sub-allocator, compared with one vkAllocateMemory per resource
+    /// </summary>
+    void benchmarkAllocator() {
+        const uint32_t operations = 200000;
+        const size_t liveTarget = 2048;
+        const size_t directLiveTarget = 256; // stays well below maxMemoryAllocationCount
+
+        std::mt19937 rng(42);
+        std::uniform_int_distribution<uint32_t> sizeShift(8, 20); // 256 B .. 1 MiB
+        std::uniform_int_distribution<uint32_t> alignmentShift(8, 16); // 256 B .. 64 KiB
+
+        auto randomRequirements = [&]() {
+            auto requirements = vk::MemoryRequirements();
+            vk::DeviceSize size = vk::DeviceSize(1) << sizeShift(rng);
+            requirements.size = size + rng() % size;
+            requirements.alignment = vk::DeviceSize(1) << alignmentShift(rng);
+            requirements.memoryTypeBits = ~0u;
+            return requirements;
+        };
+
+        std::vector<Allocation> live;
+        live.reserve(liveTarget);
+
+        auto start = FrameStats::Clock::now();
+        for (uint32_t i = 0; i < operations; i++) {
+            if (live.empty() || (live.size() < liveTarget && (rng() & 1))) {
+                auto kind = (rng() & 3) == 0 ? ResourceKind::Optimal : ResourceKind::Linear;
+                live.push_back(allocator.allocate(randomRequirements(), vk::MemoryPropertyFlagBits::eDeviceLocal, kind));
+            }
+            else {
+                size_t index = rng() % live.size();
+                allocator.free(live[index]);
+                live[index] = live.back();
+                live.pop_back();
+            }
+        }
+        double subAllocatorMilliseconds = FrameStats::toMilliseconds(FrameStats::Clock::now() - start);
+
+        allocator.printStats(std::cout);
+        for (auto& allocation : live) {
+            allocator.free(allocation);
+        }
+
+        std::vector<vk::DeviceMemory> directLive;
+        directLive.reserve(directLiveTarget);
+        Allocation probe = allocator.allocate(randomRequirements(), vk::MemoryPropertyFlagBits::eDeviceLocal, ResourceKind::Linear);
+        uint32_t memoryType = probe.memoryType;
+        allocator.free(probe);
+
+        start = FrameStats::Clock::now();
+        for (uint32_t i = 0; i < operations / 10; i++) {
+            if (directLive.empty() || (directLive.size() < directLiveTarget && (rng() & 1))) {
+                directLive.push_back(device.allocateMemory(vk::MemoryAllocateInfo(randomRequirements().size, memoryType)));
+            }
+            else {
+                size_t index = rng() % directLive.size();
+                device.freeMemory(directLive[index]);
+                directLive[index] = directLive.back();
+                directLive.pop_back();
+            }
+        }
+        double directMilliseconds = FrameStats::toMilliseconds(FrameStats::Clock::now() - start);
+        for (auto memory : directLive) {
+            device.freeMemory(memory);
+        }
+
+        std::cout << "sub-allocator: " << operations << " operations in " << subAllocatorMilliseconds << " ms ("
+            << subAllocatorMilliseconds * 1e6 / operations << " ns/op)" << std::endl;
+        std::cout << "vkAllocateMemory: " << operations / 10 << " operations in " << directMilliseconds << " ms ("
+            << directMilliseconds * 1e6 / (operations / 10) << " ns/op)" << std::endl;
+    }
+
+    /// <summary>
+    /// Every combination of the frag.spv specialization constants, blend and cull mode requested twice and built
+    /// in one batch, then looked up again the way a renderer picks materials every frame
+    /// </summary>
+    void benchmarkPipelines() {
+        std::vector<PipelineDesc> variants;
+        for (uint32_t colorMode = 0; colorMode < 4; colorMode++) {
+            for (uint32_t alphaStep = 1; alphaStep <= 8; alphaStep++) {
+                for (BlendMode blend : { BlendMode::Opaque, BlendMode::Alpha, BlendMode::Additive }) {
+                    for (vk::CullModeFlags cullMode : { vk::CullModeFlags(vk::CullModeFlagBits::eNone), vk::CullModeFlags(vk::CullModeFlagBits::eBack), vk::CullModeFlags(vk::CullModeFlagBits::eFront) }) {
+                        float alpha = alphaStep / 8.0f;
+                        uint32_t alphaBits;
+                        memcpy(&alphaBits, &alpha, sizeof(alphaBits));
+
+                        PipelineDesc desc = objectPipelineDesc();
+                        desc.fragmentConstants = { { 0, colorMode }, { 1, alphaBits } };
+                        desc.blend = blend;
+                        desc.cullMode = cullMode;
+                        variants.push_back(desc);
+                    }
+                }
+            }
+        }
+
+        size_t pipelinesBefore = pipelineLibrary.getPipelineCount();
+        uint64_t deduplicatedBefore = pipelineLibrary.getDeduplicatedCount();
+        auto buildStart = FrameStats::Clock::now();
+        for (int round = 0; round < 2; round++) {
+            for (const auto& desc : variants) {
+                pipelineLibrary.request(desc);
+            }
+        }
+        uint32_t created = pipelineLibrary.build(compileThreadCount());
+        double buildMilliseconds = FrameStats::toMilliseconds(FrameStats::Clock::now() - buildStart);
+
+        const uint32_t lookupRounds = 100;
+        vk::Pipeline last;
+        auto lookupStart = FrameStats::Clock::now();
+        for (uint32_t round = 0; round < lookupRounds; round++) {
+            for (const auto& desc : variants) {
+                last = pipelineLibrary.get(desc);
+            }
+        }
+        double lookupMilliseconds = FrameStats::toMilliseconds(FrameStats::Clock::now() - lookupStart);
+        if (!last) throw std::runtime_error("pipeline lookup failed!");
+
+        std::cout << "pipelines: " << variants.size() * 2 << " requests, " << created << " created in one build on up to " << compileThreadCount()
+            << " threads in " << buildMilliseconds << " ms ("
+            << (pipelineCache.isWarm() ? "warm" : "cold") << " cache), " << pipelineLibrary.getPipelineCount() - pipelinesBefore << " new in the library" << std::endl;
+        std::cout << "pipelines: " << pipelineLibrary.getDeduplicatedCount() - deduplicatedBefore << " requests deduplicated, lookup "
+            << lookupMilliseconds * 1e6 / (lookupRounds * variants.size()) << " ns" << std::endl;
+    }
+
+    /// <summary>
+    /// A fuller frame built as a second render graph: shadow map, depth prepass, HDR scene, bloom down and blur, tonemap,
+    /// plus a debug overlay nothing reads. Reports culling, barriers and attachment memory with and without aliasing,
+    /// then runs the graph once with clear-only passes so every transition it scheduled executes.
+    /// </summary>
+    void benchmarkRenderGraph() {
+        device.waitIdle();
+
+        auto supportsDepth = [&](vk::Format format) {
+            vk::FormatFeatureFlags needed = vk::FormatFeatureFlagBits::eDepthStencilAttachment | vk::FormatFeatureFlagBits::eSampledImage;
+            return (physicalDevice.getFormatProperties(format).optimalTilingFeatures & needed) == needed;
+        };
+        vk::Format depthFormat = supportsDepth(vk::Format::eD32Sfloat) ? vk::Format::eD32Sfloat : vk::Format::eD16Unorm;
+        vk::Extent2D extent = swapChainExtent;
+        vk::Extent2D half(std::max(1u, extent.width / 2), std::max(1u, extent.height / 2));
+        const std::array<float, 4> black = { 0.0f, 0.0f, 0.0f, 1.0f };
+        const float farDepth = 1.0f;
+
+        auto compileStart = FrameStats::Clock::now();
+        RenderGraph graph;
+        graph.create(device, allocator);
+        auto shadowMap = graph.createImage("shadow map", depthFormat, vk::Extent2D(2048, 2048));
+        auto depth = graph.createImage("depth", depthFormat, extent);
+        auto hdr = graph.createImage("hdr", vk::Format::eR16G16B16A16Sfloat, extent);
+        auto bloomDown = graph.createImage("bloom down", vk::Format::eR16G16B16A16Sfloat, half);
+        auto bloomBlur = graph.createImage("bloom blur", vk::Format::eR16G16B16A16Sfloat, half);
+        auto ldr = graph.createImage("ldr", vk::Format::eR8G8B8A8Unorm, extent);
+        auto overlay = graph.createImage("debug overlay", vk::Format::eR8G8B8A8Unorm, extent);
+
+        auto shadow = graph.addPass("shadow");
+        graph.addDepthOutput(shadow, shadowMap, &farDepth);
+        auto prepass = graph.addPass("depth prepass");
+        graph.addDepthOutput(prepass, depth, &farDepth);
+        auto scene = graph.addPass("scene");
+        graph.addColorOutput(scene, hdr, &black);
+        graph.addDepthOutput(scene, depth);
+        graph.addShaderInput(scene, shadowMap);
+        auto downsample = graph.addPass("bloom downsample");
+        graph.addColorOutput(downsample, bloomDown, &black);
+        graph.addShaderInput(downsample, hdr);
+        auto blur = graph.addPass("bloom blur");
+        graph.addColorOutput(blur, bloomBlur, &black);
+        graph.addShaderInput(blur, bloomDown);
+        auto tonemap = graph.addPass("tonemap");
+        graph.addColorOutput(tonemap, ldr, &black);
+        graph.addShaderInput(tonemap, hdr);
+        graph.addShaderInput(tonemap, bloomBlur);
+        auto debugOverlay = graph.addPass("debug overlay");
+        graph.addColorOutput(debugOverlay, overlay, &black);
+        graph.addShaderInput(debugOverlay, depth);
+        graph.markOutput(ldr, vk::ImageLayout::eTransferSrcOptimal);
+
+        graph.compile();
+        double compileMilliseconds = FrameStats::toMilliseconds(FrameStats::Clock::now() - compileStart);
+        graph.printReport(std::cout);
+
+        vk::CommandBuffer commandBuffer = commandBuffers[currentFrame];
+        auto beginInfo = vk::CommandBufferBeginInfo();
+        beginInfo.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit;
+        auto recordStart = FrameStats::Clock::now();
+        commandBuffer.begin(beginInfo);
+        graph.execute(commandBuffer);
+        commandBuffer.end();
+        double recordMilliseconds = FrameStats::toMilliseconds(FrameStats::Clock::now() - recordStart);
+
+        auto submitInfo = vk::SubmitInfo();
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = &commandBuffer;
+        graphicsQueue.submit(submitInfo, nullptr);
+        graphicsQueue.waitIdle();
+
+        std::cout << "render graph: compiled in " << compileMilliseconds << " ms, recorded in " << recordMilliseconds << " ms" << std::endl;
+        graph.destroy();
+    }
+
+    /// <summary>
+    /// Straight from the asset pack mapping when the pack has path, otherwise from the loose file
+    /// </summary>
+    vk::ShaderModule loadShaderModule(const std::string& path) {
+        AssetView code = assets.find(path);
+        if (!code) {
+            return createShaderModule(readFile(path));
+        }
+
+        auto createInfo = vk::ShaderModuleCreateInfo();
+        createInfo.codeSize = code.size;
+        createInfo.pCode = static_cast<const uint32_t*>(code.data);
+        return device.createShaderModule(createInfo);
     }
 
     vk::ShaderModule createShaderModule(const std::vector<char>& code) {
@@ -624,13 +2613,24 @@ private:
         return availableFormats[0];
     }
 
+    /// <summary>
+    /// The mode asked for with --present-mode, otherwise mailbox when available. FIFO is the fallback, it is always supported.
+    /// </summary>
     vk::PresentModeKHR chooseSwapPresentMode(const std::vector<vk::PresentModeKHR>& availablePresentModes) {
+        vk::PresentModeKHR wanted = vk::PresentModeKHR::eMailbox;
+        if (config.presentMode == "immediate") wanted = vk::PresentModeKHR::eImmediate;
+        else if (config.presentMode == "fifo") wanted = vk::PresentModeKHR::eFifo;
+        else if (config.presentMode == "fifo-relaxed") wanted = vk::PresentModeKHR::eFifoRelaxed;
+
         for (const auto& availablePresentMode : availablePresentModes) {
-            if (availablePresentMode == vk::PresentModeKHR::eMailbox) {
+            if (availablePresentMode == wanted) {
                 return availablePresentMode;
             }
         }
 
+        if (!config.presentMode.empty()) {
+            std::cout << "present mode " << config.presentMode << " not supported, using fifo" << std::endl;
+        }
         return vk::PresentModeKHR::eFifo;
     }
 
@@ -639,9 +2639,11 @@ private:
             return capabilities.currentExtent;
         }
         else {
-            RECT wnd;
-            GetClientRect(window.getHandle(), &wnd);
-            const int width = wnd.right, height = wnd.bottom;
+#ifdef _WIN32
+            const auto [width, height] = window.getSize();
+#else
+            const int width = config.width, height = config.height;
+#endif
 
             vk::Extent2D actualExtent = {
                 static_cast<uint32_t>(width),
@@ -670,8 +2672,8 @@ private:
 
         bool extensionsSupported = checkDeviceExtensionSupport(device);
 
-        bool swapChainAdequate = false;
-        if (extensionsSupported) {
+        bool swapChainAdequate = config.headless;
+        if (extensionsSupported && !config.headless) {
             SwapChainSupportDetails swapChainSupport = querySwapChainSupport(device);
             swapChainAdequate = !swapChainSupport.formats.empty() && !swapChainSupport.presentModes.empty();
         }
@@ -682,7 +2684,8 @@ private:
     bool checkDeviceExtensionSupport(const vk::PhysicalDevice device) {
         std::vector<vk::ExtensionProperties> availableExtensions = device.enumerateDeviceExtensionProperties();
 
-        std::set<std::string> requiredExtensions(deviceExtensions.begin(), deviceExtensions.end());
+        auto extensions = getRequiredDeviceExtensions();
+        std::set<std::string> requiredExtensions(extensions.begin(), extensions.end());
 
         for (const auto& extension : availableExtensions) {
             requiredExtensions.erase(extension.extensionName);
@@ -691,6 +2694,167 @@ private:
         return requiredExtensions.empty();
     }
 
+    /// <summary>
+    /// Staging upload throughput into a device local buffer for a range of upload sizes
+    /// </summary>
+    void benchmarkUpload() {
+        const vk::DeviceSize bufferSize = 64ull * 1024 * 1024;
+        const uint32_t rounds = 4;
+
+        Buffer target = allocator.createBuffer(bufferSize, vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eVertexBuffer, vk::MemoryPropertyFlagBits::eDeviceLocal);
+        std::vector<char> data((size_t)bufferSize, 0x5a);
+
+        for (vk::DeviceSize chunkSize : { 4ull * 1024, 64ull * 1024, 1024ull * 1024, 16ull * 1024 * 1024 }) {
+            uint64_t submitsBefore = uploader.getSubmitCount();
+
+            auto start = FrameStats::Clock::now();
+            for (uint32_t round = 0; round < rounds; round++) {
+                for (vk::DeviceSize offset = 0; offset < bufferSize; offset += chunkSize) {
+                    uploader.upload(target.buffer, offset, data.data() + offset, chunkSize);
+                }
+            }
+            uploader.flush();
+            double milliseconds = FrameStats::toMilliseconds(FrameStats::Clock::now() - start);
+
+            std::cout << "upload " << chunkSize / 1024 << " KiB chunks: " << rounds * bufferSize / 1e6 / (milliseconds / 1000.0) << " MB/s, "
+                << bufferSize / chunkSize * rounds << " uploads in " << uploader.getSubmitCount() - submitsBefore << " submissions" << std::endl;
+        }
+
+        uploader.forget(target.buffer);
+        allocator.destroyBuffer(target);
+    }
+
+    /// <summary>
+    /// CPU cost of recording a frame for growing draw counts, inline versus secondaries recorded on 1..N threads.
+    /// Nothing is submitted, the command buffers are only recorded and thrown away.
+    /// </summary>
+    void benchmarkRecording() {
+        const uint32_t iterations = 10;
+        device.waitIdle();
+
+        std::vector<uint32_t> threadCounts = { 0 };
+        uint32_t hardwareThreads = std::max(1u, std::thread::hardware_concurrency());
+        for (uint32_t threads = 1; threads < hardwareThreads; threads *= 2) {
+            threadCounts.push_back(threads);
+        }
+        threadCounts.push_back(hardwareThreads);
+
+        for (uint32_t drawCount : { 10000u, 100000u, 1000000u }) {
+            double inlineMilliseconds = 0.0;
+
+            for (uint32_t threads : threadCounts) {
+                createRecordThreads(threads);
+
+                // the first pass allocates the secondaries, keep it out of the numbers
+                FrameStats stats = measureFrames(1, iterations, [&]() {
+                    recordCommandBuffer(commandBuffers[currentFrame], 0, drawCount);
+                    currentFrame = (currentFrame + 1) % config.framesInFlight;
+                });
+
+                double milliseconds = stats.mean();
+                if (threads == 0) inlineMilliseconds = milliseconds;
+
+                std::cout << "record " << drawCount << " draws, ";
+                if (threads == 0) std::cout << "inline: ";
+                else std::cout << threads << (threads == 1 ? " thread: " : " threads: ");
+                std::cout << milliseconds << " ms (" << drawCount / milliseconds / 1000.0 << " M draws/s, "
+                    << inlineMilliseconds / milliseconds << "x inline)" << std::endl;
+            }
+        }
+
+        createRecordThreads(config.recordThreads);
+    }
+
+    /// <summary>
+    /// Frame time and triangle throughput of the instanced path from 1k to 10M instances. A size that no longer
+    /// fits in device memory ends the sweep.
+    /// </summary>
+    void benchmarkInstances() {
+        const uint32_t warmupFrames = 5;
+        const uint32_t measuredFrames = 60;
+        const uint32_t trianglesPerInstance = indexCount / 3;
+
+        for (uint32_t count : { 1000u, 10000u, 100000u, 1000000u, 10000000u }) {
+            // idle, so the previous size's buffers can go before the next one is allocated
+            device.waitIdle();
+            deletionQueue.retire(frameNumber);
+            try {
+                createInstanceBuffer(count);
+            }
+            catch (const std::exception& e) {
+                std::cout << "instances " << count << ": could not create instance buffer (" << e.what() << ")" << std::endl;
+                break;
+            }
+
+            FrameStats stats = measureFrames(warmupFrames, measuredFrames, [this]() { drawFrame(); });
+
+            double milliseconds = stats.mean();
+            std::cout << "instances " << count << ": " << milliseconds << " ms/frame (p99 " << stats.percentile(99.0) << " ms), "
+                << (double)count * trianglesPerInstance / (milliseconds / 1000.0) / 1e6 << " M tris/s" << std::endl;
+        }
+
+        device.waitIdle();
+        allocator.destroyBuffer(instanceBuffer);
+        instanceCount = 0;
+    }
+
+    /// <summary>
+    /// Per-object CPU draws against the GPU-culled indirect path for growing object counts, the culled path
+    /// both with the whole field in view and zoomed in so most objects are culled
+    /// </summary>
+    void benchmarkCulling() {
+        const uint32_t warmupFrames = 3;
+        const uint32_t measuredFrames = 30;
+
+        auto measure = [&]() {
+            FrameStats stats = measureFrames(warmupFrames, measuredFrames, [this]() { drawFrame(); });
+            device.waitIdle();
+            return stats.mean();
+        };
+
+        for (uint32_t count : { 10000u, 100000u, 1000000u }) {
+            device.waitIdle();
+            allocator.destroyBuffer(instanceBuffer);
+            instanceCount = 0;
+            gpuCulling = false;
+            cameraZoom = 1.0f;
+            config.objectCount = count;
+            std::cout << "cull " << count << " objects, cpu draws: " << measure() << " ms/frame" << std::endl;
+
+            createInstanceBuffer(count);
+            gpuCulling = true;
+            for (float zoom : { 1.0f, 4.0f }) {
+                cameraZoom = zoom;
+                double milliseconds = measure();
+                uint32_t visible = *static_cast<uint32_t*>(cullFrames[(currentFrame + config.framesInFlight - 1) % config.framesInFlight].drawCount.allocation.mapped);
+                std::cout << "cull " << count << " objects, gpu culled (zoom " << zoom << "): " << milliseconds << " ms/frame, "
+                    << visible << " visible" << std::endl;
+            }
+        }
+
+        device.waitIdle();
+        gpuCulling = config.cull;
+        cameraZoom = 1.0f;
+    }
+
+    bool checkDeviceExtensionSupport(const vk::PhysicalDevice device, const char* extensionName) {
+        for (const auto& extension : device.enumerateDeviceExtensionProperties()) {
+            if (strcmp(extension.extensionName, extensionName) == 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool checkInstanceExtensionSupport(const char* extensionName) {
+        for (const auto& extension : vk::enumerateInstanceExtensionProperties()) {
+            if (strcmp(extension.extensionName, extensionName) == 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+
     QueueFamilyIndices findQueueFamilies(const vk::PhysicalDevice device) {
         QueueFamilyIndices indices;
 		std::vector<vk::QueueFamilyProperties> queueFamilies = device.getQueueFamilyProperties();
@@ -701,7 +2865,8 @@ private:
                 indices.graphicsFamily = i;
             }
 
-            VkBool32 presentSupport = device.getSurfaceSupportKHR(i, surface);
+            // headless frames are never presented, the graphics queue stands in for the present queue
+            VkBool32 presentSupport = config.headless ? indices.graphicsFamily.has_value() : device.getSurfaceSupportKHR(i, surface);
 
             if (presentSupport) {
                 indices.presentFamily = i;
@@ -714,15 +2879,33 @@ private:
             i++;
         }
 
+        // prefer a transfer-only family (the DMA engine) over a compute family that also copies
+        for (uint32_t family = 0; family < queueFamilies.size(); family++) {
+            vk::QueueFlags flags = queueFamilies[family].queueFlags;
+            if (flags & vk::QueueFlagBits::eGraphics) continue;
+
+            if ((flags & vk::QueueFlagBits::eCompute) && !indices.computeFamily.has_value()) {
+                indices.computeFamily = family;
+            }
+            // compute families can always copy even when they don't report eTransfer
+            bool transfer = (flags & (vk::QueueFlagBits::eTransfer | vk::QueueFlagBits::eCompute)) != vk::QueueFlags();
+            bool replacesCompute = indices.transferFamily.has_value() && !(flags & vk::QueueFlagBits::eCompute) &&
+                (queueFamilies[indices.transferFamily.value()].queueFlags & vk::QueueFlagBits::eCompute);
+            if (transfer && (!indices.transferFamily.has_value() || replacesCompute)) {
+                indices.transferFamily = family;
+            }
+        }
+
         return indices;
     }
 
     std::vector<const char*> getRequiredExtensions() {
 
-        std::vector<const char*> extensions = { //WINDOWS
-			"VK_KHR_surface",
-        	"VK_KHR_win32_surface"
-        };
+        std::vector<const char*> extensions;
+        if (!config.headless) { //WINDOWS
+            extensions.push_back("VK_KHR_surface");
+            extensions.push_back("VK_KHR_win32_surface");
+        }
 
         if (enableValidationLayers) {
             extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
@@ -731,6 +2914,13 @@ private:
         return extensions;
     }
 
+    std::vector<const char*> getRequiredDeviceExtensions() {
+        if (config.headless) {
+            return {};
+        }
+        return deviceExtensions;
+    }
+
     bool checkValidationLayerSupport() {
         auto availableLayers = vk::enumerateInstanceLayerProperties();
 
@@ -769,10 +2959,4 @@ private:
 
         return buffer;
     }
-
-    static VKAPI_ATTR VkBool32 VKAPI_CALL debugCallback(VkDebugUtilsMessageSeverityFlagBitsEXT messageSeverity, VkDebugUtilsMessageTypeFlagsEXT messageType, const VkDebugUtilsMessengerCallbackDataEXT* pCallbackData, void* pUserData) {
-        std::cerr << "validation layer: " << pCallbackData->pMessage << std::endl;
-
-        return VK_FALSE;
-    }
 };
\ No newline at end of file
@@ -3,15 +3,27 @@
 
 int main(int argc, char** argv, char* envp[])
 {
-	HelloTriangleApplication app;
-
+	int result = EXIT_SUCCESS;
 	try {
+		AppConfig config = AppConfig::fromArgs(argc, argv);
+		if (!config.instrumentPath.empty()) {
+#ifdef ENABLE_INSTRUMENTATION
+			INSTRUMENT_THREAD("main");
+			Instrumentation::start(config.instrumentPath);
+#else
+			std::cout << "instrumentation: not compiled in, configure with -DVULKANUS_INSTRUMENTATION=ON" << std::endl;
+#endif
+		}
+
+		HelloTriangleApplication app(config);
 		app.run();
 	}
 	catch (const std::exception& e) {
 		std::cerr << e.what() << std::endl;
-		return EXIT_FAILURE;
+		result = EXIT_FAILURE;
 	}
 
-	return EXIT_SUCCESS;
-}
\ No newline at end of file
+	// after the app and its worker threads are gone, nothing records anymore
+	Instrumentation::stop();
+	return result;
+}
@@ -1,3 +1,6 @@
 %VULKAN_SDK%/Bin32/glslc.exe shader.vert -o vert.spv
+%VULKAN_SDK%/Bin32/glslc.exe -DBINDLESS shader.vert -o vert_bindless.spv
 %VULKAN_SDK%/Bin32/glslc.exe shader.frag -o frag.spv
+%VULKAN_SDK%/Bin32/glslc.exe instanced.vert -o instanced_vert.spv
+%VULKAN_SDK%/Bin32/glslc.exe cull.comp -o cull.spv
 pause
\ No newline at end of file
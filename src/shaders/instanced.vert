@@ -0,0 +1,20 @@
+#version 450
+
+layout(set = 0, binding = 0) uniform CameraUniforms {
+    mat4 viewProj;
+} camera;
+
+layout(location = 0) in vec2 inPosition;
+layout(location = 1) in vec3 inColor;
+layout(location = 2) in vec4 instancePlacement; // x, y, rotation, scale
+layout(location = 3) in vec4 instanceColor;
+
+layout(location = 0) out vec3 fragColor;
+
+void main() {
+    float s = sin(instancePlacement.z);
+    float c = cos(instancePlacement.z);
+    vec2 local = mat2(c, s, -s, c) * inPosition * instancePlacement.w;
+    gl_Position = camera.viewProj * vec4(instancePlacement.xy + local, 0.0, 1.0);
+    fragColor = inColor * instanceColor.rgb;
+}
\ No newline at end of file
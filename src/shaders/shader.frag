@@ -1,9 +1,23 @@
 #version 450
 #extension GL_ARB_separate_shader_objects : enable
 
+// material variants are specialized at pipeline creation instead of living in separate shader files
+layout(constant_id = 0) const uint COLOR_MODE = 0u; // 0 = vertex color, 1 = grayscale, 2 = inverted, 3 = flat white
+layout(constant_id = 1) const float ALPHA = 1.0;
+
 layout(location = 0) out vec4 outColor;
 layout(location = 0) in vec3 fragColor;
 
 void main() {
-    outColor = vec4(fragColor, 1.0);
+    vec3 color = fragColor;
+    if (COLOR_MODE == 1u) {
+        color = vec3(dot(fragColor, vec3(0.299, 0.587, 0.114)));
+    }
+    else if (COLOR_MODE == 2u) {
+        color = vec3(1.0) - fragColor;
+    }
+    else if (COLOR_MODE == 3u) {
+        color = vec3(1.0);
+    }
+    outColor = vec4(color, ALPHA);
 }
\ No newline at end of file
@@ -1,18 +1,40 @@
 #version 450
+#ifdef BINDLESS
+#extension GL_EXT_nonuniform_qualifier : require
+#endif
+
+layout(set = 0, binding = 0) uniform CameraUniforms {
+    mat4 viewProj;
+} camera;
+
+#ifdef BINDLESS
+// every bindless storage buffer, the push constants pick the one holding this frame's transforms
+layout(std430, set = 1, binding = 0) readonly buffer ObjectTransforms {
+    mat4 model[];
+} storageBuffers[];
+#else
+// the per-frame fallback set holds just the buffer with this frame's transforms
+layout(std430, set = 1, binding = 0) readonly buffer ObjectTransforms {
+    mat4 model[];
+} transforms;
+#endif
+
+layout(push_constant) uniform DrawConstants {
+    uint transformBuffer;
+    uint transformIndex;
+} draw;
+
+layout(location = 0) in vec2 inPosition;
+layout(location = 1) in vec3 inColor;
 
-vec2 positions[3] = vec2[](
-    vec2(0.0, -0.5),
-    vec2(0.5, 0.5),
-    vec2(-0.5, 0.5)
-);
-vec3 colors[3] = vec3[](
-    vec3(1.0, 0.0, 0.0),
-    vec3(0.0, 1.0, 0.0),
-    vec3(0.0, 0.0, 1.0)
-);
 layout(location = 0) out vec3 fragColor;
 
 void main() {
-    gl_Position = vec4(positions[gl_VertexIndex], 0.0, 1.0);
-    fragColor = colors[gl_VertexIndex];
+#ifdef BINDLESS
+    mat4 model = storageBuffers[draw.transformBuffer].model[draw.transformIndex];
+#else
+    mat4 model = transforms.model[draw.transformIndex];
+#endif
+    gl_Position = camera.viewProj * model * vec4(inPosition, 0.0, 1.0);
+    fragColor = inColor;
 }
\ No newline at end of file